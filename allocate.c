@@ -1,18 +1,274 @@
 #include "include/common.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
 
-int main()
+// largest size of the sweep by default: 1 GiB
+#define BENCH_MAX_SIZE ((size_t)1 << 30)
+
+// sizes above which fewer objects are live at once, and fewer samples taken
+#define BENCH_LARGE_SIZE ((size_t)1 << 20)
+#define BENCH_LARGE_SAMPLES 32
+
+// objects live at once: one batch is allocated, then freed
+#define BENCH_BATCH 64
+#define BENCH_LARGE_BATCH 8
+
+// cache lines, and sets of the level 1 data cache, that first lines of objects are counted in
+#define BENCH_CACHE_LINE 64
+#define BENCH_CACHE_SETS 64
+
+// passes over the first lines of a batch to time their accesses
+#define BENCH_ACCESS_PASSES 100
+
+/**
+ * Monotonic wall clock time.
+ * @return nanoseconds since an arbitrary origin
+ */
+uint64_t benchNanoseconds(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+}
+
+/**
+ * Comparison function of `qsort` for the latency samples.
+ * @param a first sample
+ * @param b second sample
+ * @return negative, zero or positive as `*a` is smaller than, equal to or larger than `*b`
+ */
+int benchCompareSamples(const void *a, const void *b)
+{
+	uint64_t first = *(const uint64_t *)a;
+	uint64_t second = *(const uint64_t *)b;
+
+	return (first > second) - (first < second);
+}
+
+/**
+ * Median cost of reading the clock twice in a row, included in every latency sample.
+ * @return The overhead (unit: nanoseconds)
+ */
+uint64_t benchTimerOverhead(void)
+{
+	uint64_t samples[1001];
+
+	for (size_t ix = 0; ix < 1001; ix++)
+	{
+		uint64_t start = benchNanoseconds();
+		samples[ix] = benchNanoseconds() - start;
+	}
+
+	qsort(samples, 1001, sizeof(uint64_t), benchCompareSamples);
+
+	return samples[500];
+}
+
+/**
+ * Prints the median, 90th and 99th percentiles and the maximum of `samples`, as CSV columns.
+ * @param samples latency samples, sorted in place
+ * @param count number of samples
+ */
+void benchPrintPercentiles(uint64_t samples[], size_t count)
+{
+	qsort(samples, count, sizeof(uint64_t), benchCompareSamples);
+
+	printf(",%llu,%llu,%llu,%llu", (unsigned long long)samples[count / 2],
+		   (unsigned long long)samples[count * 9 / 10],
+		   (unsigned long long)samples[count * 99 / 100], (unsigned long long)samples[count - 1]);
+}
+
+/**
+ * Next size of the sweep: powers of two, one more than them, and halfway to the next ones, so
+ * that both sizes aligned to a power of two and sizes just past one are measured.
+ * @param size current size of the sweep
+ * @return The next size
+ */
+size_t benchNextSize(size_t size)
+{
+	size_t power = 1;
+	while (power * 2 <= size)
+	{
+		power *= 2;
+	}
+
+	if (size == power && power >= 4)
+	{
+		return power + 1;
+	}
+
+	if (size == power + 1 && power >= 4)
+	{
+		return power + power / 2;
+	}
+
+	return (size < power + power / 2) ? power + power / 2 : 2 * power;
+}
+
+/**
+ * Measures allocations of `size` bytes and prints one CSV line:
+ * - bounds: the length of the bounds `malloc` grants, its padding over `size`, and the
+ *   alignment of the first object (largest power of two dividing its address, up to 4 KiB)
+ * - latency: percentiles of `malloc` and `free` times, in batches of objects live at once
+ * - touch: percentiles of the time to write the first byte of a new object, a page fault when
+ *   `malloc` maps fresh memory
+ * - aliasing: number of level 1 cache sets the first lines of a batch fall into, and the time to
+ *   read them in turn; objects aligned to large powers of two crowd into few sets and conflict
+ * @param size size of the allocations (unit: bytes)
+ * @param samples number of `malloc` and `free` calls timed
+ * @param timerOverhead cost of the clock reads around each timed call (unit: ns)
+ * @return false if an allocation failed
+ */
+bool benchSize(size_t size, size_t samples, uint64_t timerOverhead)
 {
-	size_t size = 31;
+	size_t batch = (size > BENCH_LARGE_SIZE) ? BENCH_LARGE_BATCH : BENCH_BATCH;
+	samples = (size > BENCH_LARGE_SIZE && samples > BENCH_LARGE_SAMPLES) ? BENCH_LARGE_SAMPLES
+																		  : samples;
+	samples = (samples + batch - 1) / batch * batch;
+
+	uint64_t *mallocTimes = malloc(3 * samples * sizeof(uint64_t));
+	uint64_t *freeTimes = mallocTimes + samples;
+	uint64_t *touchTimes = freeTimes + samples;
+	char *objects[BENCH_BATCH];
+	uint64_t granted = 0;
+	uint64_t alignment = 0;
+	size_t sets = 0;
+	double accessNanoseconds = 0.0;
+
+	if (NULL == mallocTimes)
+	{
+		error("Could not allocate the samples");
+		exit(EXIT_FAILURE);
+	}
+
+	for (size_t done = 0; done < samples; done += batch)
+	{
+		for (size_t ix = 0; ix < batch; ix++)
+		{
+			uint64_t start = benchNanoseconds();
+			objects[ix] = malloc(size);
+			mallocTimes[done + ix] = benchNanoseconds() - start;
+
+			if (NULL == objects[ix])
+			{
+				while (ix-- > 0)
+				{
+					free(objects[ix]);
+				}
+
+				free(mallocTimes);
+				return false;
+			}
+
+			start = benchNanoseconds();
+			*(volatile char *)objects[ix] = (char)ix;
+			touchTimes[done + ix] = benchNanoseconds() - start;
+		}
+
+		if (0 == done)
+		{
+			bool used[BENCH_CACHE_SETS] = {false};
+
+			granted = cheri_length_get(objects[0]);
+			alignment = cheri_address_get(objects[0]) & -cheri_address_get(objects[0]);
+			alignment = (0 == alignment || alignment > 4096) ? 4096 : alignment;
+
+			for (size_t ix = 0; ix < batch; ix++)
+			{
+				size_t set = (cheri_address_get(objects[ix]) / BENCH_CACHE_LINE) % BENCH_CACHE_SETS;
+
+				sets += !used[set];
+				used[set] = true;
+			}
+
+			uint64_t start = benchNanoseconds();
+
+			for (size_t pass = 0; pass < BENCH_ACCESS_PASSES; pass++)
+			{
+				for (size_t ix = 0; ix < batch; ix++)
+				{
+					(void)*(volatile char *)objects[ix];
+				}
+			}
+
+			accessNanoseconds = (double)(benchNanoseconds() - start) /
+								(double)(BENCH_ACCESS_PASSES * batch);
+		}
+
+		for (size_t ix = 0; ix < batch; ix++)
+		{
+			uint64_t start = benchNanoseconds();
+			free(objects[ix]);
+			freeTimes[done + ix] = benchNanoseconds() - start;
+		}
+	}
+
+	printf("%zu,%llu,%llu,%.2f,%llu,%zu,%zu", size, (unsigned long long)granted,
+		   (unsigned long long)(granted - size), 100.0 * (double)(granted - size) / (double)size,
+		   (unsigned long long)alignment, batch, samples);
+
+	benchPrintPercentiles(mallocTimes, samples);
+	benchPrintPercentiles(freeTimes, samples);
+	benchPrintPercentiles(touchTimes, samples);
+
+	printf(",%zu,%.2f,%llu\n", sets, accessNanoseconds, (unsigned long long)timerOverhead);
+	fflush(stdout);
+
+	free(mallocTimes);
+
+	return true;
+}
+
+/**
+ * Allocation microbenchmark of `malloc`: sweeps sizes from 1 byte to `maxSize`, by powers of two,
+ * one more than them and halfway between, and prints one CSV line per size with the bounds length
+ * granted for it, the latency distributions of `malloc`, `free` and of the first write to a new
+ * object, and the cache set aliasing of objects allocated together. Latencies include the cost of
+ * reading the clock, reported in the last column. Used to choose object sizes and allocators for
+ * hot structures: sizes whose bounds are padded, or whose objects alias in the cache, show here.
+ * Sizes `malloc` fails for are reported on stderr and skipped.
+ * Usage: allocate [maxSize [samples]]
+ * @return EXIT_SUCCESS on success. EXIT_FAILURE otherwise
+ */
+int main(int argc, char *argv[])
+{
+	size_t maxSize = BENCH_MAX_SIZE;
+	size_t samples = 4096;
+
+	if (argc > 1)
+	{
+		maxSize = strtoull(argv[1], NULL, 0);
+	}
+
+	if (argc > 2)
+	{
+		samples = strtoull(argv[2], NULL, 0);
+	}
+
+	if ((argc > 3) || (0 == maxSize) || (0 == samples))
+	{
+		fprintf(stderr, "usage: %s [maxSize >= 1 [samples >= 1]]\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	uint64_t timerOverhead = benchTimerOverhead();
+
+	printf("requested_bytes,granted_bytes,padding_bytes,padding_percent,alignment,batch,samples,"
+		   "malloc_p50_ns,malloc_p90_ns,malloc_p99_ns,malloc_max_ns,"
+		   "free_p50_ns,free_p90_ns,free_p99_ns,free_max_ns,"
+		   "touch_p50_ns,touch_p90_ns,touch_p99_ns,touch_max_ns,"
+		   "cache_sets,line_access_ns,timer_ns\n");
 
-	printf("Size: ");
-	if (0 == scanf("%lu", &size))
+	for (size_t size = 1; size <= maxSize; size = benchNextSize(size))
 	{
-		error("Extraneous input");
-		return -1;
+		if (!benchSize(size, samples, timerOverhead))
+		{
+			fprintf(stderr, "malloc(%zu) failed\n", size);
+		}
 	}
 
-	void *memory = malloc(size);
-	inspect_pointer(memory);
+	return EXIT_SUCCESS;
 }
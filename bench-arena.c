@@ -0,0 +1,245 @@
+#include "lib/arena_lib.h"
+#include "lib/timsortdata.h"
+#include <string.h>
+#include <time.h>
+
+// size ranges of the benchmark
+#define BENCH_SIZE_RANGES 5
+
+// latency percentiles reported, in tenths of a percent
+#define BENCH_PERCENTILES 4
+
+/**
+ * Range of the allocation sizes of one run, drawn uniformly (unit: bytes).
+ */
+typedef struct bench_size_range
+{
+	size_t minSize;
+	size_t maxSize;
+} bench_size_range_t;
+
+const bench_size_range_t benchSizeRanges[BENCH_SIZE_RANGES] = {
+	{16, 16}, {1, 64}, {64, 256}, {256, 4096}, {1, 1024}};
+
+const size_t benchPercentiles[BENCH_PERCENTILES] = {500, 900, 990, 999};
+
+/**
+ * Allocators compared by the benchmark.
+ * - BENCH_MALLOC: `malloc`, every object given back with `free` at the end of its request
+ * - BENCH_ARENA: `arena_alloc`, the objects of a request given back by `arena_reset`
+ */
+typedef enum bench_allocator
+{
+	BENCH_MALLOC,
+	BENCH_ARENA
+} bench_allocator_t;
+
+const char *benchAllocatorNames[] = {"malloc", "arena"};
+
+/**
+ * Monotonic wall clock time.
+ * @return nanoseconds since an arbitrary origin
+ */
+uint64_t benchNanoseconds(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+}
+
+/**
+ * Comparison function of `qsort` for the latency samples.
+ * @param a first sample
+ * @param b second sample
+ * @return negative, zero or positive as `*a` is smaller than, equal to or larger than `*b`
+ */
+int benchCompareSamples(const void *a, const void *b)
+{
+	uint64_t first = *(const uint64_t *)a;
+	uint64_t second = *(const uint64_t *)b;
+
+	return (first > second) - (first < second);
+}
+
+/**
+ * Median cost of reading the clock twice in a row, included in every latency sample.
+ * @return The overhead (unit: nanoseconds)
+ */
+uint64_t benchTimerOverhead(void)
+{
+	uint64_t samples[1001];
+
+	for (size_t ix = 0; ix < 1001; ix++)
+	{
+		uint64_t start = benchNanoseconds();
+		samples[ix] = benchNanoseconds() - start;
+	}
+
+	qsort(samples, 1001, sizeof(uint64_t), benchCompareSamples);
+
+	return samples[500];
+}
+
+/**
+ * Runs `requests` requests of `objects` allocations each, sizes drawn from `range`, and frees each
+ * request's objects at its end. The first byte of every object is written. When `latency` is not
+ * NULL each allocation is timed on its own and its time stored there.
+ * @param allocator allocator to use
+ * @param arena arena used by `BENCH_ARENA`
+ * @param range sizes of the allocations
+ * @param requests number of requests
+ * @param objects number of allocations of each request
+ * @param pointers array of `objects` pointers, holds the objects of a request
+ * @param latency output, `requests * objects` allocation times, or NULL
+ * @return false if an allocation failed
+ */
+bool benchRequests(bench_allocator_t allocator, arena_t *arena, bench_size_range_t range,
+				   size_t requests, size_t objects, unsigned char **pointers, uint64_t *latency)
+{
+	xoshiro_t rng;
+	xoshiroSeed(&rng, DATA_SEED);
+
+	for (size_t request = 0; request < requests; request++)
+	{
+		for (size_t ix = 0; ix < objects; ix++)
+		{
+			size_t size = range.minSize + xoshiroBelow(&rng, range.maxSize - range.minSize + 1);
+			uint64_t start = (NULL != latency) ? benchNanoseconds() : 0;
+
+			pointers[ix] =
+				(BENCH_MALLOC == allocator) ? malloc(size) : arena_alloc(arena, size);
+
+			if (NULL != latency)
+			{
+				latency[request * objects + ix] = benchNanoseconds() - start;
+			}
+
+			if (NULL == pointers[ix])
+			{
+				return false;
+			}
+
+			pointers[ix][0] = (unsigned char)ix;
+		}
+
+		if (BENCH_MALLOC == allocator)
+		{
+			for (size_t ix = 0; ix < objects; ix++)
+			{
+				free(pointers[ix]);
+			}
+		}
+		else
+		{
+			arena_reset(arena);
+		}
+	}
+
+	return true;
+}
+
+/**
+ * Benchmarks one allocator on one size range and prints one CSV line: throughput of an untimed
+ * run of all requests, then latency percentiles of a run with every allocation timed. Freeing
+ * is part of the throughput but not of the latencies.
+ * @param allocator allocator to benchmark
+ * @param range sizes of the allocations
+ * @param requests number of requests
+ * @param objects number of allocations of each request
+ * @param timerOverhead cost of the clock reads around each timed allocation (unit: ns)
+ * @return false if an allocation failed
+ */
+bool benchAllocator(bench_allocator_t allocator, bench_size_range_t range, size_t requests,
+					size_t objects, uint64_t timerOverhead)
+{
+	size_t allocations = requests * objects;
+	unsigned char **pointers = malloc(objects * sizeof(unsigned char *));
+	uint64_t *latency = malloc(allocations * sizeof(uint64_t));
+	arena_t *arena = arena_create(0);
+
+	if (NULL == pointers || NULL == latency || NULL == arena)
+	{
+		fputs("Could not allocate the benchmark buffers\n", stderr);
+		exit(EXIT_FAILURE);
+	}
+
+	// warm-up, maps the arena's regions and fills the caches of malloc
+	bool success = benchRequests(allocator, arena, range, 1, objects, pointers, NULL);
+
+	uint64_t start = benchNanoseconds();
+	success &= benchRequests(allocator, arena, range, requests, objects, pointers, NULL);
+	uint64_t nanoseconds = benchNanoseconds() - start;
+
+	success &= benchRequests(allocator, arena, range, requests, objects, pointers, latency);
+	qsort(latency, allocations, sizeof(uint64_t), benchCompareSamples);
+
+	printf("%s,%zu,%zu,%zu,%zu,%.2f,%.3f", benchAllocatorNames[allocator], range.minSize,
+		   range.maxSize, requests, objects, (double)nanoseconds / (double)allocations,
+		   (double)allocations * 1000.0 / (double)nanoseconds);
+
+	for (size_t ix = 0; ix < BENCH_PERCENTILES; ix++)
+	{
+		printf(",%llu", (unsigned long long)latency[allocations * benchPercentiles[ix] / 1000]);
+	}
+
+	printf(",%llu,%llu\n", (unsigned long long)latency[allocations - 1],
+		   (unsigned long long)timerOverhead);
+	fflush(stdout);
+
+	arena_destroy(arena);
+	free(latency);
+	free(pointers);
+
+	return success;
+}
+
+/**
+ * Benchmarks `arena_alloc` against `malloc` on request-scoped workloads: each request allocates a
+ * number of small objects, which are all freed when it ends. Runs on every size range of
+ * `benchSizeRanges` and prints, as CSV, the throughput and the allocation latency percentiles of
+ * each allocator. Latencies include the cost of reading the clock, reported in the last column.
+ * Usage: bench-arena [requests [objectsPerRequest]]
+ * @return EXIT_SUCCESS on success. EXIT_FAILURE otherwise
+ */
+int main(int argc, char *argv[])
+{
+	size_t requests = 1000;
+	size_t objects = 1000;
+
+	if (argc > 1)
+	{
+		requests = strtoull(argv[1], NULL, 0);
+	}
+
+	if (argc > 2)
+	{
+		objects = strtoull(argv[2], NULL, 0);
+	}
+
+	if ((argc > 3) || (0 == requests) || (0 == objects))
+	{
+		fprintf(stderr, "usage: %s [requests >= 1 [objectsPerRequest >= 1]]\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	uint64_t timerOverhead = benchTimerOverhead();
+
+	printf("allocator,min_size,max_size,requests,objects_per_request,ns_per_alloc,"
+		   "allocs_per_us,p50_ns,p90_ns,p99_ns,p999_ns,max_ns,timer_ns\n");
+
+	for (size_t ix_range = 0; ix_range < BENCH_SIZE_RANGES; ix_range++)
+	{
+		for (size_t allocator = BENCH_MALLOC; allocator <= BENCH_ARENA; allocator++)
+		{
+			if (!benchAllocator(allocator, benchSizeRanges[ix_range], requests, objects,
+								timerOverhead))
+			{
+				fputs("Allocation failed\n", stderr);
+				return EXIT_FAILURE;
+			}
+		}
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,214 @@
+#include "lib/quarantine_lib.h"
+#include "lib/timsortdata.h"
+#include <string.h>
+#include <time.h>
+
+// quarantine budgets of the benchmark, 0 frees at once with no quarantine
+#define BENCH_BUDGETS 6
+
+// sizes of the objects, drawn uniformly (unit: bytes)
+#define BENCH_MIN_SIZE 16
+#define BENCH_MAX_SIZE 256
+
+const size_t benchBudgets[BENCH_BUDGETS] = {0, 64 << 10, 256 << 10, 1 << 20, 4 << 20, 16 << 20};
+
+/**
+ * Object of the benchmark: points to another live object, so that the heap holds pointers that
+ * become stale when their target is freed.
+ */
+typedef struct bench_node
+{
+	struct bench_node *peer;
+	uint32_t size;
+} bench_node_t;
+
+void *stackTop;
+
+/**
+ * Monotonic wall clock time.
+ * @return nanoseconds since an arbitrary origin
+ */
+uint64_t benchNanoseconds(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+}
+
+/**
+ * Comparison function of `qsort` for the pause samples.
+ * @param a first sample
+ * @param b second sample
+ * @return negative, zero or positive as `*a` is smaller than, equal to or larger than `*b`
+ */
+int benchCompareSamples(const void *a, const void *b)
+{
+	uint64_t first = *(const uint64_t *)a;
+	uint64_t second = *(const uint64_t *)b;
+
+	return (first > second) - (first < second);
+}
+
+/**
+ * Allocates an object of a random size pointing to a random live object.
+ * @param quarantine quarantine to allocate from
+ * @param slots live objects
+ * @param live number of slots
+ * @param rng generator of the size and the peer
+ * @return The object, exits on allocation failure
+ */
+bench_node_t *benchNode(quarantine_t *quarantine, bench_node_t **slots, size_t live,
+						xoshiro_t *rng)
+{
+	uint32_t size =
+		(uint32_t)(BENCH_MIN_SIZE + xoshiroBelow(rng, BENCH_MAX_SIZE - BENCH_MIN_SIZE + 1));
+	bench_node_t *node = quarantine_alloc(quarantine, size);
+
+	if (NULL == node)
+	{
+		fputs("Allocation failed\n", stderr);
+		exit(EXIT_FAILURE);
+	}
+
+	node->peer = slots[xoshiroBelow(rng, live)];
+	node->size = size;
+
+	return node;
+}
+
+/**
+ * Runs the benchmark with one budget and prints one CSV line: `live` objects are allocated, then
+ * each operation frees a random one and allocates another in its place. Reports the time per
+ * operation, the number of sweeps, the bytes each scans and their bandwidth, and the percentiles
+ * of the sweep pauses. With a budget of 0 objects are given back to the heap at once.
+ * @param budget quarantine budget (unit: bytes), 0 for none
+ * @param live number of live objects
+ * @param ops number of operations
+ */
+void benchBudget(size_t budget, size_t live, size_t ops)
+{
+	quarantine_t *quarantine = quarantine_create(stackTop, (0 == budget) ? SIZE_MAX : budget);
+	bench_node_t **slots = calloc(live, sizeof(bench_node_t *));
+	size_t pauseCapacity = 1024;
+	uint64_t *pauses = malloc(pauseCapacity * sizeof(uint64_t));
+	xoshiro_t rng;
+
+	if (NULL == quarantine || NULL == slots || NULL == pauses ||
+		!quarantine_add_root(quarantine, slots, live * sizeof(bench_node_t *)))
+	{
+		fputs("Could not allocate the benchmark buffers\n", stderr);
+		exit(EXIT_FAILURE);
+	}
+
+	xoshiroSeed(&rng, DATA_SEED);
+
+	for (size_t ix = 0; ix < live; ix++)
+	{
+		slots[ix] = benchNode(quarantine, slots, live, &rng);
+	}
+
+	uint64_t start = benchNanoseconds();
+
+	for (size_t ix = 0; ix < ops; ix++)
+	{
+		size_t slot = xoshiroBelow(&rng, live);
+		uint64_t sweeps = quarantine->stats.sweeps;
+
+		if (0 == budget)
+		{
+			slab_free(quarantine->heap, slots[slot], slots[slot]->size);
+		}
+		else
+		{
+			quarantine_free(quarantine, slots[slot], slots[slot]->size);
+		}
+
+		if (sweeps != quarantine->stats.sweeps)
+		{
+			if (sweeps == pauseCapacity)
+			{
+				pauseCapacity *= 2;
+				pauses = realloc(pauses, pauseCapacity * sizeof(uint64_t));
+
+				if (NULL == pauses)
+				{
+					fputs("Could not allocate the pause samples\n", stderr);
+					exit(EXIT_FAILURE);
+				}
+			}
+
+			pauses[sweeps] = quarantine->stats.lastPauseNanoseconds;
+		}
+
+		slots[slot] = benchNode(quarantine, slots, live, &rng);
+	}
+
+	uint64_t nanoseconds = benchNanoseconds() - start;
+	quarantine_stats_t stats = quarantine->stats;
+	uint64_t sweeps = (0 == stats.sweeps) ? 1 : stats.sweeps;
+
+	qsort(pauses, stats.sweeps, sizeof(uint64_t), benchCompareSamples);
+
+	printf("%zu,%zu,%zu,%.2f,%llu,%llu,%.3f,%.1f,%.1f,%.1f,%llu,%.2f\n", budget, ops, live,
+		   (double)nanoseconds / (double)ops, (unsigned long long)stats.sweeps,
+		   (unsigned long long)(stats.bytesScanned / sweeps),
+		   (0 == stats.sweepNanoseconds)
+			   ? 0.0
+			   : (double)stats.bytesScanned / (double)stats.sweepNanoseconds,
+		   (0 == stats.sweeps) ? 0.0 : (double)pauses[stats.sweeps / 2] / 1000.0,
+		   (0 == stats.sweeps) ? 0.0 : (double)pauses[stats.sweeps * 99 / 100] / 1000.0,
+		   (double)stats.maxPauseNanoseconds / 1000.0,
+		   (unsigned long long)(stats.pointersRevoked / sweeps),
+		   100.0 * (double)stats.sweepNanoseconds / (double)nanoseconds);
+	fflush(stdout);
+
+	free(pauses);
+	free(slots);
+	quarantine_destroy(quarantine);
+}
+
+/**
+ * Benchmarks the quarantine allocator with a revocation sweep: a heap of objects pointing to each
+ * other is churned, each freed object is held in quarantine until the budget fills, and a sweep
+ * of the registers, the stack, the array of live objects and the heap then revokes the pointers
+ * to them. Runs every budget of `benchBudgets` and prints, as CSV, the time per operation, the
+ * sweep bandwidth (unit: GB/s), the sweep pauses (unit: us), the pointers revoked per sweep and
+ * the share of the time spent sweeping. Without capabilities stale pointers are only counted, so
+ * the cost of the scan is measured but not that of clearing tags.
+ * Usage: bench-quarantine [liveObjects [operations]]
+ * @return EXIT_SUCCESS on success. EXIT_FAILURE otherwise
+ */
+int main(int argc, char *argv[])
+{
+	size_t live = 100000;
+	size_t ops = 2000000;
+
+	stackTop = __builtin_frame_address(0);
+
+	if (argc > 1)
+	{
+		live = strtoull(argv[1], NULL, 0);
+	}
+
+	if (argc > 2)
+	{
+		ops = strtoull(argv[2], NULL, 0);
+	}
+
+	if ((argc > 3) || (0 == live) || (0 == ops))
+	{
+		fprintf(stderr, "usage: %s [liveObjects >= 1 [operations >= 1]]\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	printf("budget_bytes,operations,live_objects,ns_per_op,sweeps,bytes_per_sweep,sweep_gb_per_s,"
+		   "pause_p50_us,pause_p99_us,pause_max_us,revoked_per_sweep,sweep_time_percent\n");
+
+	for (size_t ix = 0; ix < BENCH_BUDGETS; ix++)
+	{
+		benchBudget(benchBudgets[ix], live, ops);
+	}
+
+	return EXIT_SUCCESS;
+}
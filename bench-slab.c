@@ -0,0 +1,276 @@
+#include "lib/slab_lib.h"
+#include "lib/timsortdata.h"
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+// bands of the allocation sizes of the trace
+#define BENCH_SIZE_BANDS 4
+
+/**
+ * Band of allocation sizes of the trace: sizes drawn uniformly from `minSize` to `maxSize`
+ * (unit: bytes), for `percent` percent of the allocations.
+ */
+typedef struct bench_size_band
+{
+	size_t minSize;
+	size_t maxSize;
+	size_t percent;
+} bench_size_band_t;
+
+const bench_size_band_t benchSizeBands[BENCH_SIZE_BANDS] = {
+	{1, 64, 60}, {65, 512, 25}, {513, 4096, 12}, {4097, 65536, 3}};
+
+/**
+ * Allocators compared by the benchmark.
+ * - BENCH_BASELINE: no allocation, replays the trace to measure its own cost and memory
+ * - BENCH_MALLOC: `malloc` and `free`
+ * - BENCH_SLAB: `slab_alloc` and `slab_free`
+ */
+typedef enum bench_allocator
+{
+	BENCH_BASELINE,
+	BENCH_MALLOC,
+	BENCH_SLAB
+} bench_allocator_t;
+
+const char *benchAllocatorNames[] = {"baseline", "malloc", "slab"};
+
+/**
+ * Operation of the trace: the object in `slot` is freed, when there is one, and an object of
+ * `size` bytes allocated in its place.
+ */
+typedef struct bench_op
+{
+	uint32_t slot;
+	uint32_t size;
+} bench_op_t;
+
+/**
+ * Monotonic wall clock time.
+ * @return nanoseconds since an arbitrary origin
+ */
+uint64_t benchNanoseconds(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+}
+
+/**
+ * Draws an allocation size from `benchSizeBands`.
+ * @param rng generator to draw from
+ * @return The size (unit: bytes)
+ */
+uint32_t benchDrawSize(xoshiro_t *rng)
+{
+	size_t percent = xoshiroBelow(rng, 100);
+	size_t band = 0;
+
+	while (band + 1 < BENCH_SIZE_BANDS && percent >= benchSizeBands[band].percent)
+	{
+		percent -= benchSizeBands[band].percent;
+		band++;
+	}
+
+	bench_size_band_t range = benchSizeBands[band];
+
+	return (uint32_t)(range.minSize + xoshiroBelow(rng, range.maxSize - range.minSize + 1));
+}
+
+/**
+ * Builds a mixed-size trace: `live` allocations fill every slot, then each operation replaces
+ * the object of a random slot with a new one of a random size.
+ * @param live number of slots, objects live at once
+ * @param ops number of operations, including the `live` first allocations
+ * @return The trace, exits on allocation failure
+ */
+bench_op_t *benchTrace(size_t live, size_t ops)
+{
+	bench_op_t *trace = malloc(ops * sizeof(bench_op_t));
+	xoshiro_t rng;
+
+	if (NULL == trace)
+	{
+		fputs("Could not allocate the trace\n", stderr);
+		exit(EXIT_FAILURE);
+	}
+
+	xoshiroSeed(&rng, DATA_SEED);
+
+	for (size_t ix = 0; ix < ops; ix++)
+	{
+		trace[ix].slot = (uint32_t)((ix < live) ? ix : xoshiroBelow(&rng, live));
+		trace[ix].size = benchDrawSize(&rng);
+	}
+
+	return trace;
+}
+
+/**
+ * Replays `trace` with `allocator`, writing the first byte of every object, then frees the
+ * objects left. Prints one CSV line: time per operation, and peak resident memory of the process,
+ * and for the slab allocator its memory statistics with all slots full at the end of the trace.
+ * @param allocator allocator to replay with
+ * @param trace operations to replay
+ * @param live number of slots of the trace
+ * @param ops number of operations of the trace
+ * @return false if an allocation failed
+ */
+bool benchReplay(bench_allocator_t allocator, const bench_op_t *trace, size_t live, size_t ops)
+{
+	unsigned char **pointers = calloc(live, sizeof(unsigned char *));
+	uint32_t *sizes = calloc(live, sizeof(uint32_t));
+	slab_allocator_t *slab = slab_create();
+	slab_stats_t stats;
+	bool success = true;
+
+	if (NULL == pointers || NULL == sizes || NULL == slab)
+	{
+		fputs("Could not allocate the benchmark buffers\n", stderr);
+		exit(EXIT_FAILURE);
+	}
+
+	uint64_t start = benchNanoseconds();
+
+	for (size_t ix = 0; ix < ops; ix++)
+	{
+		uint32_t slot = trace[ix].slot;
+		uint32_t size = trace[ix].size;
+		unsigned char *object;
+
+		switch (allocator)
+		{
+		case BENCH_BASELINE:
+			object = (unsigned char *)&sizes[slot];
+			break;
+		case BENCH_MALLOC:
+			free(pointers[slot]);
+			object = malloc(size);
+			break;
+		default:
+			slab_free(slab, pointers[slot], sizes[slot]);
+			object = slab_alloc(slab, size);
+			break;
+		}
+
+		if (NULL == object)
+		{
+			success = false;
+			break;
+		}
+
+		object[0] = (unsigned char)ix;
+		pointers[slot] = (BENCH_BASELINE == allocator) ? NULL : object;
+		sizes[slot] = size;
+	}
+
+	uint64_t nanoseconds = benchNanoseconds() - start;
+	slab_stats(slab, &stats);
+
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+
+	printf("%s,%zu,%zu,%.2f,%.3f,%ld", benchAllocatorNames[allocator], ops, live,
+		   (double)nanoseconds / (double)ops, (double)ops * 1000.0 / (double)nanoseconds,
+		   (long)usage.ru_maxrss);
+
+	if (BENCH_SLAB == allocator)
+	{
+		printf(",%llu,%llu,%llu,%llu,%.4f\n", (unsigned long long)stats.bytesRequested,
+			   (unsigned long long)stats.bytesPadding, (unsigned long long)stats.bytesFree,
+			   (unsigned long long)stats.bytesMapped, stats.fragmentation);
+	}
+	else
+	{
+		printf(",,,,,\n");
+	}
+	fflush(stdout);
+
+	for (size_t ix = 0; ix < live; ix++)
+	{
+		if (BENCH_MALLOC == allocator)
+		{
+			free(pointers[ix]);
+		}
+		else if (BENCH_SLAB == allocator)
+		{
+			slab_free(slab, pointers[ix], sizes[ix]);
+		}
+	}
+
+	slab_destroy(slab);
+	free(sizes);
+	free(pointers);
+
+	return success;
+}
+
+/**
+ * Benchmarks `slab_alloc` against `malloc` on a mixed-size trace, see `benchSizeBands`: a number
+ * of objects stay live while random ones are replaced by objects of other sizes. Each allocator
+ * replays the trace in a process of its own, so that the peak resident memory reported (unit:
+ * KiB) is its own; the baseline replays it without allocating, and is the part of that memory
+ * taken by the benchmark itself. Prints, as CSV, the time per operation and the peak resident
+ * memory of each allocator, with the statistics of the slab allocator.
+ * Usage: bench-slab [liveObjects [operations]]
+ * @return EXIT_SUCCESS on success. EXIT_FAILURE otherwise
+ */
+int main(int argc, char *argv[])
+{
+	size_t live = 100000;
+	size_t ops = 4000000;
+
+	if (argc > 1)
+	{
+		live = strtoull(argv[1], NULL, 0);
+	}
+
+	if (argc > 2)
+	{
+		ops = strtoull(argv[2], NULL, 0);
+	}
+
+	if ((argc > 3) || (0 == live) || (live > UINT32_MAX) || (ops < live))
+	{
+		fprintf(stderr, "usage: %s [liveObjects >= 1 [operations >= liveObjects]]\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	bench_op_t *trace = benchTrace(live, ops);
+
+	printf("allocator,operations,live_objects,ns_per_op,ops_per_us,max_rss_kib,"
+		   "bytes_requested,bytes_padding,bytes_free,bytes_mapped,fragmentation\n");
+	fflush(stdout);
+
+	for (size_t allocator = BENCH_BASELINE; allocator <= BENCH_SLAB; allocator++)
+	{
+		pid_t child = fork();
+		int status = 0;
+
+		if (child < 0)
+		{
+			perror("fork");
+			return EXIT_FAILURE;
+		}
+
+		if (0 == child)
+		{
+			exit(benchReplay(allocator, trace, live, ops) ? EXIT_SUCCESS : EXIT_FAILURE);
+		}
+
+		if (waitpid(child, &status, 0) < 0 || !WIFEXITED(status) ||
+			EXIT_SUCCESS != WEXITSTATUS(status))
+		{
+			fputs("Allocation failed\n", stderr);
+			return EXIT_FAILURE;
+		}
+	}
+
+	free(trace);
+
+	return EXIT_SUCCESS;
+}
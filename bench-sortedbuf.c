@@ -0,0 +1,185 @@
+#include "lib/sortedbuf_lib.h"
+#include "lib/timsort_lib.h"
+#include "lib/timsortbench.h"
+
+// batch lengths of the benchmark
+#define BENCH_BATCHES 3
+
+// largest number of elements re-sorted by `ingestResort`, above which it is skipped
+#define BENCH_RESORT_MAX_WORK ((uint64_t)1 << 32)
+
+const size_t benchBatchLengths[BENCH_BATCHES] = {16, 256, 4096};
+
+/**
+ * Ways of keeping the ingested elements sorted after every batch.
+ * - INGEST_RESORT: append the batch to an array and `timSort` all of it
+ * - INGEST_LEVELS: `sortedBufferAppend`, read once all batches are in
+ * - INGEST_LEVELS_VIEW: `sortedBufferAppend`, then `sortedBufferView` after every batch
+ */
+typedef enum ingest_mode
+{
+	INGEST_RESORT,
+	INGEST_LEVELS,
+	INGEST_LEVELS_VIEW
+} ingest_mode_t;
+
+const char *ingestNames[] = {"resort", "levels", "levels-view"};
+
+/**
+ * Ingests `input` in batches of `batch` elements the way `mode` says.
+ * @param mode way of keeping the elements sorted
+ * @param arr array of `length` elements, used by `INGEST_RESORT`
+ * @param input elements to ingest, in batch order
+ * @param length The legth of `input`
+ * @param batch number of elements of each batch, the last one may be shorter
+ * @return false if the elements ingested did not end up sorted
+ */
+bool ingest(ingest_mode_t mode, int arr[], int input[], size_t length, size_t batch)
+{
+	if (INGEST_RESORT == mode)
+	{
+		for (size_t lowerBound = 0; lowerBound < length; lowerBound += batch)
+		{
+			size_t upperBound = (length - lowerBound < batch) ? length : lowerBound + batch;
+
+			memcpy(&arr[lowerBound], &input[lowerBound], (upperBound - lowerBound) * sizeof(int));
+			timSort(arr, upperBound);
+		}
+
+		return isSorted(arr, length);
+	}
+
+	sorted_buffer_t buffer;
+	const int *view;
+	size_t viewLength = 0;
+
+	sortedBufferInit(&buffer);
+
+	for (size_t lowerBound = 0; lowerBound < length; lowerBound += batch)
+	{
+		size_t upperBound = (length - lowerBound < batch) ? length : lowerBound + batch;
+
+		sortedBufferAppend(&buffer, &input[lowerBound], upperBound - lowerBound);
+
+		if (INGEST_LEVELS_VIEW == mode)
+		{
+			view = sortedBufferView(&buffer, &viewLength);
+		}
+	}
+
+	view = sortedBufferView(&buffer, &viewLength);
+	bool sorted = (length == viewLength) && isSorted((int *)view, viewLength);
+
+	sortedBufferFree(&buffer);
+
+	return sorted;
+}
+
+/**
+ * Times `ingest` and prints one CSV line, after one untimed warm-up run.
+ * @param mode way of keeping the elements sorted
+ * @param inputName name of the input in the CSV
+ * @param arr array of `length` elements, used by `INGEST_RESORT`
+ * @param input elements to ingest
+ * @param length The legth of `input`
+ * @param batch number of elements of each batch
+ * @param repetitions number of timed runs, at most `BENCH_MAX_REPETITIONS`
+ * @return false if a run left the elements unsorted
+ */
+bool benchIngest(ingest_mode_t mode, const char *inputName, int arr[], int input[],
+				 size_t length, size_t batch, size_t repetitions)
+{
+	uint64_t nanoseconds[BENCH_MAX_REPETITIONS];
+	bool sorted = true;
+
+	for (size_t rep = 0; rep <= repetitions; rep++)
+	{
+		uint64_t start = benchNanoseconds();
+		sorted &= ingest(mode, arr, input, length, batch);
+		uint64_t end = benchNanoseconds();
+
+		if (rep > 0)
+		{
+			nanoseconds[rep - 1] = end - start;
+		}
+	}
+
+	benchSortMeasurements(nanoseconds, repetitions);
+
+	printf("hybrid,%s,%s,%zu,%zu,%zu,%llu,%llu,%.3f\n", ingestNames[mode], inputName, length,
+		   batch, repetitions, (unsigned long long)nanoseconds[0],
+		   (unsigned long long)nanoseconds[repetitions / 2],
+		   (double)nanoseconds[repetitions / 2] / (double)length);
+	fflush(stdout);
+
+	return sorted;
+}
+
+/**
+ * Benchmarks keeping a growing set sorted as batches arrive: re-sorting everything after every
+ * batch against the levels of `sorted_buffer_t`, read after every batch or once at the end. Runs
+ * on every input of `benchInputs`, on lengths from 1K elements up to `maxLength`, growing 4 times
+ * at each step, and on every batch length of `benchBatchLengths`. Re-sorting is skipped when it
+ * would move more than `BENCH_RESORT_MAX_WORK` elements. Results are written to stdout as CSV.
+ * Usage: bench-sortedbuf [maxLength [repetitions]]
+ * @return EXIT_SUCCESS on success. EXIT_FAILURE otherwise
+ */
+int main(int argc, char *argv[])
+{
+	size_t maxLength;
+	size_t repetitions;
+
+	if (!benchParseArgs(argc, argv, &maxLength, &repetitions))
+	{
+		return EXIT_FAILURE;
+	}
+
+	printf("abi,algorithm,input,length,batch,repetitions,min_ns,median_ns,ns_per_element\n");
+
+	for (size_t length = 1024; length <= maxLength; length *= 4)
+	{
+		int *arr = malloc(length * sizeof(int));
+		int *input = malloc(length * sizeof(int));
+
+		if (NULL == arr || NULL == input)
+		{
+			fprintf(stderr, "Could not allocate %zu elements\n", length);
+			return EXIT_FAILURE;
+		}
+
+		for (size_t ix_input = 0; ix_input < BENCH_INPUTS; ix_input++)
+		{
+			const char *name = benchInputs[ix_input].name;
+			benchFill(input, length, ix_input);
+
+			for (size_t ix_batch = 0; ix_batch < BENCH_BATCHES; ix_batch++)
+			{
+				size_t batch = benchBatchLengths[ix_batch];
+				bool sorted = true;
+
+				if ((uint64_t)(length / batch) * length <= BENCH_RESORT_MAX_WORK)
+				{
+					sorted &= benchIngest(INGEST_RESORT, name, arr, input, length, batch,
+										  repetitions);
+				}
+				sorted &=
+					benchIngest(INGEST_LEVELS, name, arr, input, length, batch, repetitions);
+				sorted &= benchIngest(INGEST_LEVELS_VIEW, name, arr, input, length, batch,
+									  repetitions);
+
+				if (!sorted)
+				{
+					fprintf(stderr, "Unsorted output\n");
+					return EXIT_FAILURE;
+				}
+			}
+		}
+
+		free(arr);
+		free(input);
+	}
+
+	timSortFreeBuffer();
+
+	return EXIT_SUCCESS;
+}
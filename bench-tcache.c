@@ -0,0 +1,318 @@
+#include "lib/tcache_lib.h"
+#include "lib/timsortdata.h"
+#include <pthread.h>
+#include <string.h>
+#include <time.h>
+
+// sizes of the allocations, drawn uniformly (unit: bytes)
+#define BENCH_MIN_SIZE 16
+#define BENCH_MAX_SIZE 512
+
+/**
+ * Allocators compared by the benchmark.
+ * - BENCH_MALLOC: `malloc` and `free`
+ * - BENCH_LOCKED: one slab allocator shared by all threads behind a mutex, the global allocator
+ *                 every allocation serializes on
+ * - BENCH_TCACHE: `tcache_alloc` and `tcache_free`, a thread cache per thread
+ */
+typedef enum bench_allocator
+{
+	BENCH_MALLOC,
+	BENCH_LOCKED,
+	BENCH_TCACHE
+} bench_allocator_t;
+
+const char *benchAllocatorNames[] = {"malloc", "slab-locked", "tcache"};
+
+/**
+ * Workloads of the benchmark: each thread allocates a batch of objects per round, then frees
+ * - BENCH_LOCAL: its own batch
+ * - BENCH_REMOTE: the batch of the previous thread, all frees are remote
+ */
+typedef enum bench_workload
+{
+	BENCH_LOCAL,
+	BENCH_REMOTE
+} bench_workload_t;
+
+const char *benchWorkloadNames[] = {"local", "remote"};
+
+/**
+ * State shared by the threads of a run.
+ * - allocator, workload, threads, objects, rounds: parameters of the run
+ * - barrier: separates the allocations and the frees of each round
+ * - lock, slab: allocator of `BENCH_LOCKED`
+ * - cache: allocator of `BENCH_TCACHE`
+ * - pointers, sizes: batches of the threads, `objects` per thread
+ * - failed: an allocation failed
+ */
+typedef struct bench_shared
+{
+	bench_allocator_t allocator;
+	bench_workload_t workload;
+	size_t threads;
+	size_t objects;
+	size_t rounds;
+	pthread_barrier_t barrier;
+	pthread_mutex_t lock;
+	slab_allocator_t *slab;
+	tcache_t *cache;
+	unsigned char **pointers;
+	uint32_t *sizes;
+	bool failed;
+} bench_shared_t;
+
+/**
+ * Arguments of a thread of a run.
+ */
+typedef struct bench_thread_arg
+{
+	bench_shared_t *shared;
+	size_t id;
+} bench_thread_arg_t;
+
+/**
+ * Monotonic wall clock time.
+ * @return nanoseconds since an arbitrary origin
+ */
+uint64_t benchNanoseconds(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+}
+
+/**
+ * Thread of a run: per round, allocates a batch of objects and writes their first byte, waits for
+ * all threads, frees a batch as the workload says, and waits again.
+ * @param arg see `bench_thread_arg_t`
+ * @return NULL
+ */
+void *benchThread(void *arg)
+{
+	bench_shared_t *shared = ((bench_thread_arg_t *)arg)->shared;
+	size_t id = ((bench_thread_arg_t *)arg)->id;
+	size_t victim = (BENCH_LOCAL == shared->workload) ? id : (id + shared->threads - 1) %
+																  shared->threads;
+	unsigned char **mine = &shared->pointers[id * shared->objects];
+	uint32_t *mySizes = &shared->sizes[id * shared->objects];
+	unsigned char **theirs = &shared->pointers[victim * shared->objects];
+	uint32_t *theirSizes = &shared->sizes[victim * shared->objects];
+	tcache_thread_t *thread = NULL;
+
+	if (BENCH_TCACHE == shared->allocator && NULL == (thread = tcache_thread_create(shared->cache)))
+	{
+		shared->failed = true;
+	}
+
+	pthread_barrier_wait(&shared->barrier);
+
+	for (size_t round = 0; round < shared->rounds && !shared->failed; round++)
+	{
+		for (size_t ix = 0; ix < shared->objects; ix++)
+		{
+			switch (shared->allocator)
+			{
+			case BENCH_MALLOC:
+				mine[ix] = malloc(mySizes[ix]);
+				break;
+			case BENCH_LOCKED:
+				pthread_mutex_lock(&shared->lock);
+				mine[ix] = slab_alloc(shared->slab, mySizes[ix]);
+				pthread_mutex_unlock(&shared->lock);
+				break;
+			default:
+				mine[ix] = tcache_alloc(thread, mySizes[ix]);
+				break;
+			}
+
+			if (NULL == mine[ix])
+			{
+				shared->failed = true;
+				break;
+			}
+
+			mine[ix][0] = (unsigned char)ix;
+		}
+
+		pthread_barrier_wait(&shared->barrier);
+
+		for (size_t ix = 0; ix < shared->objects && !shared->failed; ix++)
+		{
+			switch (shared->allocator)
+			{
+			case BENCH_MALLOC:
+				free(theirs[ix]);
+				break;
+			case BENCH_LOCKED:
+				pthread_mutex_lock(&shared->lock);
+				slab_free(shared->slab, theirs[ix], theirSizes[ix]);
+				pthread_mutex_unlock(&shared->lock);
+				break;
+			default:
+				tcache_free(thread, theirs[ix], theirSizes[ix]);
+				break;
+			}
+		}
+
+		pthread_barrier_wait(&shared->barrier);
+	}
+
+	if (NULL != thread)
+	{
+		tcache_thread_release(thread);
+	}
+
+	return NULL;
+}
+
+/**
+ * Runs one allocator on one workload with `threads` threads.
+ * @param shared parameters of the run, the rest is set up here
+ * @return The time of the run (unit: ns), 0 if an allocation failed
+ */
+uint64_t benchRun(bench_shared_t *shared)
+{
+	pthread_t threads[TCACHE_MAX_THREADS];
+	bench_thread_arg_t args[TCACHE_MAX_THREADS];
+	size_t total = shared->threads * shared->objects;
+	xoshiro_t rng;
+
+	shared->pointers = calloc(total, sizeof(unsigned char *));
+	shared->sizes = malloc(total * sizeof(uint32_t));
+	shared->slab = slab_create();
+	shared->cache = tcache_create();
+	shared->failed = false;
+
+	if (NULL == shared->pointers || NULL == shared->sizes || NULL == shared->slab ||
+		NULL == shared->cache || 0 != pthread_mutex_init(&shared->lock, NULL) ||
+		0 != pthread_barrier_init(&shared->barrier, NULL, shared->threads + 1))
+	{
+		fputs("Could not allocate the benchmark buffers\n", stderr);
+		exit(EXIT_FAILURE);
+	}
+
+	xoshiroSeed(&rng, DATA_SEED);
+	for (size_t ix = 0; ix < total; ix++)
+	{
+		shared->sizes[ix] =
+			(uint32_t)(BENCH_MIN_SIZE + xoshiroBelow(&rng, BENCH_MAX_SIZE - BENCH_MIN_SIZE + 1));
+	}
+
+	for (size_t ix = 0; ix < shared->threads; ix++)
+	{
+		args[ix].shared = shared;
+		args[ix].id = ix;
+
+		if (0 != pthread_create(&threads[ix], NULL, benchThread, &args[ix]))
+		{
+			fputs("Could not create the benchmark threads\n", stderr);
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	// the threads have created their thread caches; each round is timed from here
+	pthread_barrier_wait(&shared->barrier);
+	uint64_t start = benchNanoseconds();
+
+	for (size_t round = 0; round < shared->rounds && !shared->failed; round++)
+	{
+		pthread_barrier_wait(&shared->barrier);
+		pthread_barrier_wait(&shared->barrier);
+	}
+
+	uint64_t nanoseconds = benchNanoseconds() - start;
+
+	for (size_t ix = 0; ix < shared->threads; ix++)
+	{
+		pthread_join(threads[ix], NULL);
+	}
+
+	bool failed = shared->failed;
+
+	pthread_barrier_destroy(&shared->barrier);
+	pthread_mutex_destroy(&shared->lock);
+	tcache_destroy(shared->cache);
+	slab_destroy(shared->slab);
+	free(shared->sizes);
+	free(shared->pointers);
+
+	return failed ? 0 : nanoseconds;
+}
+
+/**
+ * Benchmarks the allocation throughput of `tcache_alloc` against `malloc` and a slab allocator
+ * behind a global lock, with 1, 2, 4 ... up to `maxThreads` threads, on the workloads of
+ * `bench_workload_t`. Prints, as CSV, the operations (allocations and frees) per second of each
+ * run and its speedup over the same allocator with one thread; linear scaling is a speedup equal
+ * to the number of threads, given as many idle cores.
+ * Usage: bench-tcache [maxThreads [objectsPerRound [rounds]]]
+ * @return EXIT_SUCCESS on success. EXIT_FAILURE otherwise
+ */
+int main(int argc, char *argv[])
+{
+	size_t maxThreads = 32;
+	size_t objects = 4096;
+	size_t rounds = 200;
+
+	if (argc > 1)
+	{
+		maxThreads = strtoull(argv[1], NULL, 0);
+	}
+
+	if (argc > 2)
+	{
+		objects = strtoull(argv[2], NULL, 0);
+	}
+
+	if (argc > 3)
+	{
+		rounds = strtoull(argv[3], NULL, 0);
+	}
+
+	if ((argc > 4) || (0 == maxThreads) || (maxThreads > TCACHE_MAX_THREADS) || (0 == objects) ||
+		(0 == rounds))
+	{
+		fprintf(stderr, "usage: %s [1 <= maxThreads <= %d [objectsPerRound >= 1 [rounds >= 1]]]\n",
+				argv[0], TCACHE_MAX_THREADS);
+		return EXIT_FAILURE;
+	}
+
+	printf("allocator,workload,threads,objects_per_round,rounds,seconds,mops_per_s,speedup\n");
+
+	for (size_t workload = BENCH_LOCAL; workload <= BENCH_REMOTE; workload++)
+	{
+		for (size_t allocator = BENCH_MALLOC; allocator <= BENCH_TCACHE; allocator++)
+		{
+			double single = 0.0;
+
+			for (size_t threads = 1; threads <= maxThreads; threads *= 2)
+			{
+				bench_shared_t shared = {.allocator = allocator,
+										 .workload = workload,
+										 .threads = threads,
+										 .objects = objects,
+										 .rounds = rounds};
+				uint64_t nanoseconds = benchRun(&shared);
+
+				if (0 == nanoseconds)
+				{
+					fputs("Allocation failed\n", stderr);
+					return EXIT_FAILURE;
+				}
+
+				double mops = 2.0 * (double)(threads * objects * rounds) * 1000.0 /
+							  (double)nanoseconds;
+				single = (1 == threads) ? mops : single;
+
+				printf("%s,%s,%zu,%zu,%zu,%.3f,%.2f,%.2f\n", benchAllocatorNames[allocator],
+					   benchWorkloadNames[workload], threads, objects, rounds,
+					   (double)nanoseconds / 1e9, mops, mops / single);
+				fflush(stdout);
+			}
+		}
+	}
+
+	return EXIT_SUCCESS;
+}
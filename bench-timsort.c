@@ -0,0 +1,105 @@
+#include "lib/timsort_lib.h"
+#include "lib/timsortbench.h"
+
+/**
+ * Hybrid `timSort`, with the signature expected by `benchRun`.
+ * @param arr Array to sort
+ * @param length The legth of `arr`
+ */
+void benchTimSort(int arr[], size_t length)
+{
+	timSort(arr, length);
+}
+
+/**
+ * `timSortAdaptive`, with the signature expected by `benchRun`.
+ * @param arr Array to sort
+ * @param length The legth of `arr`
+ */
+void benchTimSortAdaptive(int arr[], size_t length)
+{
+	timSortAdaptive(arr, length);
+}
+
+/**
+ * `radixSort` by 8 bit digits, with the signature expected by `benchRun`.
+ * @param arr Array to sort
+ * @param length The legth of `arr`
+ */
+void benchRadixSort8(int arr[], size_t length)
+{
+	radixSort(arr, length, 8);
+}
+
+/**
+ * `radixSort` by 11 bit digits, with the signature expected by `benchRun`.
+ * @param arr Array to sort
+ * @param length The legth of `arr`
+ */
+void benchRadixSort11(int arr[], size_t length)
+{
+	radixSort(arr, length, 11);
+}
+
+/**
+ * Benchmarks the hybrid `timSort`, its adaptive front end `timSortAdaptive` and the radix sorts it
+ * dispatches to against libc `qsort`, on every input of `benchInputs` and on
+ * lengths from 1K elements up to `maxLength`, growing 4 times at each step. Results are written
+ * to stdout as CSV, see `benchHeader`.
+ * Usage: bench-timsort [maxLength [repetitions]]
+ * @return EXIT_SUCCESS on success. EXIT_FAILURE otherwise
+ */
+int main(int argc, char *argv[])
+{
+	size_t maxLength;
+	size_t repetitions;
+
+	if (!benchParseArgs(argc, argv, &maxLength, &repetitions))
+	{
+		return EXIT_FAILURE;
+	}
+
+	benchHeader();
+
+	for (size_t length = 1024; length <= maxLength; length *= 4)
+	{
+		int *arr = malloc(length * sizeof(int));
+		int *input = malloc(length * sizeof(int));
+
+		if (NULL == arr || NULL == input)
+		{
+			fprintf(stderr, "Could not allocate %zu elements\n", length);
+			return EXIT_FAILURE;
+		}
+
+		for (size_t ix_input = 0; ix_input < BENCH_INPUTS; ix_input++)
+		{
+			const char *name = benchInputs[ix_input].name;
+			benchFill(input, length, ix_input);
+
+			bool sorted =
+				benchRun("hybrid", "timsort", name, benchTimSort, arr, input, length, repetitions);
+			sorted &= benchRun("hybrid", "timsort-adaptive", name, benchTimSortAdaptive, arr, input,
+							   length, repetitions);
+			sorted &= benchRun("hybrid", "radix8", name, benchRadixSort8, arr, input, length,
+							   repetitions);
+			sorted &= benchRun("hybrid", "radix11", name, benchRadixSort11, arr, input, length,
+							   repetitions);
+			sorted &=
+				benchRun("hybrid", "qsort", name, benchQsort, arr, input, length, repetitions);
+
+			if (!sorted)
+			{
+				fprintf(stderr, "Unsorted output\n");
+				return EXIT_FAILURE;
+			}
+		}
+
+		free(arr);
+		free(input);
+	}
+
+	timSortFreeBuffer();
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,89 @@
+#include "lib/timsort_lib_purecap.h"
+#include "lib/timsortbench.h"
+#include <assert.h>
+#include <cheri/cheric.h>
+
+/**
+ * Purecap `timSort`, with the signature expected by `benchRun`. The length is carried by the
+ * bounds of `arr`, which `main` allocates to hold exactly `length` elements.
+ * @param arr Array to sort
+ * @param length The legth of `arr`
+ */
+void benchTimSort(int arr[], size_t length)
+{
+	assert(cheri_getlen(arr) == length * sizeof(int));
+
+	timSort(arr);
+}
+
+/**
+ * Same as `benchTimSort`, with a capability narrowed for every run and every merge, to measure
+ * what hoisting the bounds out of the kernels saves.
+ * @param arr Array to sort
+ * @param length The legth of `arr`
+ */
+void benchTimSortPerCall(int arr[], size_t length)
+{
+	timSortSetBoundsMode(BOUNDS_MODE_PER_CALL);
+	benchTimSort(arr, length);
+	timSortSetBoundsMode(BOUNDS_MODE_HOISTED);
+}
+
+/**
+ * Benchmarks the purecap `timSort`, in both bounds modes, against libc `qsort`, on every input of
+ * `benchInputs` and on lengths from 1K elements up to `maxLength`, growing 4 times at each step.
+ * Results are written to stdout as CSV, in the same format as `bench-timsort`.
+ * Usage: bench-timsort_purecap [maxLength [repetitions]]
+ * @return EXIT_SUCCESS on success. EXIT_FAILURE otherwise
+ */
+int main(int argc, char *argv[])
+{
+	size_t maxLength;
+	size_t repetitions;
+
+	if (!benchParseArgs(argc, argv, &maxLength, &repetitions))
+	{
+		return EXIT_FAILURE;
+	}
+
+	benchHeader();
+
+	for (size_t length = 1024; length <= maxLength; length *= 4)
+	{
+		int *chunk = malloc(length * sizeof(int));
+		int *input = malloc(length * sizeof(int));
+
+		if (NULL == chunk || NULL == input)
+		{
+			fprintf(stderr, "Could not allocate %zu elements\n", length);
+			return EXIT_FAILURE;
+		}
+
+		// power of two lengths, so that the bounds of `arr` are exactly representable
+		int *arr = cheri_setbounds(chunk, length * sizeof(int));
+
+		for (size_t ix_input = 0; ix_input < BENCH_INPUTS; ix_input++)
+		{
+			const char *name = benchInputs[ix_input].name;
+			benchFill(input, length, ix_input);
+
+			bool sorted =
+				benchRun("purecap", "timsort", name, benchTimSort, arr, input, length, repetitions);
+			sorted &= benchRun("purecap", "timsort-per-call", name, benchTimSortPerCall, arr, input,
+							   length, repetitions);
+			sorted &=
+				benchRun("purecap", "qsort", name, benchQsort, arr, input, length, repetitions);
+
+			if (!sorted)
+			{
+				fprintf(stderr, "Unsorted output\n");
+				return EXIT_FAILURE;
+			}
+		}
+
+		free(chunk);
+		free(input);
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,66 @@
+#include "lib/extsort_lib.h"
+#include <string.h>
+
+/**
+ * Sorts a binary file of int32 or int64 records that may be larger than memory, see `extSort`,
+ * and prints the phase timings and I/O counters, to tune the memory budget against the
+ * throughput of the disk.
+ * Usage: extsort input output [int32|int64 [memoryMiB [tempDir]]]
+ * - the records are int32 by default
+ * - the memory budget is 256 MiB by default
+ * - temporary files go to $TMPDIR, or /tmp, by default
+ * @return EXIT_SUCCESS on success. EXIT_FAILURE otherwise
+ */
+int main(int argc, char *argv[])
+{
+	extsort_record_t record = EXTSORT_INT32;
+	size_t memoryBytes = (size_t)256 << 20;
+	const char *tempDir = (NULL != getenv("TMPDIR")) ? getenv("TMPDIR") : "/tmp";
+	bool usage = (argc < 3) || (argc > 6);
+
+	if (!usage && argc > 3)
+	{
+		usage = (0 != strcmp(argv[3], "int32")) && (0 != strcmp(argv[3], "int64"));
+		record = (0 == strcmp(argv[3], "int64")) ? EXTSORT_INT64 : EXTSORT_INT32;
+	}
+
+	if (!usage && argc > 4)
+	{
+		memoryBytes = (size_t)strtoull(argv[4], NULL, 0) << 20;
+		usage = (0 == memoryBytes);
+	}
+
+	if (!usage && argc > 5)
+	{
+		tempDir = argv[5];
+	}
+
+	if (usage)
+	{
+		fprintf(stderr, "usage: %s input output [int32|int64 [memoryMiB [tempDir]]]\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	extsort_stats_t stats;
+	if (!extSort(argv[1], argv[2], record, memoryBytes, tempDir, &stats))
+	{
+		return EXIT_FAILURE;
+	}
+
+	double runSeconds = (double)stats.runNanoseconds / 1e9;
+	double mergeSeconds = (double)stats.mergeNanoseconds / 1e9;
+	double mebibytes = (double)(1 << 20);
+
+	printf("records:      %llu\n", (unsigned long long)stats.records);
+	printf("runs:         %zu, merged in %zu passes\n", stats.runs, stats.mergePasses);
+	printf("run phase:    %.3f s, of which sorting %.3f s\n", runSeconds,
+		   (double)stats.sortNanoseconds / 1e9);
+	printf("merge phase:  %.3f s\n", mergeSeconds);
+	printf("read:         %.1f MiB\n", (double)stats.bytesRead / mebibytes);
+	printf("written:      %.1f MiB\n", (double)stats.bytesWritten / mebibytes);
+	printf("throughput:   %.1f MiB/s read and written\n",
+		   (double)(stats.bytesRead + stats.bytesWritten) / mebibytes /
+			   (runSeconds + mergeSeconds));
+
+	return EXIT_SUCCESS;
+}
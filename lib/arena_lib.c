@@ -0,0 +1,263 @@
+#include "arena_lib.h"
+
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#if defined(__CHERI_PURE_CAPABILITY__)
+#include <cheriintrin.h>
+#endif
+
+/**
+ * Maps a region of `capacity` bytes for `arena`. The region is not linked into the arena.
+ * @param arena arena the region is for, its statistics are updated
+ * @param capacity size of the region (unit: bytes), a multiple of the page size
+ * @return The region, NULL if it could not be mapped
+ */
+arena_region_t *arena_map_region(arena_t *arena, size_t capacity)
+{
+	arena_region_t *region = malloc(sizeof(arena_region_t));
+	if (NULL == region)
+	{
+		return NULL;
+	}
+
+	void *base = mmap(NULL, capacity, PROT_READ | PROT_WRITE, MAP_ANON | MAP_PRIVATE, -1, 0);
+	if (MAP_FAILED == base)
+	{
+		free(region);
+		return NULL;
+	}
+
+	region->base = base;
+	region->capacity = capacity;
+	region->used = 0;
+	region->next = NULL;
+	arena->stats.regionsMapped++;
+
+	return region;
+}
+
+/**
+ * Unmaps `region` and frees its descriptor.
+ * @param arena arena the region belongs to, its statistics are updated
+ * @param region region to unmap, already unlinked from the arena
+ */
+void arena_unmap_region(arena_t *arena, arena_region_t *region)
+{
+	munmap(region->base, region->capacity);
+	free(region);
+	arena->stats.regionsUnmapped++;
+}
+
+/**
+ * Bytes of a region taken by an allocation of `size` bytes: `size` rounded up to
+ * `ARENA_ALIGNMENT`, and on CHERI to a length that capability bounds can represent exactly.
+ * @param size size of the allocation (unit: bytes)
+ * @return The padded size (unit: bytes)
+ */
+size_t arena_padded_size(size_t size)
+{
+	size = (0 == size) ? 1 : size;
+	size = (size + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1);
+
+#if defined(__CHERI_PURE_CAPABILITY__)
+	size = cheri_representable_length(size);
+#endif
+
+	return size;
+}
+
+/**
+ * Alignment of an allocation of `size` bytes: `ARENA_ALIGNMENT`, and on CHERI at least the one
+ * needed for bounds of that length to be exact.
+ * @param size size of the allocation (unit: bytes)
+ * @return The alignment (unit: bytes), a power of two
+ */
+size_t arena_padded_alignment(size_t size)
+{
+	size_t alignment = ARENA_ALIGNMENT;
+
+#if defined(__CHERI_PURE_CAPABILITY__)
+	size_t representable = ~cheri_representable_alignment_mask(arena_padded_size(size)) + 1;
+	alignment = (representable > alignment) ? representable : alignment;
+#else
+	(void)size;
+#endif
+
+	return alignment;
+}
+
+/**
+ * First offset of `region` from `region->used` on at which an allocation is aligned to
+ * `alignment`.
+ * @param region region to allocate from
+ * @param alignment alignment of the allocation, a power of two
+ * @return The offset, possibly beyond the end of the region
+ */
+static size_t arena_aligned_offset(const arena_region_t *region, size_t alignment)
+{
+	uintptr_t address = (uintptr_t)(region->base + region->used);
+
+	return region->used + ((alignment - (size_t)(address & (alignment - 1))) & (alignment - 1));
+}
+
+/**
+ * Creates an empty arena. No memory is mapped until the first allocation.
+ * @param regionBytes size of the regions to map (unit: bytes), rounded up to the page size;
+ *                    0 for `ARENA_DEFAULT_REGION_BYTES`
+ * @return The arena, NULL if it could not be allocated
+ */
+arena_t *arena_create(size_t regionBytes)
+{
+	arena_t *arena = malloc(sizeof(arena_t));
+	if (NULL == arena)
+	{
+		return NULL;
+	}
+
+	size_t page = (size_t)sysconf(_SC_PAGESIZE);
+	regionBytes = (0 == regionBytes) ? ARENA_DEFAULT_REGION_BYTES : regionBytes;
+
+	arena->regionBytes = (regionBytes + page - 1) / page * page;
+	arena->regions = NULL;
+	arena->spare = NULL;
+	memset(&arena->stats, 0, sizeof(arena_stats_t));
+
+	return arena;
+}
+
+/**
+ * Allocates `size` bytes from `arena`, by bumping the offset of its current region. On CHERI the
+ * pointer returned has bounds of `size` bytes, rounded up only when that length is not
+ * representable, so that neighbouring allocations cannot be reached through it; in a build
+ * without capabilities it is a plain pointer. Allocations larger than a quarter of a region that
+ * do not fit in the current one get a region of their own, so that the end of the current one is
+ * not left unused.
+ * @param arena arena to allocate from
+ * @param size number of bytes to allocate
+ * @return The memory, aligned to `ARENA_ALIGNMENT` at least, NULL if no region could be mapped
+ */
+void *arena_alloc(arena_t *arena, size_t size)
+{
+	size_t padded = arena_padded_size(size);
+	size_t alignment = arena_padded_alignment(size);
+	arena_region_t *region = arena->regions;
+	size_t offset = (NULL != region) ? arena_aligned_offset(region, alignment) : 0;
+
+	if (NULL == region || offset + padded > region->capacity)
+	{
+		size_t page = (size_t)sysconf(_SC_PAGESIZE);
+
+		if (padded + alignment > arena->regionBytes / 4)
+		{
+			// regions are page aligned, larger alignments are found within the extra bytes
+			size_t extra = (alignment > page) ? alignment : 0;
+			size_t capacity = (padded + extra + page - 1) / page * page;
+
+			region = arena_map_region(arena, capacity);
+			if (NULL == region)
+			{
+				return NULL;
+			}
+
+			// behind the current region, which keeps serving small allocations
+			if (NULL == arena->regions)
+			{
+				arena->regions = region;
+			}
+			else
+			{
+				region->next = arena->regions->next;
+				arena->regions->next = region;
+			}
+		}
+		else
+		{
+			region = arena->spare;
+
+			if (NULL != region)
+			{
+				arena->spare = region->next;
+			}
+			else if (NULL == (region = arena_map_region(arena, arena->regionBytes)))
+			{
+				return NULL;
+			}
+
+			region->next = arena->regions;
+			arena->regions = region;
+		}
+
+		offset = arena_aligned_offset(region, alignment);
+	}
+
+	void *object = region->base + offset;
+	arena->stats.bytesPadded += offset - region->used + padded - size;
+	region->used = offset + padded;
+
+	arena->stats.allocations++;
+	arena->stats.bytesRequested += size;
+
+#if defined(__CHERI_PURE_CAPABILITY__)
+	object = cheri_bounds_set(object, size);
+#endif
+
+	return object;
+}
+
+/**
+ * Frees all allocations of `arena` at once. Regions of the arena's region size are kept for the
+ * next allocations, larger ones are unmapped. Pointers handed out before remain valid
+ * capabilities to memory that will be handed out again; they must not be used.
+ * @param arena arena to reset
+ */
+void arena_reset(arena_t *arena)
+{
+	arena_region_t *region = arena->regions;
+
+	while (NULL != region)
+	{
+		arena_region_t *next = region->next;
+
+		if (region->capacity == arena->regionBytes)
+		{
+			region->used = 0;
+			region->next = arena->spare;
+			arena->spare = region;
+		}
+		else
+		{
+			arena_unmap_region(arena, region);
+		}
+
+		region = next;
+	}
+
+	arena->regions = NULL;
+	arena->stats.resets++;
+}
+
+/**
+ * Unmaps all regions of `arena` and frees it.
+ * @param arena arena to destroy, may be NULL
+ */
+void arena_destroy(arena_t *arena)
+{
+	if (NULL == arena)
+	{
+		return;
+	}
+
+	arena_reset(arena);
+
+	while (NULL != arena->spare)
+	{
+		arena_region_t *next = arena->spare->next;
+
+		arena_unmap_region(arena, arena->spare);
+		arena->spare = next;
+	}
+
+	free(arena);
+}
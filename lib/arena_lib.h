@@ -0,0 +1,69 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// alignment of every allocation: that of a capability
+#define ARENA_ALIGNMENT 16
+
+// size of the regions mapped by `arena_create` when 0 is asked for
+#define ARENA_DEFAULT_REGION_BYTES (1 << 20)
+
+/**
+ * Region of memory mapped for an arena, allocated from by bumping `used`.
+ * - base: start of the mapping, with bounds covering all of it
+ * - capacity: size of the mapping (unit: bytes)
+ * - used: bytes handed out, including alignment padding
+ * - next: next region of the arena
+ */
+typedef struct arena_region
+{
+	char *base;
+	size_t capacity;
+	size_t used;
+	struct arena_region *next;
+} arena_region_t;
+
+/**
+ * Statistics of an arena, since it was created.
+ * - allocations: number of successful `arena_alloc` calls
+ * - bytesRequested: bytes asked for by these calls
+ * - bytesPadded: bytes added to them for alignment and representable bounds
+ * - regionsMapped, regionsUnmapped: `mmap` and `munmap` calls
+ * - resets: number of `arena_reset` calls
+ */
+typedef struct arena_stats
+{
+	uint64_t allocations;
+	uint64_t bytesRequested;
+	uint64_t bytesPadded;
+	uint64_t regionsMapped;
+	uint64_t regionsUnmapped;
+	uint64_t resets;
+} arena_stats_t;
+
+/**
+ * Arena allocator: memory is bump allocated from large mapped regions and only given back all at
+ * once, by `arena_reset` or `arena_destroy`.
+ * - regionBytes: size of the regions, allocations too large for one get a region of their own
+ * - regions: regions of the arena, the one being allocated from first
+ * - spare: regions emptied by `arena_reset`, reused before mapping new ones
+ * - stats: see `arena_stats_t`
+ */
+typedef struct arena
+{
+	size_t regionBytes;
+	arena_region_t *regions;
+	arena_region_t *spare;
+	arena_stats_t stats;
+} arena_t;
+
+arena_region_t *arena_map_region(arena_t *arena, size_t capacity);
+void arena_unmap_region(arena_t *arena, arena_region_t *region);
+size_t arena_padded_size(size_t size);
+size_t arena_padded_alignment(size_t size);
+arena_t *arena_create(size_t regionBytes);
+void *arena_alloc(arena_t *arena, size_t size);
+void arena_reset(arena_t *arena);
+void arena_destroy(arena_t *arena);
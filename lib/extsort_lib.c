@@ -0,0 +1,766 @@
+#include "extsort_lib.h"
+#include "timsort_lib.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/**
+ * Monotonic wall clock time, for the phase timings of `extsort_stats_t`.
+ * @return nanoseconds since an arbitrary origin
+ */
+uint64_t extSortNanoseconds(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+}
+
+/**
+ * Reads `bytes` bytes at `offset` of `fd`, or up to the end of the file.
+ * @param fd file to read
+ * @param buffer output
+ * @param bytes number of bytes to read
+ * @param offset position of the first byte to read
+ * @param bytesDone output, number of bytes read
+ * @return false on a read error
+ */
+bool extSortReadFully(int fd, void *buffer, size_t bytes, uint64_t offset, size_t *bytesDone)
+{
+	*bytesDone = 0;
+
+	while (*bytesDone < bytes)
+	{
+		ssize_t done = pread(fd, (char *)buffer + *bytesDone, bytes - *bytesDone,
+							 (off_t)(offset + *bytesDone));
+
+		if (done < 0 && EINTR == errno)
+		{
+			continue;
+		}
+
+		if (done < 0)
+		{
+			return false;
+		}
+
+		if (0 == done)
+		{
+			break;
+		}
+
+		*bytesDone += (size_t)done;
+	}
+
+	return true;
+}
+
+/**
+ * Writes `bytes` bytes at the current position of `fd`.
+ * @param fd file to write
+ * @param buffer data to write
+ * @param bytes number of bytes to write
+ * @return false on a write error
+ */
+bool extSortWriteFully(int fd, const void *buffer, size_t bytes)
+{
+	size_t bytesDone = 0;
+
+	while (bytesDone < bytes)
+	{
+		ssize_t done = write(fd, (const char *)buffer + bytesDone, bytes - bytesDone);
+
+		if (done < 0 && EINTR == errno)
+		{
+			continue;
+		}
+
+		if (done <= 0)
+		{
+			return false;
+		}
+
+		bytesDone += (size_t)done;
+	}
+
+	return true;
+}
+
+/**
+ * Creates an anonymous temporary file in `tempDir`; it is unlinked straight away, so that it
+ * disappears when it is closed, whatever happens to the process.
+ * @param tempDir directory of the file
+ * @return The file descriptor, -1 on failure
+ */
+int extSortTempFile(const char *tempDir)
+{
+	char path[PATH_MAX];
+
+	if (snprintf(path, sizeof(path), "%s/extsort-XXXXXX", tempDir) >= (int)sizeof(path))
+	{
+		return -1;
+	}
+
+	int fd = mkstemp(path);
+	if (fd >= 0)
+	{
+		unlink(path);
+	}
+
+	return fd;
+}
+
+/**
+ * Number of records of the chunks sorted in memory. A chunk and the merge buffer `timSort` needs
+ * for it, half as long, fit in `memoryBytes` together.
+ * @param memoryBytes memory budget
+ * @param record type of the records
+ * @return The number of records of a chunk
+ */
+size_t extSortChunkRecords(size_t memoryBytes, extsort_record_t record)
+{
+	size_t recordBytes = (EXTSORT_INT32 == record) ? sizeof(int32_t) : sizeof(int64_t);
+
+	return memoryBytes / 3 * 2 / recordBytes;
+}
+
+/**
+ * Largest number of runs merged at once. Each run is read through two buffers and the output is
+ * written through one twice as long, none of them shorter than `EXTSORT_MIN_BUFFER`.
+ * @param memoryBytes memory budget
+ * @return The fan-in of the merge, below 2 when the budget is too small to merge
+ */
+size_t extSortFanIn(size_t memoryBytes)
+{
+	return memoryBytes / (2 * EXTSORT_MIN_BUFFER) - 1;
+}
+
+/**
+ * Sorts a chunk in memory, merging through `scratch`.
+ * @param chunk records to sort
+ * @param records number of records of `chunk`
+ * @param scratch merge buffer of at least `timSortBufferLength(records)` records
+ * @param record type of the records
+ */
+void sortChunk(void *chunk, size_t records, void *scratch, extsort_record_t record)
+{
+	bool sorted;
+
+	if (EXTSORT_INT32 == record)
+	{
+		sorted = timSortWithBuffer(chunk, records, scratch, timSortBufferLength(records));
+	}
+	else
+	{
+		sorted = timSortWithBuffer_i64(chunk, records, scratch, timSortBufferLength(records));
+	}
+
+	assert(sorted);
+}
+
+/**
+ * Appends the run `[offset, offset + records)` to `runs`.
+ * @param runs runs of the temporary file
+ * @param offset position of the run (unit: bytes)
+ * @param records number of records of the run
+ */
+void pushSortedRun(extsort_runs_t *runs, uint64_t offset, uint64_t records)
+{
+	if (runs->count == runs->capacity)
+	{
+		runs->capacity = (0 == runs->capacity) ? 64 : 2 * runs->capacity;
+		runs->offset = realloc(runs->offset, runs->capacity * sizeof(uint64_t));
+		runs->records = realloc(runs->records, runs->capacity * sizeof(uint64_t));
+
+		if (NULL == runs->offset || NULL == runs->records)
+		{
+			fputs("Could not allocate the run list\n", stderr);
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	runs->offset[runs->count] = offset;
+	runs->records[runs->count] = records;
+	runs->count++;
+}
+
+/**
+ * Body of the prefetch thread of a merge: fills the buffers requested with `requestRefill`, in
+ * order, until `stop` is set and no request is left.
+ * @param arg the `extsort_merge_t` of the merge
+ * @return NULL
+ */
+void *prefetchWorker(void *arg)
+{
+	extsort_merge_t *merge = arg;
+
+	pthread_mutex_lock(&merge->lock);
+
+	while (true)
+	{
+		while (0 == merge->queueLength && !merge->stop)
+		{
+			pthread_cond_wait(&merge->changed, &merge->lock);
+		}
+
+		if (0 == merge->queueLength)
+		{
+			break;
+		}
+
+		size_t request = merge->queue[merge->queueHead];
+		merge->queueHead = (merge->queueHead + 1) % (2 * merge->runCount);
+		merge->queueLength--;
+
+		extsort_run_t *run = &merge->runs[request / 2];
+		size_t ix_buffer = request % 2;
+		size_t bytes = run->filled[ix_buffer] * merge->recordBytes;
+		uint64_t offset = run->bufferOffset[ix_buffer];
+
+		// read without the lock, the merge keeps consuming the other buffer meanwhile
+		pthread_mutex_unlock(&merge->lock);
+		size_t bytesDone;
+		bool read = extSortReadFully(merge->fd, run->buffer[ix_buffer], bytes, offset, &bytesDone);
+		pthread_mutex_lock(&merge->lock);
+
+		merge->failed |= !read || (bytesDone != bytes);
+		merge->bytesRead += bytesDone;
+		run->ready[ix_buffer] = true;
+		pthread_cond_broadcast(&merge->changed);
+	}
+
+	pthread_mutex_unlock(&merge->lock);
+
+	return NULL;
+}
+
+/**
+ * Queues the refill of buffer `ix_buffer` of run `ix_run` with the next records of the run. A
+ * run that has no records left gets an empty buffer straight away.
+ * @param merge merge state
+ * @param ix_run index of the run
+ * @param ix_buffer index of the buffer, 0 or 1
+ */
+void requestRefill(extsort_merge_t *merge, size_t ix_run, size_t ix_buffer)
+{
+	extsort_run_t *run = &merge->runs[ix_run];
+	size_t records = (run->remaining < merge->capacity) ? (size_t)run->remaining : merge->capacity;
+
+	run->bufferOffset[ix_buffer] = run->offset;
+	run->filled[ix_buffer] = records;
+	run->offset += records * merge->recordBytes;
+	run->remaining -= records;
+
+	pthread_mutex_lock(&merge->lock);
+
+	if (0 == records)
+	{
+		run->ready[ix_buffer] = true;
+	}
+	else
+	{
+		run->ready[ix_buffer] = false;
+		merge->queue[(merge->queueHead + merge->queueLength) % (2 * merge->runCount)] =
+			2 * ix_run + ix_buffer;
+		merge->queueLength++;
+		pthread_cond_broadcast(&merge->changed);
+	}
+
+	pthread_mutex_unlock(&merge->lock);
+}
+
+/**
+ * Waits for the buffer `run` is about to consume to be filled.
+ * @param merge merge state
+ * @param run run being merged
+ * @return false if the run is exhausted
+ */
+bool waitRun(extsort_merge_t *merge, extsort_run_t *run)
+{
+	pthread_mutex_lock(&merge->lock);
+
+	while (!run->ready[run->current])
+	{
+		pthread_cond_wait(&merge->changed, &merge->lock);
+	}
+
+	pthread_mutex_unlock(&merge->lock);
+
+	return run->filled[run->current] > 0;
+}
+
+/**
+ * Moves `run` past `count` records of its current buffer. Once the buffer is consumed, its refill
+ * is queued and the run switches to its other buffer.
+ * @param merge merge state
+ * @param run run being merged
+ * @param count number of records consumed, at most what is left in the current buffer
+ * @return false if the run is exhausted
+ */
+bool advanceRun(extsort_merge_t *merge, extsort_run_t *run, size_t count)
+{
+	run->position += count;
+
+	if (run->position < run->filled[run->current])
+	{
+		return true;
+	}
+
+	size_t consumed = run->current;
+	run->current ^= 1;
+	run->position = 0;
+	requestRefill(merge, (size_t)(run - merge->runs), consumed);
+
+	return waitRun(merge, run);
+}
+
+/**
+ * Next record of `run`, widened to 64 bits.
+ * @param merge merge state
+ * @param run run being merged, not exhausted
+ * @return The record
+ */
+int64_t runHead(extsort_merge_t *merge, extsort_run_t *run)
+{
+	const char *buffer = run->buffer[run->current];
+
+	if (EXTSORT_INT32 == merge->record)
+	{
+		return ((const int32_t *)buffer)[run->position];
+	}
+
+	return ((const int64_t *)buffer)[run->position];
+}
+
+/**
+ * Restores the heap order of `heap`, a binary min-heap of run indices keyed by `runHead`, after
+ * the head of run `heap[ix]` has grown.
+ * @param merge merge state
+ * @param heap run indices
+ * @param heapLength number of entries of `heap`
+ * @param ix position of the entry to move down
+ */
+void siftDown(extsort_merge_t *merge, size_t heap[], size_t heapLength, size_t ix)
+{
+	size_t entry = heap[ix];
+	int64_t key = runHead(merge, &merge->runs[entry]);
+
+	while (2 * ix + 1 < heapLength)
+	{
+		size_t child = 2 * ix + 1;
+		int64_t childKey = runHead(merge, &merge->runs[heap[child]]);
+
+		if (child + 1 < heapLength)
+		{
+			int64_t rightKey = runHead(merge, &merge->runs[heap[child + 1]]);
+
+			if (rightKey < childKey)
+			{
+				child++;
+				childKey = rightKey;
+			}
+		}
+
+		if (key <= childKey)
+		{
+			break;
+		}
+
+		heap[ix] = heap[child];
+		ix = child;
+	}
+
+	heap[ix] = entry;
+}
+
+/**
+ * Merges sorted runs of `inFd` and appends the result to `outFd`. The runs are read through
+ * double buffers filled by a prefetch thread, and the output is written in blocks; all buffers
+ * together fit in `memoryBytes`.
+ * @param inFd file holding the runs
+ * @param runOffset position of each run (unit: bytes)
+ * @param runRecords number of records of each run
+ * @param runCount number of runs, at most `extSortFanIn(memoryBytes)`
+ * @param outFd file to append the merged run to
+ * @param record type of the records
+ * @param memoryBytes memory budget
+ * @param stats statistics, `bytesRead` and `bytesWritten` are updated
+ * @return false on an I/O error
+ */
+bool mergeRunsToFile(int inFd, const uint64_t runOffset[], const uint64_t runRecords[],
+					 size_t runCount, int outFd, extsort_record_t record, size_t memoryBytes,
+					 extsort_stats_t *stats)
+{
+	size_t recordBytes = (EXTSORT_INT32 == record) ? sizeof(int32_t) : sizeof(int64_t);
+	extsort_merge_t merge = {.fd = inFd,
+							 .recordBytes = recordBytes,
+							 .capacity = memoryBytes / ((2 * runCount + 2) * recordBytes),
+							 .runCount = runCount,
+							 .record = record};
+	size_t outCapacity = 2 * merge.capacity;
+	size_t bufferBytes = merge.capacity * recordBytes;
+
+	assert(merge.capacity > 0);
+
+	merge.runs = calloc(runCount, sizeof(extsort_run_t));
+	merge.queue = malloc(2 * runCount * sizeof(size_t));
+	size_t *heap = malloc(runCount * sizeof(size_t));
+	char *buffers = malloc((2 * runCount + 2) * bufferBytes);
+
+	if (NULL == merge.runs || NULL == merge.queue || NULL == heap || NULL == buffers)
+	{
+		fputs("Could not allocate the merge buffers\n", stderr);
+		exit(EXIT_FAILURE);
+	}
+
+	pthread_t prefetch;
+	pthread_mutex_init(&merge.lock, NULL);
+	pthread_cond_init(&merge.changed, NULL);
+
+	if (0 != pthread_create(&prefetch, NULL, prefetchWorker, &merge))
+	{
+		fputs("Could not start the prefetch thread\n", stderr);
+		exit(EXIT_FAILURE);
+	}
+
+	// both buffers of every run are requested up front
+	for (size_t ix = 0; ix < runCount; ix++)
+	{
+		extsort_run_t *run = &merge.runs[ix];
+
+		run->offset = runOffset[ix];
+		run->remaining = runRecords[ix];
+		run->buffer[0] = &buffers[2 * ix * bufferBytes];
+		run->buffer[1] = &buffers[(2 * ix + 1) * bufferBytes];
+
+		requestRefill(&merge, ix, 0);
+		requestRefill(&merge, ix, 1);
+	}
+
+	size_t heapLength = 0;
+	for (size_t ix = 0; ix < runCount; ix++)
+	{
+		if (waitRun(&merge, &merge.runs[ix]))
+		{
+			heap[heapLength++] = ix;
+		}
+	}
+
+	for (size_t ix = heapLength / 2; ix-- > 0;)
+	{
+		siftDown(&merge, heap, heapLength, ix);
+	}
+
+	char *out = &buffers[2 * runCount * bufferBytes];
+	size_t outLength = 0;
+	bool written = true;
+
+	while (heapLength > 0 && written)
+	{
+		extsort_run_t *run = &merge.runs[heap[0]];
+		size_t count = 1;
+
+		if (1 == heapLength)
+		{
+			// the last run is copied a block at a time
+			count = min(run->filled[run->current] - run->position, outCapacity - outLength);
+			memcpy(&out[outLength * recordBytes],
+				   &run->buffer[run->current][run->position * recordBytes], count * recordBytes);
+		}
+		else if (EXTSORT_INT32 == record)
+		{
+			((int32_t *)out)[outLength] = (int32_t)runHead(&merge, run);
+		}
+		else
+		{
+			((int64_t *)out)[outLength] = runHead(&merge, run);
+		}
+
+		outLength += count;
+
+		if (outLength == outCapacity)
+		{
+			written = extSortWriteFully(outFd, out, outLength * recordBytes);
+			stats->bytesWritten += outLength * recordBytes;
+			outLength = 0;
+		}
+
+		if (!advanceRun(&merge, run, count))
+		{
+			heap[0] = heap[--heapLength];
+		}
+
+		if (heapLength > 1)
+		{
+			siftDown(&merge, heap, heapLength, 0);
+		}
+	}
+
+	if (written && outLength > 0)
+	{
+		written = extSortWriteFully(outFd, out, outLength * recordBytes);
+		stats->bytesWritten += outLength * recordBytes;
+	}
+
+	// requests still queued after a write error are served before the thread exits
+	pthread_mutex_lock(&merge.lock);
+	merge.stop = true;
+	pthread_cond_broadcast(&merge.changed);
+	pthread_mutex_unlock(&merge.lock);
+	pthread_join(prefetch, NULL);
+
+	pthread_cond_destroy(&merge.changed);
+	pthread_mutex_destroy(&merge.lock);
+
+	stats->bytesRead += merge.bytesRead;
+
+	free(buffers);
+	free(heap);
+	free(merge.queue);
+	free(merge.runs);
+
+	return written && !merge.failed;
+}
+
+/**
+ * Run phase of `extSort`: reads `inFd` one chunk at a time, sorts each chunk in memory and
+ * appends it to a temporary file as a sorted run. An input that fits in a single chunk is
+ * written straight to `outFd` instead.
+ * @param inFd input file
+ * @param outFd output file
+ * @param record type of the records
+ * @param memoryBytes memory budget
+ * @param tempDir directory of the temporary file
+ * @param runs output, the runs written
+ * @param stats statistics
+ * @return false on an I/O error, or when the input does not hold a whole number of records
+ */
+bool writeRuns(int inFd, int outFd, extsort_record_t record, size_t memoryBytes,
+			   const char *tempDir, extsort_runs_t *runs, extsort_stats_t *stats)
+{
+	size_t recordBytes = (EXTSORT_INT32 == record) ? sizeof(int32_t) : sizeof(int64_t);
+	size_t chunkRecords = extSortChunkRecords(memoryBytes, record);
+	void *chunk = malloc(chunkRecords * recordBytes);
+	void *scratch = malloc(timSortBufferLength(chunkRecords) * recordBytes);
+
+	if (NULL == chunk || NULL == scratch)
+	{
+		fputs("Could not allocate the sort chunk\n", stderr);
+		exit(EXIT_FAILURE);
+	}
+
+	uint64_t inputOffset = 0;
+	uint64_t runOffset = 0;
+	bool ok = true;
+
+	while (ok)
+	{
+		size_t bytesDone;
+		ok = extSortReadFully(inFd, chunk, chunkRecords * recordBytes, inputOffset, &bytesDone);
+		stats->bytesRead += bytesDone;
+		inputOffset += bytesDone;
+
+		if (!ok || 0 == bytesDone)
+		{
+			break;
+		}
+
+		if (0 != bytesDone % recordBytes)
+		{
+			fputs("The input does not hold a whole number of records\n", stderr);
+			ok = false;
+			break;
+		}
+
+		size_t records = bytesDone / recordBytes;
+		stats->records += records;
+
+		uint64_t sortStart = extSortNanoseconds();
+		sortChunk(chunk, records, scratch, record);
+		stats->sortNanoseconds += extSortNanoseconds() - sortStart;
+
+		// the whole input fits in the first chunk: no run is needed
+		if (0 == inputOffset - bytesDone && records < chunkRecords)
+		{
+			ok = extSortWriteFully(outFd, chunk, bytesDone);
+			stats->bytesWritten += bytesDone;
+			break;
+		}
+
+		if (runs->fd < 0)
+		{
+			runs->fd = extSortTempFile(tempDir);
+			if (runs->fd < 0)
+			{
+				fputs("Could not create a temporary file\n", stderr);
+				ok = false;
+				break;
+			}
+		}
+
+		ok = extSortWriteFully(runs->fd, chunk, bytesDone);
+		stats->bytesWritten += bytesDone;
+		pushSortedRun(runs, runOffset, records);
+		runOffset += bytesDone;
+	}
+
+	free(scratch);
+	free(chunk);
+
+	stats->runs = runs->count;
+
+	return ok;
+}
+
+/**
+ * Merge phase of `extSort`: merges `runs` `extSortFanIn(memoryBytes)` at a time, into a second
+ * temporary file, until few enough runs are left to merge them into `outFd` in one last pass.
+ * @param runs sorted runs, replaced by the runs of each pass
+ * @param outFd output file
+ * @param record type of the records
+ * @param memoryBytes memory budget
+ * @param tempDir directory of the temporary file
+ * @param stats statistics
+ * @return false on an I/O error
+ */
+bool mergePasses(extsort_runs_t *runs, int outFd, extsort_record_t record, size_t memoryBytes,
+				 const char *tempDir, extsort_stats_t *stats)
+{
+	size_t recordBytes = (EXTSORT_INT32 == record) ? sizeof(int32_t) : sizeof(int64_t);
+	size_t fanIn = extSortFanIn(memoryBytes);
+	int otherFd = -1;
+	bool ok = true;
+
+	while (ok && runs->count > fanIn)
+	{
+		if (otherFd < 0)
+		{
+			otherFd = extSortTempFile(tempDir);
+		}
+
+		// the runs of two passes ago are no longer needed
+		if (otherFd < 0 || lseek(otherFd, 0, SEEK_SET) < 0)
+		{
+			fputs("Could not create a temporary file\n", stderr);
+			ok = false;
+			break;
+		}
+
+		size_t merged = 0;
+		uint64_t offset = 0;
+
+		for (size_t ix = 0; ok && ix < runs->count; ix += fanIn)
+		{
+			size_t count = min(fanIn, runs->count - ix);
+			uint64_t records = 0;
+
+			for (size_t jx = ix; jx < ix + count; jx++)
+			{
+				records += runs->records[jx];
+			}
+
+			ok = mergeRunsToFile(runs->fd, &runs->offset[ix], &runs->records[ix], count, otherFd,
+								 record, memoryBytes, stats);
+
+			// the merged run replaces the first of its inputs, which have all been read
+			runs->offset[merged] = offset;
+			runs->records[merged] = records;
+			merged++;
+			offset += records * recordBytes;
+		}
+
+		int fd = runs->fd;
+		runs->fd = otherFd;
+		otherFd = fd;
+		runs->count = merged;
+		stats->mergePasses++;
+	}
+
+	if (ok && runs->count > 0)
+	{
+		ok = mergeRunsToFile(runs->fd, runs->offset, runs->records, runs->count, outFd, record,
+							 memoryBytes, stats);
+		stats->mergePasses++;
+	}
+
+	if (otherFd >= 0)
+	{
+		close(otherFd);
+	}
+
+	return ok;
+}
+
+/**
+ * Sorts a binary file of native endian int32 or int64 records that may be larger than memory.
+ *
+ * The input is read in chunks that fit in `memoryBytes`, each chunk is sorted with `timSort` and
+ * written to a temporary file as a sorted run, in large sequential writes. The runs are then
+ * merged into the output, in several passes when there are more than `extSortFanIn(memoryBytes)`
+ * of them. Memory use stays within `memoryBytes`, plus a few small bookkeeping arrays.
+ * @param inputPath file to sort
+ * @param outputPath file to write the sorted records to, replaced if it exists
+ * @param record type of the records
+ * @param memoryBytes memory budget, at least 6 * `EXTSORT_MIN_BUFFER`
+ * @param tempDir directory of the temporary files
+ * @param stats output, timings and I/O counters of the sort
+ * @return true on success. false, after printing the reason, on failure
+ */
+bool extSort(const char *inputPath, const char *outputPath, extsort_record_t record,
+			 size_t memoryBytes, const char *tempDir, extsort_stats_t *stats)
+{
+	*stats = (extsort_stats_t){0};
+
+	if (extSortFanIn(memoryBytes) < 2)
+	{
+		fprintf(stderr, "The memory budget must be at least %d bytes\n", 6 * EXTSORT_MIN_BUFFER);
+		return false;
+	}
+
+	int inFd = open(inputPath, O_RDONLY);
+	if (inFd < 0)
+	{
+		fprintf(stderr, "Could not open %s\n", inputPath);
+		return false;
+	}
+
+	int outFd = open(outputPath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (outFd < 0)
+	{
+		fprintf(stderr, "Could not create %s\n", outputPath);
+		close(inFd);
+		return false;
+	}
+
+	extsort_runs_t runs = {.fd = -1};
+
+	uint64_t start = extSortNanoseconds();
+	bool ok = writeRuns(inFd, outFd, record, memoryBytes, tempDir, &runs, stats);
+	stats->runNanoseconds = extSortNanoseconds() - start;
+
+	start = extSortNanoseconds();
+	ok = ok && mergePasses(&runs, outFd, record, memoryBytes, tempDir, stats);
+	stats->mergeNanoseconds = extSortNanoseconds() - start;
+
+	if (!ok)
+	{
+		fprintf(stderr, "Could not sort %s into %s\n", inputPath, outputPath);
+	}
+
+	if (runs.fd >= 0)
+	{
+		close(runs.fd);
+	}
+
+	free(runs.records);
+	free(runs.offset);
+	close(outFd);
+	close(inFd);
+
+	return ok;
+}
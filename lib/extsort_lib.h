@@ -0,0 +1,131 @@
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// smallest read buffer of a run being merged; more runs are merged in several passes
+#define EXTSORT_MIN_BUFFER (64 * 1024)
+
+/**
+ * Records of the files sorted by `extSort`: native endian int32 or int64.
+ */
+typedef enum extsort_record
+{
+	EXTSORT_INT32,
+	EXTSORT_INT64
+} extsort_record_t;
+
+/**
+ * Statistics of one `extSort`.
+ * - records: number of records sorted
+ * - runs: number of sorted runs written by the run phase, 0 when the input fits in one chunk
+ * - mergePasses: number of merge passes, the last one writing the output
+ * - runNanoseconds: time spent reading chunks, sorting them and writing them out
+ * - sortNanoseconds: part of `runNanoseconds` spent sorting
+ * - mergeNanoseconds: time spent merging runs
+ * - bytesRead, bytesWritten: bytes read from and written to files, temporary ones included
+ */
+typedef struct extsort_stats
+{
+	uint64_t records;
+	size_t runs;
+	size_t mergePasses;
+	uint64_t runNanoseconds;
+	uint64_t sortNanoseconds;
+	uint64_t mergeNanoseconds;
+	uint64_t bytesRead;
+	uint64_t bytesWritten;
+} extsort_stats_t;
+
+/**
+ * Sorted runs stored one after the other in a temporary file.
+ * - fd: the file, -1 before it is created
+ * - offset, records: position (unit: bytes) and number of records of each run
+ * - count, capacity: number of runs, and of entries of `offset` and `records`
+ */
+typedef struct extsort_runs
+{
+	int fd;
+	uint64_t *offset;
+	uint64_t *records;
+	size_t count;
+	size_t capacity;
+} extsort_runs_t;
+
+/**
+ * Run being merged, read through two buffers: the merge consumes one while the prefetch thread
+ * fills the other.
+ * - offset: position in the file of the first record not yet requested (unit: bytes)
+ * - remaining: number of records not yet requested
+ * - buffer: the two read buffers
+ * - bufferOffset, filled: position in the file and number of records of each buffer, no records
+ *   once the run is exhausted
+ * - ready: whether each buffer has been filled
+ * - current, position: buffer being consumed and next record in it
+ */
+typedef struct extsort_run
+{
+	uint64_t offset;
+	uint64_t remaining;
+	char *buffer[2];
+	uint64_t bufferOffset[2];
+	size_t filled[2];
+	bool ready[2];
+	size_t current;
+	size_t position;
+} extsort_run_t;
+
+/**
+ * State of the merge of up to `fanIn` runs of one file.
+ * - fd: file holding the runs
+ * - recordBytes, record: size and type of a record
+ * - capacity: number of records of each read buffer
+ * - runs, runCount: runs being merged
+ * - lock, changed: protect and signal changes of the request queue and of `ready`
+ * - queue, queueHead, queueLength: requests of the prefetch thread, as `2 * run + buffer`
+ * - stop: tells the prefetch thread to exit
+ * - failed: set when a read failed
+ * - bytesRead: bytes read by the prefetch thread
+ */
+typedef struct extsort_merge
+{
+	int fd;
+	size_t recordBytes;
+	extsort_record_t record;
+	size_t capacity;
+	extsort_run_t *runs;
+	size_t runCount;
+	pthread_mutex_t lock;
+	pthread_cond_t changed;
+	size_t *queue;
+	size_t queueHead;
+	size_t queueLength;
+	bool stop;
+	bool failed;
+	uint64_t bytesRead;
+} extsort_merge_t;
+
+uint64_t extSortNanoseconds(void);
+bool extSortReadFully(int fd, void *buffer, size_t bytes, uint64_t offset, size_t *bytesDone);
+bool extSortWriteFully(int fd, const void *buffer, size_t bytes);
+int extSortTempFile(const char *tempDir);
+size_t extSortChunkRecords(size_t memoryBytes, extsort_record_t record);
+size_t extSortFanIn(size_t memoryBytes);
+void sortChunk(void *chunk, size_t records, void *scratch, extsort_record_t record);
+void pushSortedRun(extsort_runs_t *runs, uint64_t offset, uint64_t records);
+void *prefetchWorker(void *arg);
+void requestRefill(extsort_merge_t *merge, size_t ix_run, size_t ix_buffer);
+bool waitRun(extsort_merge_t *merge, extsort_run_t *run);
+bool advanceRun(extsort_merge_t *merge, extsort_run_t *run, size_t count);
+int64_t runHead(extsort_merge_t *merge, extsort_run_t *run);
+void siftDown(extsort_merge_t *merge, size_t heap[], size_t heapLength, size_t ix);
+bool mergeRunsToFile(int inFd, const uint64_t runOffset[], const uint64_t runRecords[],
+					 size_t runCount, int outFd, extsort_record_t record, size_t memoryBytes,
+					 extsort_stats_t *stats);
+bool writeRuns(int inFd, int outFd, extsort_record_t record, size_t memoryBytes,
+			   const char *tempDir, extsort_runs_t *runs, extsort_stats_t *stats);
+bool mergePasses(extsort_runs_t *runs, int outFd, extsort_record_t record, size_t memoryBytes,
+				 const char *tempDir, extsort_stats_t *stats);
+bool extSort(const char *inputPath, const char *outputPath, extsort_record_t record,
+			 size_t memoryBytes, const char *tempDir, extsort_stats_t *stats);
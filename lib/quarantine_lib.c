@@ -0,0 +1,548 @@
+#include "quarantine_lib.h"
+
+#include <setjmp.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(__CHERI_PURE_CAPABILITY__)
+#include <cheriintrin.h>
+#endif
+
+// granules of a shadow bitmap
+#define QUARANTINE_BLOCK_GRANULES (SLAB_MIN_BYTES / QUARANTINE_GRANULE)
+
+/**
+ * Monotonic wall clock time.
+ * @return nanoseconds since an arbitrary origin
+ */
+static uint64_t quarantine_nanoseconds(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+}
+
+/**
+ * Slot of the shadow table where the search for the block `block` starts.
+ * @param quarantine quarantine of the table, with a capacity that is a power of two
+ * @param block block number
+ * @return The slot
+ */
+static size_t quarantine_shadow_slot(const quarantine_t *quarantine, uint64_t block)
+{
+	return (size_t)((block * 0x9E3779B97F4A7C15ULL) >> 32) & (quarantine->shadowCapacity - 1);
+}
+
+/**
+ * Finds the shadow bitmap of a block.
+ * @param quarantine quarantine to search
+ * @param block block number
+ * @return The shadow bitmap, NULL if no object in quarantine was ever in the block
+ */
+static quarantine_shadow_t *quarantine_shadow_find(const quarantine_t *quarantine, uint64_t block)
+{
+	if (0 == quarantine->shadowCapacity)
+	{
+		return NULL;
+	}
+
+	size_t slot = quarantine_shadow_slot(quarantine, block);
+
+	while (NULL != quarantine->shadows[slot])
+	{
+		if (quarantine->shadows[slot]->block == block)
+		{
+			return quarantine->shadows[slot];
+		}
+
+		slot = (slot + 1) & (quarantine->shadowCapacity - 1);
+	}
+
+	return NULL;
+}
+
+/**
+ * Finds the shadow bitmap of a block, creating it if there is none. The table is doubled when it
+ * would become more than half full.
+ * @param quarantine quarantine to search
+ * @param block block number
+ * @return The shadow bitmap, NULL if it could not be allocated
+ */
+static quarantine_shadow_t *quarantine_shadow_get(quarantine_t *quarantine, uint64_t block)
+{
+	quarantine_shadow_t *shadow = quarantine_shadow_find(quarantine, block);
+	if (NULL != shadow)
+	{
+		return shadow;
+	}
+
+	if (2 * (quarantine->shadowCount + 1) > quarantine->shadowCapacity)
+	{
+		size_t capacity = (0 == quarantine->shadowCapacity) ? 64 : 2 * quarantine->shadowCapacity;
+		quarantine_shadow_t **shadows = calloc(capacity, sizeof(quarantine_shadow_t *));
+		quarantine_shadow_t **old = quarantine->shadows;
+		size_t oldCapacity = quarantine->shadowCapacity;
+
+		if (NULL == shadows)
+		{
+			return NULL;
+		}
+
+		quarantine->shadows = shadows;
+		quarantine->shadowCapacity = capacity;
+
+		for (size_t ix = 0; ix < oldCapacity; ix++)
+		{
+			if (NULL != old[ix])
+			{
+				size_t slot = quarantine_shadow_slot(quarantine, old[ix]->block);
+
+				while (NULL != shadows[slot])
+				{
+					slot = (slot + 1) & (capacity - 1);
+				}
+
+				shadows[slot] = old[ix];
+			}
+		}
+
+		free(old);
+	}
+
+	shadow = calloc(1, sizeof(quarantine_shadow_t));
+	if (NULL == shadow)
+	{
+		return NULL;
+	}
+
+	size_t slot = quarantine_shadow_slot(quarantine, block);
+
+	while (NULL != quarantine->shadows[slot])
+	{
+		slot = (slot + 1) & (quarantine->shadowCapacity - 1);
+	}
+
+	shadow->block = block;
+	quarantine->shadows[slot] = shadow;
+	quarantine->shadowCount++;
+
+	uint64_t low = block * SLAB_MIN_BYTES;
+	quarantine->low = (low < quarantine->low) ? low : quarantine->low;
+	quarantine->high = (low + SLAB_MIN_BYTES > quarantine->high) ? low + SLAB_MIN_BYTES
+																  : quarantine->high;
+
+	return shadow;
+}
+
+/**
+ * Sets or clears the shadow bits of the granules of `bytes` bytes from `address`, a word of
+ * bitmap at a time.
+ * @param quarantine quarantine of the shadow bitmaps
+ * @param address start of the range, a multiple of `QUARANTINE_GRANULE`
+ * @param bytes size of the range (unit: bytes)
+ * @param set true to set the bits, false to clear them
+ * @return false if a shadow bitmap could not be allocated
+ */
+static bool quarantine_paint(quarantine_t *quarantine, uint64_t address, size_t bytes, bool set)
+{
+	uint64_t granule = address / QUARANTINE_GRANULE;
+	uint64_t last = (address + bytes + QUARANTINE_GRANULE - 1) / QUARANTINE_GRANULE;
+
+	while (granule < last)
+	{
+		uint64_t block = granule / QUARANTINE_BLOCK_GRANULES;
+		uint64_t blockEnd = (block + 1) * QUARANTINE_BLOCK_GRANULES;
+		uint64_t end = (last < blockEnd) ? last : blockEnd;
+		quarantine_shadow_t *shadow = set ? quarantine_shadow_get(quarantine, block)
+										  : quarantine_shadow_find(quarantine, block);
+
+		if (NULL == shadow && set)
+		{
+			return false;
+		}
+
+		while (NULL != shadow && granule < end)
+		{
+			size_t ix = (size_t)(granule % QUARANTINE_BLOCK_GRANULES);
+			size_t bit = ix % 64;
+			size_t count = (64 - bit < end - granule) ? 64 - bit : (size_t)(end - granule);
+			uint64_t mask = (64 == count) ? ~0ULL : ((1ULL << count) - 1) << bit;
+
+			if (set)
+			{
+				shadow->bits[ix / 64] |= mask;
+			}
+			else
+			{
+				shadow->bits[ix / 64] &= ~mask;
+			}
+
+			granule += count;
+		}
+
+		granule = end;
+	}
+
+	return true;
+}
+
+/**
+ * Bytes an allocation of `size` bytes takes in the heap: its size class, or its mapping.
+ * @param quarantine quarantine of the heap
+ * @param size size of the allocation (unit: bytes)
+ * @return The size granted (unit: bytes)
+ */
+static size_t quarantine_granted_size(const quarantine_t *quarantine, size_t size)
+{
+	size_t index = slab_class_index(quarantine->heap, size);
+
+	return (index < quarantine->heap->classes) ? quarantine->heap->class[index].size
+											   : slab_large_bytes(size);
+}
+
+/**
+ * Creates a quarantine allocator with an empty heap.
+ * @param stackTop highest address of the stack to scan, such as `__builtin_frame_address(0)` in
+ *                 `main`; frames above it are not scanned
+ * @param budget bytes of quarantine that trigger a sweep, 0 for `QUARANTINE_DEFAULT_BUDGET`
+ * @return The quarantine, NULL if it could not be allocated
+ */
+quarantine_t *quarantine_create(void *stackTop, size_t budget)
+{
+	quarantine_t *quarantine = malloc(sizeof(quarantine_t));
+	if (NULL == quarantine)
+	{
+		return NULL;
+	}
+
+	memset(quarantine, 0, sizeof(quarantine_t));
+	quarantine->heap = slab_create();
+
+	if (NULL == quarantine->heap)
+	{
+		free(quarantine);
+		return NULL;
+	}
+
+	quarantine->stackTop = stackTop;
+	quarantine->budget = (0 == budget) ? QUARANTINE_DEFAULT_BUDGET : budget;
+	quarantine->low = UINT64_MAX;
+
+	return quarantine;
+}
+
+/**
+ * Adds memory for sweeps to scan besides the registers, the stack and the heap: the globals that
+ * may hold pointers to the heap, or memory allocated elsewhere. Code without capabilities to all
+ * of the data sections cannot find them itself, so they are given here.
+ * @param quarantine quarantine to add to
+ * @param base start of the memory, with bounds covering it
+ * @param bytes size of the memory (unit: bytes)
+ * @return false if the root could not be recorded
+ */
+bool quarantine_add_root(quarantine_t *quarantine, void *base, size_t bytes)
+{
+	if (quarantine->rootCount == quarantine->rootCapacity)
+	{
+		size_t capacity = (0 == quarantine->rootCapacity) ? 8 : 2 * quarantine->rootCapacity;
+		quarantine_region_t *roots =
+			realloc(quarantine->roots, capacity * sizeof(quarantine_region_t));
+
+		if (NULL == roots)
+		{
+			return false;
+		}
+
+		quarantine->roots = roots;
+		quarantine->rootCapacity = capacity;
+	}
+
+	quarantine->roots[quarantine->rootCount].base = base;
+	quarantine->roots[quarantine->rootCount].bytes = bytes;
+	quarantine->rootCount++;
+
+	return true;
+}
+
+/**
+ * Whether a word of memory holds a pointer, the test of `is_pointer` in `stackscan.c`: on CHERI
+ * the capability is valid; in a build without capabilities, conservatively, the word is not NULL.
+ * Such a word may just as well be an integer, so without capabilities sweeps only read: stale
+ * pointers are counted but left in place, and freed objects are handed out again while pointers
+ * to them may remain. Those builds measure the cost of sweeps, not temporal safety.
+ * @param ptr word to test
+ * @return true if the word holds a pointer
+ */
+bool quarantine_is_pointer(void *ptr)
+{
+#if defined(__CHERI_PURE_CAPABILITY__)
+	return cheri_is_valid(ptr);
+#else
+	return NULL != ptr;
+#endif
+}
+
+/**
+ * Whether a pointer refers to an object in quarantine: whether the shadow bit of the base of its
+ * bounds is set, or of its address in a build without capabilities.
+ * @param quarantine quarantine to check
+ * @param ptr pointer found by a scan
+ * @return true if the pointer must be revoked
+ */
+bool quarantine_is_stale(const quarantine_t *quarantine, void *ptr)
+{
+#if defined(__CHERI_PURE_CAPABILITY__)
+	uint64_t address = cheri_base_get(ptr);
+#else
+	uint64_t address = (uint64_t)(uintptr_t)ptr;
+#endif
+
+	if (address < quarantine->low || address >= quarantine->high)
+	{
+		return false;
+	}
+
+	uint64_t granule = address / QUARANTINE_GRANULE;
+	quarantine_shadow_t *shadow =
+		quarantine_shadow_find(quarantine, granule / QUARANTINE_BLOCK_GRANULES);
+	size_t ix = (size_t)(granule % QUARANTINE_BLOCK_GRANULES);
+
+	return NULL != shadow && 0 != (shadow->bits[ix / 64] >> (ix % 64) & 1);
+}
+
+/**
+ * Revokes the pointers to objects in quarantine held in the memory from `start` to `end`: the
+ * scan loop of `scan_range` in `stackscan.c`, over every pointer-aligned word, with stale
+ * pointers revoked rather than printed. On CHERI their tag is cleared, so that they can never be
+ * dereferenced again; in a build without capabilities they are only counted, see
+ * `quarantine_is_pointer`.
+ * @param quarantine quarantine to check pointers against, its statistics are updated
+ * @param start start of the memory, with bounds covering it
+ * @param end end of the memory
+ * @return The number of pointers revoked, or found stale in a build without capabilities
+ */
+size_t quarantine_scan_range(quarantine_t *quarantine, void *start, void *end)
+{
+	size_t misalignment = (size_t)((uintptr_t)start & (sizeof(void *) - 1));
+	char *first = (char *)start + ((sizeof(void *) - misalignment) & (sizeof(void *) - 1));
+	void **location = (void **)first;
+	size_t words = ((char *)end > first) ? (size_t)((char *)end - first) / sizeof(void *) : 0;
+	size_t revoked = 0;
+
+	for (size_t ix = 0; ix < words; ix++)
+	{
+		void *value = location[ix];
+
+		if (quarantine_is_pointer(value))
+		{
+			quarantine->stats.pointersFound++;
+
+			if (quarantine_is_stale(quarantine, value))
+			{
+#if defined(__CHERI_PURE_CAPABILITY__)
+				location[ix] = cheri_tag_clear(value);
+#endif
+				revoked++;
+			}
+		}
+	}
+
+	quarantine->stats.bytesScanned += words * sizeof(void *);
+	quarantine->stats.pointersRevoked += revoked;
+
+	return revoked;
+}
+
+/**
+ * Scans all the memory that may hold pointers to the heap: the registers saved in `registers`,
+ * the stack from the frame of this function up to `stackTop`, the roots and the slabs of the heap.
+ * Not inlined, so that its frame is below that of `quarantine_sweep` and the saved registers.
+ * @param quarantine quarantine to sweep
+ * @param registers registers saved by `setjmp`
+ * @param bytes size of `registers` (unit: bytes)
+ */
+__attribute__((noinline)) static void quarantine_scan_roots(quarantine_t *quarantine,
+															 void *registers, size_t bytes)
+{
+	char *stack = __builtin_frame_address(0);
+
+	quarantine_scan_range(quarantine, registers, (char *)registers + bytes);
+	quarantine_scan_range(quarantine, stack, quarantine->stackTop);
+
+	for (size_t ix = 0; ix < quarantine->rootCount; ix++)
+	{
+		char *base = quarantine->roots[ix].base;
+
+		quarantine_scan_range(quarantine, base, base + quarantine->roots[ix].bytes);
+	}
+
+	for (slab_mapping_t *mapping = quarantine->heap->mappings; NULL != mapping;
+		 mapping = mapping->next)
+	{
+		char *base = mapping->base;
+
+		quarantine_scan_range(quarantine, base, base + mapping->bytes);
+	}
+}
+
+/**
+ * Gives the objects in quarantine back to the heap once no pointer to them is left: clears their
+ * shadow bits and zeroes them, so that the next owner finds none of the old contents.
+ * @param quarantine quarantine to empty
+ */
+static void quarantine_release(quarantine_t *quarantine)
+{
+	for (size_t ix = 0; ix < quarantine->entryCount; ix++)
+	{
+		quarantine_region_t *entry = &quarantine->entries[ix];
+		size_t granted = quarantine_granted_size(quarantine, entry->bytes);
+
+		quarantine_paint(quarantine, (uint64_t)(uintptr_t)entry->base, granted, false);
+
+		if (granted <= SLAB_MAX_SIZE)
+		{
+			memset(entry->base, 0, granted);
+		}
+
+		slab_free(quarantine->heap, entry->base, entry->bytes);
+		quarantine->stats.bytesReleased += granted;
+	}
+
+	quarantine->entryCount = 0;
+	quarantine->quarantinedBytes = 0;
+}
+
+/**
+ * Revokes all pointers to the objects in quarantine and gives them back to the heap, in one
+ * pass over the memory, however many objects there are. The callee-saved registers are spilled
+ * with `setjmp`, revoked in the buffer and restored from it with `longjmp`; the other registers
+ * are saved on the stack by the callers that still need them.
+ * @param quarantine quarantine to sweep
+ */
+void quarantine_sweep(quarantine_t *quarantine)
+{
+	jmp_buf registers;
+	uint64_t start = quarantine_nanoseconds();
+
+	if (0 == setjmp(registers))
+	{
+		quarantine_scan_roots(quarantine, registers, sizeof(jmp_buf));
+		longjmp(registers, 1);
+	}
+
+	quarantine_release(quarantine);
+
+	uint64_t pause = quarantine_nanoseconds() - start;
+
+	quarantine->stats.sweeps++;
+	quarantine->stats.sweepNanoseconds += pause;
+	quarantine->stats.lastPauseNanoseconds = pause;
+	quarantine->stats.maxPauseNanoseconds =
+		(pause > quarantine->stats.maxPauseNanoseconds) ? pause
+														: quarantine->stats.maxPauseNanoseconds;
+}
+
+/**
+ * Allocates `size` bytes from the heap of `quarantine`, see `slab_alloc`.
+ * @param quarantine quarantine to allocate from
+ * @param size number of bytes to allocate
+ * @return The memory, NULL if it could not be allocated
+ */
+void *quarantine_alloc(quarantine_t *quarantine, size_t size)
+{
+	return slab_alloc(quarantine->heap, size);
+}
+
+/**
+ * Puts an allocation in quarantine: it is marked in the shadow bitmap and given back to the heap
+ * by the next sweep, which runs once `budget` bytes are in quarantine. The contents of objects
+ * larger than `SLAB_MAX_SIZE` are not scanned by sweeps: pointers stored in them are not revoked.
+ * Exits if the quarantine cannot grow, rather than free the object unsafely, and on a second free
+ * of an object still in quarantine, which would hand it out twice after the sweep.
+ * @param quarantine quarantine `ptr` was allocated from
+ * @param ptr pointer returned by `quarantine_alloc`, may be NULL
+ * @param size size `ptr` was allocated with (unit: bytes)
+ */
+void quarantine_free(quarantine_t *quarantine, void *ptr, size_t size)
+{
+	if (NULL == ptr)
+	{
+		return;
+	}
+
+	if (quarantine_is_stale(quarantine, ptr))
+	{
+		fputs("Double free of an object in quarantine\n", stderr);
+		exit(EXIT_FAILURE);
+	}
+
+	size_t granted = quarantine_granted_size(quarantine, size);
+
+	if (quarantine->entryCount == quarantine->entryCapacity)
+	{
+		size_t capacity = (0 == quarantine->entryCapacity) ? 64 : 2 * quarantine->entryCapacity;
+		quarantine_region_t *entries =
+			realloc(quarantine->entries, capacity * sizeof(quarantine_region_t));
+
+		if (NULL == entries)
+		{
+			fputs("Could not grow the quarantine\n", stderr);
+			exit(EXIT_FAILURE);
+		}
+
+		quarantine->entries = entries;
+		quarantine->entryCapacity = capacity;
+	}
+
+	if (!quarantine_paint(quarantine, (uint64_t)(uintptr_t)ptr, granted, true))
+	{
+		fputs("Could not allocate the shadow bitmap\n", stderr);
+		exit(EXIT_FAILURE);
+	}
+
+	quarantine->entries[quarantine->entryCount].base = ptr;
+	quarantine->entries[quarantine->entryCount].bytes = size;
+	quarantine->entryCount++;
+	quarantine->quarantinedBytes += granted;
+	quarantine->stats.frees++;
+
+	if (quarantine->quarantinedBytes >= quarantine->budget)
+	{
+		quarantine_sweep(quarantine);
+	}
+}
+
+/**
+ * Unmaps the heap of `quarantine` and frees it, objects in quarantine included. Objects larger
+ * than `SLAB_MAX_SIZE` still in use are not unmapped.
+ * @param quarantine quarantine to destroy, may be NULL
+ */
+void quarantine_destroy(quarantine_t *quarantine)
+{
+	if (NULL == quarantine)
+	{
+		return;
+	}
+
+	for (size_t ix = 0; ix < quarantine->entryCount; ix++)
+	{
+		size_t size = quarantine->entries[ix].bytes;
+
+		if (quarantine_granted_size(quarantine, size) > SLAB_MAX_SIZE)
+		{
+			slab_free(quarantine->heap, quarantine->entries[ix].base, size);
+		}
+	}
+
+	for (size_t ix = 0; ix < quarantine->shadowCapacity; ix++)
+	{
+		free(quarantine->shadows[ix]);
+	}
+
+	slab_destroy(quarantine->heap);
+	free(quarantine->shadows);
+	free(quarantine->roots);
+	free(quarantine->entries);
+	free(quarantine);
+}
@@ -0,0 +1,100 @@
+#include "slab_lib.h"
+
+// unit of the shadow bitmap, and alignment of the capabilities scanned for: that of a capability
+#define QUARANTINE_GRANULE 16
+
+// bytes held in quarantine before a sweep, by default
+#define QUARANTINE_DEFAULT_BUDGET (1 << 20)
+
+// words of the shadow bitmap of one `SLAB_MIN_BYTES` block
+#define QUARANTINE_SHADOW_WORDS (SLAB_MIN_BYTES / QUARANTINE_GRANULE / 64)
+
+/**
+ * Region of memory: an object in quarantine, or a root scanned by sweeps.
+ */
+typedef struct quarantine_region
+{
+	void *base;
+	size_t bytes;
+} quarantine_region_t;
+
+/**
+ * Shadow bitmap of one `SLAB_MIN_BYTES` block: one bit per `QUARANTINE_GRANULE` bytes, set while
+ * they belong to an object in quarantine.
+ * - block: block number, address divided by `SLAB_MIN_BYTES`
+ * - bits: the bitmap, bit `ix % 64` of word `ix / 64` for the granule `ix` of the block
+ */
+typedef struct quarantine_shadow
+{
+	uint64_t block;
+	uint64_t bits[QUARANTINE_SHADOW_WORDS];
+} quarantine_shadow_t;
+
+/**
+ * Statistics of a quarantine allocator, since it was created.
+ * - frees, sweeps: `quarantine_free` calls, and sweeps they or `quarantine_sweep` ran
+ * - bytesReleased: bytes of the objects given back to the heap by sweeps
+ * - bytesScanned: bytes of registers, stack, roots and heap read by sweeps
+ * - pointersFound, pointersRevoked: valid capabilities found by sweeps, and those to objects in
+ *                                   quarantine whose tag was cleared (only counted, in a build
+ *                                   without capabilities)
+ * - sweepNanoseconds, lastPauseNanoseconds, maxPauseNanoseconds: time of all sweeps, of the last
+ *                                                                one and of the longest one
+ */
+typedef struct quarantine_stats
+{
+	uint64_t frees;
+	uint64_t sweeps;
+	uint64_t bytesReleased;
+	uint64_t bytesScanned;
+	uint64_t pointersFound;
+	uint64_t pointersRevoked;
+	uint64_t sweepNanoseconds;
+	uint64_t lastPauseNanoseconds;
+	uint64_t maxPauseNanoseconds;
+} quarantine_stats_t;
+
+/**
+ * Quarantine allocator: objects freed are not handed out again at once but held back until
+ * `budget` bytes are in quarantine; a sweep then clears the tag of every capability to them left
+ * in the registers, the stack, the roots and the heap, and only then are they given back to the
+ * heap. A dangling pointer thus never reaches an object allocated after it was freed.
+ * - heap: slab allocator the objects come from, scanned by sweeps
+ * - stackTop: highest address of the stack scanned by sweeps
+ * - budget, quarantinedBytes: bytes of quarantine that trigger a sweep, and bytes held now
+ * - entries, entryCount, entryCapacity: objects in quarantine
+ * - roots, rootCount, rootCapacity: other memory scanned by sweeps, such as globals
+ * - shadows, shadowCount, shadowCapacity: shadow bitmaps of the blocks holding objects in
+ *   quarantine, a hash table by block number with linear probing
+ * - low, high: addresses covered by the shadow bitmaps
+ * - stats: see `quarantine_stats_t`
+ */
+typedef struct quarantine
+{
+	slab_allocator_t *heap;
+	char *stackTop;
+	size_t budget;
+	size_t quarantinedBytes;
+	quarantine_region_t *entries;
+	size_t entryCount;
+	size_t entryCapacity;
+	quarantine_region_t *roots;
+	size_t rootCount;
+	size_t rootCapacity;
+	quarantine_shadow_t **shadows;
+	size_t shadowCount;
+	size_t shadowCapacity;
+	uint64_t low;
+	uint64_t high;
+	quarantine_stats_t stats;
+} quarantine_t;
+
+quarantine_t *quarantine_create(void *stackTop, size_t budget);
+bool quarantine_add_root(quarantine_t *quarantine, void *base, size_t bytes);
+bool quarantine_is_pointer(void *ptr);
+bool quarantine_is_stale(const quarantine_t *quarantine, void *ptr);
+size_t quarantine_scan_range(quarantine_t *quarantine, void *start, void *end);
+void quarantine_sweep(quarantine_t *quarantine);
+void *quarantine_alloc(quarantine_t *quarantine, size_t size);
+void quarantine_free(quarantine_t *quarantine, void *ptr, size_t size);
+void quarantine_destroy(quarantine_t *quarantine);
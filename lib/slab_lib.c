@@ -0,0 +1,388 @@
+#include "slab_lib.h"
+
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#if defined(__CHERI_PURE_CAPABILITY__)
+#include <cheriintrin.h>
+#endif
+
+/**
+ * Rounds `size` up to `SLAB_MIN_SIZE`, and on CHERI to a length that capability bounds can
+ * represent exactly. Such a length is a multiple of the alignment its exact bounds need.
+ * @param size size to round (unit: bytes)
+ * @return The rounded size (unit: bytes)
+ */
+size_t slab_representable_size(size_t size)
+{
+	size = (0 == size) ? 1 : size;
+	size = (size + SLAB_MIN_SIZE - 1) & ~(size_t)(SLAB_MIN_SIZE - 1);
+
+#if defined(__CHERI_PURE_CAPABILITY__)
+	size = cheri_representable_length(size);
+#endif
+
+	return size;
+}
+
+/**
+ * Bytes mapped for an allocation of `size` bytes, too large for the size classes.
+ * @param size size of the allocation (unit: bytes)
+ * @return The size of its mapping (unit: bytes), a multiple of the page size
+ */
+size_t slab_large_bytes(size_t size)
+{
+	size_t page = (size_t)sysconf(_SC_PAGESIZE);
+
+	return (slab_representable_size(size) + page - 1) / page * page;
+}
+
+/**
+ * Computes the size classes: `SLAB_CLASSES_PER_DOUBLING` sizes evenly spaced between two powers of
+ * two, at least `SLAB_MIN_SIZE` apart, from `SLAB_MIN_SIZE` to `SLAB_MAX_SIZE`, each rounded by
+ * `slab_representable_size`. Sizes that round to the same class are merged.
+ * @param sizes output, the sizes of the classes by increasing size
+ * @param capacity maximum number of classes to write
+ * @return The number of classes
+ */
+size_t slab_size_classes(size_t sizes[], size_t capacity)
+{
+	size_t count = 0;
+	size_t size = SLAB_MIN_SIZE;
+
+	while (size <= SLAB_MAX_SIZE && count < capacity)
+	{
+		size_t representable = slab_representable_size(size);
+
+		if (0 == count || representable > sizes[count - 1])
+		{
+			sizes[count++] = representable;
+		}
+
+		size_t power = 1;
+		while (power * 2 <= size)
+		{
+			power *= 2;
+		}
+
+		size_t spacing = power / SLAB_CLASSES_PER_DOUBLING;
+		size += (spacing > SLAB_MIN_SIZE) ? spacing : SLAB_MIN_SIZE;
+	}
+
+	return count;
+}
+
+/**
+ * Creates a slab allocator with the classes of `slab_size_classes`. No memory is mapped until the
+ * first allocation.
+ * @return The allocator, NULL if it could not be allocated
+ */
+slab_allocator_t *slab_create(void)
+{
+	slab_allocator_t *allocator = malloc(sizeof(slab_allocator_t));
+	if (NULL == allocator)
+	{
+		return NULL;
+	}
+
+	memset(allocator, 0, sizeof(slab_allocator_t));
+
+	size_t sizes[SLAB_MAX_CLASSES];
+	allocator->classes = slab_size_classes(sizes, SLAB_MAX_CLASSES);
+
+	for (size_t ix = 0; ix < allocator->classes; ix++)
+	{
+		size_t slabBytes = SLAB_MIN_OBJECTS * sizes[ix];
+
+		allocator->class[ix].size = sizes[ix];
+		allocator->class[ix].slabBytes = (slabBytes + SLAB_MIN_BYTES - 1) / SLAB_MIN_BYTES *
+										 SLAB_MIN_BYTES;
+	}
+
+	size_t index = 0;
+	for (size_t ix = 0; ix <= SLAB_LOOKUP_BYTES / SLAB_MIN_SIZE; ix++)
+	{
+		while (index < allocator->classes && allocator->class[index].size < ix * SLAB_MIN_SIZE)
+		{
+			index++;
+		}
+
+		allocator->lookup[ix] = (uint8_t)index;
+	}
+
+	return allocator;
+}
+
+/**
+ * Finds the size class of allocations of `size` bytes: the smallest class that holds them.
+ * @param allocator allocator to search
+ * @param size size of the allocation (unit: bytes)
+ * @return The index of the class, `allocator->classes` if the allocation is larger than them all
+ */
+size_t slab_class_index(const slab_allocator_t *allocator, size_t size)
+{
+	if (size <= SLAB_LOOKUP_BYTES)
+	{
+		return allocator->lookup[(size + SLAB_MIN_SIZE - 1) / SLAB_MIN_SIZE];
+	}
+
+	size_t low = 0;
+	size_t high = allocator->classes;
+
+	while (low < high)
+	{
+		size_t middle = low + (high - low) / 2;
+
+		if (allocator->class[middle].size < size)
+		{
+			low = middle + 1;
+		}
+		else
+		{
+			high = middle;
+		}
+	}
+
+	return low;
+}
+
+/**
+ * Maps a new slab for `class`, from which its next objects are carved. Objects are carved only
+ * when handed out, so that the pages of a slab are not touched before they are needed. Slabs are
+ * aligned to `SLAB_MIN_BYTES`, so that no block of that size holds parts of two slabs.
+ * @param allocator allocator of the class, keeps the mapping
+ * @param class class to refill
+ * @return false if the slab could not be mapped
+ */
+bool slab_refill(slab_allocator_t *allocator, slab_class_t *class)
+{
+	slab_mapping_t *mapping = malloc(sizeof(slab_mapping_t));
+	if (NULL == mapping)
+	{
+		return false;
+	}
+
+	// mapped with `SLAB_MIN_BYTES` extra bytes, trimmed so that the slab starts on a multiple
+	char *raw = mmap(NULL, class->slabBytes + SLAB_MIN_BYTES, PROT_READ | PROT_WRITE,
+					 MAP_ANON | MAP_PRIVATE, -1, 0);
+	if (MAP_FAILED == raw)
+	{
+		free(mapping);
+		return false;
+	}
+
+	size_t head = (SLAB_MIN_BYTES - (size_t)((uintptr_t)raw & (SLAB_MIN_BYTES - 1))) &
+				  (SLAB_MIN_BYTES - 1);
+	char *base = raw + head;
+
+	if (head > 0)
+	{
+		munmap(raw, head);
+	}
+	munmap(base + class->slabBytes, SLAB_MIN_BYTES - head);
+
+	mapping->base = base;
+	mapping->bytes = class->slabBytes;
+	mapping->next = allocator->mappings;
+	allocator->mappings = mapping;
+
+	class->next = base;
+	class->remaining = class->slabBytes / class->size;
+	class->slabs++;
+
+	return true;
+}
+
+/**
+ * Allocates `size` bytes from the smallest size class that holds them: a freed object of the
+ * class if there is one, else the next one of its newest slab. On CHERI the pointer returned has
+ * exact bounds of the size of the class, since classes are representable lengths and slabs lay
+ * their objects out at multiples of the alignment they need; in a build without capabilities it
+ * is a plain pointer. Allocations larger than `SLAB_MAX_SIZE` are mapped on their own; on CHERI
+ * they get exact bounds of `cheri_representable_length(size)` when the page alignment of the
+ * mapping is enough for them, and the bounds of their mapping otherwise.
+ * @param allocator allocator to allocate from
+ * @param size number of bytes to allocate
+ * @return The memory, aligned to `SLAB_MIN_SIZE` at least, NULL if it could not be mapped
+ */
+void *slab_alloc(slab_allocator_t *allocator, size_t size)
+{
+	size_t index = slab_class_index(allocator, size);
+
+	if (index == allocator->classes)
+	{
+		size_t bytes = slab_large_bytes(size);
+		slab_mapping_t *mapping = malloc(sizeof(slab_mapping_t));
+		if (NULL == mapping)
+		{
+			return NULL;
+		}
+
+		void *object = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_ANON | MAP_PRIVATE, -1, 0);
+		if (MAP_FAILED == object)
+		{
+			free(mapping);
+			return NULL;
+		}
+
+		mapping->base = object;
+		mapping->bytes = bytes;
+		mapping->next = allocator->largeMappings;
+		allocator->largeMappings = mapping;
+
+		allocator->largeObjects++;
+		allocator->largeBytesRequested += size;
+		allocator->largeBytesMapped += bytes;
+
+#if defined(__CHERI_PURE_CAPABILITY__)
+		// the slack of the last page is not handed out; the mapping keeps its own bounds, which
+		// `munmap` needs
+		size_t exact = cheri_representable_length(size);
+
+		if (0 == (cheri_address_get(object) & ~cheri_representable_alignment_mask(exact)))
+		{
+			object = cheri_bounds_set_exact(object, exact);
+		}
+#endif
+
+		return object;
+	}
+
+	slab_class_t *class = &allocator->class[index];
+	void *object = class->freeList;
+
+	if (NULL != object)
+	{
+		class->freeList = *(void **)object;
+	}
+	else
+	{
+		if (0 == class->remaining && !slab_refill(allocator, class))
+		{
+			return NULL;
+		}
+
+		object = class->next;
+		class->next += class->size;
+		class->remaining--;
+
+#if defined(__CHERI_PURE_CAPABILITY__)
+		object = cheri_bounds_set_exact(object, class->size);
+#endif
+	}
+
+	class->objectsInUse++;
+	class->bytesRequested += size;
+
+	return object;
+}
+
+/**
+ * Gives back an allocation of `allocator`. Objects of the size classes are pushed on the free
+ * list of their class, with the bounds they were handed out with; large ones are unmapped through
+ * the mapping kept by `slab_alloc`, since their own bounds may not cover it.
+ * @param allocator allocator `ptr` was allocated from
+ * @param ptr pointer returned by `slab_alloc`, may be NULL
+ * @param size size `ptr` was allocated with (unit: bytes)
+ */
+void slab_free(slab_allocator_t *allocator, void *ptr, size_t size)
+{
+	if (NULL == ptr)
+	{
+		return;
+	}
+
+	size_t index = slab_class_index(allocator, size);
+
+	if (index == allocator->classes)
+	{
+		slab_mapping_t **link = &allocator->largeMappings;
+
+		while ((char *)(*link)->base != (char *)ptr)
+		{
+			link = &(*link)->next;
+		}
+
+		slab_mapping_t *mapping = *link;
+		*link = mapping->next;
+
+		munmap(mapping->base, mapping->bytes);
+		allocator->largeObjects--;
+		allocator->largeBytesRequested -= size;
+		allocator->largeBytesMapped -= mapping->bytes;
+		free(mapping);
+
+		return;
+	}
+
+	slab_class_t *class = &allocator->class[index];
+
+	*(void **)ptr = class->freeList;
+	class->freeList = ptr;
+	class->objectsInUse--;
+	class->bytesRequested -= size;
+}
+
+/**
+ * Computes the memory statistics of `allocator`, for the allocations in use now.
+ * @param allocator allocator to inspect
+ * @param stats output, see `slab_stats_t`
+ */
+void slab_stats(const slab_allocator_t *allocator, slab_stats_t *stats)
+{
+	memset(stats, 0, sizeof(slab_stats_t));
+
+	for (size_t ix = 0; ix < allocator->classes; ix++)
+	{
+		const slab_class_t *class = &allocator->class[ix];
+		uint64_t inUse = (uint64_t)class->objectsInUse * class->size;
+		uint64_t mapped = (uint64_t)class->slabs * class->slabBytes;
+
+		stats->bytesRequested += class->bytesRequested;
+		stats->bytesInUse += inUse;
+		stats->bytesFree += mapped - inUse;
+		stats->bytesMapped += mapped;
+	}
+
+	stats->bytesRequested += allocator->largeBytesRequested;
+	stats->bytesInUse += allocator->largeBytesMapped;
+	stats->bytesMapped += allocator->largeBytesMapped;
+	stats->bytesPadding = stats->bytesInUse - stats->bytesRequested;
+
+	stats->fragmentation =
+		(0 == stats->bytesMapped)
+			? 0.0
+			: 1.0 - (double)stats->bytesRequested / (double)stats->bytesMapped;
+}
+
+/**
+ * Unmaps all slabs of `allocator` and frees it. Large allocations still in use are not unmapped.
+ * @param allocator allocator to destroy, may be NULL
+ */
+void slab_destroy(slab_allocator_t *allocator)
+{
+	if (NULL == allocator)
+	{
+		return;
+	}
+
+	while (NULL != allocator->mappings)
+	{
+		slab_mapping_t *next = allocator->mappings->next;
+
+		munmap(allocator->mappings->base, allocator->mappings->bytes);
+		free(allocator->mappings);
+		allocator->mappings = next;
+	}
+
+	while (NULL != allocator->largeMappings)
+	{
+		slab_mapping_t *next = allocator->largeMappings->next;
+
+		free(allocator->largeMappings);
+		allocator->largeMappings = next;
+	}
+
+	free(allocator);
+}
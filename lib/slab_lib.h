@@ -0,0 +1,109 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// smallest size class and alignment of every object: that of a capability
+#define SLAB_MIN_SIZE 16
+
+// largest size served from slabs, larger allocations are mapped on their own
+#define SLAB_MAX_SIZE (256 * 1024)
+
+// size classes between two powers of two
+#define SLAB_CLASSES_PER_DOUBLING 4
+
+// upper bound on the number of size classes
+#define SLAB_MAX_CLASSES 64
+
+// smallest slab and alignment of all slabs, a multiple of the page size; slabs of large classes
+// hold at least `SLAB_MIN_OBJECTS` objects and are a multiple of `SLAB_MIN_BYTES`
+#define SLAB_MIN_BYTES (64 * 1024)
+#define SLAB_MIN_OBJECTS 8
+
+// sizes up to which the class is found with a table rather than a search
+#define SLAB_LOOKUP_BYTES 4096
+
+/**
+ * Slab mapped for a size class, kept to be unmapped by `slab_destroy`, or mapping of a large
+ * allocation, kept to be unmapped by `slab_free`.
+ */
+typedef struct slab_mapping
+{
+	void *base;
+	size_t bytes;
+	struct slab_mapping *next;
+} slab_mapping_t;
+
+/**
+ * Size class of a slab allocator. On CHERI `size` is a representable length and a multiple of the
+ * alignment exact bounds of that length need, so that objects laid out back to back from an
+ * aligned slab all get exact bounds with no padding but the rounding up to the class.
+ * - size: size of the objects, and distance between them in their slab (unit: bytes)
+ * - slabBytes: size of the slabs of the class (unit: bytes), a multiple of `SLAB_MIN_BYTES`
+ * - freeList: freed objects, linked through their first bytes
+ * - next, remaining: next object never handed out of the newest slab, and how many are left
+ * - slabs: slabs mapped for the class
+ * - objectsInUse, bytesRequested: objects handed out and not freed, and the sizes asked for them
+ */
+typedef struct slab_class
+{
+	size_t size;
+	size_t slabBytes;
+	void *freeList;
+	char *next;
+	size_t remaining;
+	size_t slabs;
+	size_t objectsInUse;
+	uint64_t bytesRequested;
+} slab_class_t;
+
+/**
+ * Memory statistics of a slab allocator, see `slab_stats`.
+ * - bytesRequested: bytes asked for by the allocations in use
+ * - bytesInUse: bytes of their size classes, or of their mappings for large ones
+ * - bytesPadding: `bytesInUse - bytesRequested`, lost to rounding up to classes and pages
+ * - bytesFree: bytes of slabs mapped but not in use: freed objects and slab ends never used
+ * - bytesMapped: bytes of all slabs and large mappings
+ * - fragmentation: share of `bytesMapped` not asked for, `1 - bytesRequested / bytesMapped`
+ */
+typedef struct slab_stats
+{
+	uint64_t bytesRequested;
+	uint64_t bytesInUse;
+	uint64_t bytesPadding;
+	uint64_t bytesFree;
+	uint64_t bytesMapped;
+	double fragmentation;
+} slab_stats_t;
+
+/**
+ * Slab allocator: size classes with their own slabs and free lists.
+ * - classes, class: number of size classes and the classes, by increasing size
+ * - lookup: class of the sizes up to `SLAB_LOOKUP_BYTES`, by size rounded up to `SLAB_MIN_SIZE`
+ * - mappings: slabs of all classes
+ * - largeMappings: mappings of the allocations mapped on their own, with the bounds of the mapping
+ * - largeObjects, largeBytesRequested, largeBytesMapped: allocations mapped on their own
+ */
+typedef struct slab_allocator
+{
+	size_t classes;
+	slab_class_t class[SLAB_MAX_CLASSES];
+	uint8_t lookup[SLAB_LOOKUP_BYTES / SLAB_MIN_SIZE + 1];
+	slab_mapping_t *mappings;
+	slab_mapping_t *largeMappings;
+	size_t largeObjects;
+	uint64_t largeBytesRequested;
+	uint64_t largeBytesMapped;
+} slab_allocator_t;
+
+size_t slab_representable_size(size_t size);
+size_t slab_large_bytes(size_t size);
+size_t slab_size_classes(size_t sizes[], size_t capacity);
+slab_allocator_t *slab_create(void);
+size_t slab_class_index(const slab_allocator_t *allocator, size_t size);
+bool slab_refill(slab_allocator_t *allocator, slab_class_t *class);
+void *slab_alloc(slab_allocator_t *allocator, size_t size);
+void slab_free(slab_allocator_t *allocator, void *ptr, size_t size);
+void slab_stats(const slab_allocator_t *allocator, slab_stats_t *stats);
+void slab_destroy(slab_allocator_t *allocator);
@@ -0,0 +1,126 @@
+#include "sortedbuf_lib.h"
+#include "timsort_lib.h"
+
+#include <string.h>
+
+/**
+ * Initialises an empty buffer.
+ * @param buffer buffer to initialise
+ */
+void sortedBufferInit(sorted_buffer_t *buffer)
+{
+	buffer->data = NULL;
+	buffer->length = 0;
+	buffer->capacity = 0;
+	buffer->levels = 0;
+}
+
+/**
+ * Frees the elements of `buffer`, which is left empty.
+ * @param buffer buffer to free
+ */
+void sortedBufferFree(sorted_buffer_t *buffer)
+{
+	free(buffer->data);
+	sortedBufferInit(buffer);
+}
+
+/**
+ * Grows `buffer` to hold at least `capacity` elements, doubling its allocation so that appending
+ * batches copies each element a constant number of times on average.
+ * @param buffer buffer to grow
+ * @param capacity number of elements needed
+ */
+void sortedBufferReserve(sorted_buffer_t *buffer, size_t capacity)
+{
+	if (capacity <= buffer->capacity)
+	{
+		return;
+	}
+
+	size_t grown = (0 == buffer->capacity) ? 1024 : 2 * buffer->capacity;
+	grown = (grown < capacity) ? capacity : grown;
+
+	int *data = realloc(buffer->data, grown * sizeof(int));
+	if (NULL == data)
+	{
+		fputs("Could not grow the sorted buffer\n", stderr);
+		exit(EXIT_FAILURE);
+	}
+
+	buffer->data = data;
+	buffer->capacity = grown;
+}
+
+/**
+ * Merges all levels of `buffer` into one, shortest first, so that `buffer->data` is sorted.
+ * @param buffer buffer to collapse
+ */
+void sortedBufferCollapse(sorted_buffer_t *buffer)
+{
+	for (; buffer->levels > 1; buffer->levels--)
+	{
+		size_t ix = buffer->levels - 2;
+
+		merge(buffer->data, buffer->levelBase[ix], buffer->levelBase[ix + 1], buffer->length);
+		buffer->levelLength[ix] += buffer->levelLength[ix + 1];
+	}
+}
+
+/**
+ * Adds the elements of `batch` to `buffer`. The batch is copied after the existing elements and
+ * sorted there, becoming the last level. Levels are then merged with `merge`, last two first,
+ * until each one is over twice as long as the next: there are at most log2(n) + 1 levels and
+ * every element takes part in O(log n) merges over all appends, like the runs of `timSort`.
+ * @param buffer buffer to append to
+ * @param batch elements to add, in any order
+ * @param length The legth of `batch`
+ */
+void sortedBufferAppend(sorted_buffer_t *buffer, const int batch[], size_t length)
+{
+	if (0 == length)
+	{
+		return;
+	}
+
+	sortedBufferReserve(buffer, buffer->length + length);
+
+	int *level = &buffer->data[buffer->length];
+	memcpy(level, batch, length * sizeof(int));
+	timSort(level, length);
+
+	buffer->levelBase[buffer->levels] = buffer->length;
+	buffer->levelLength[buffer->levels] = length;
+	buffer->levels++;
+	buffer->length += length;
+
+	while (buffer->levels > 1)
+	{
+		size_t ix = buffer->levels - 2;
+
+		if (buffer->levelLength[ix] > 2 * buffer->levelLength[ix + 1])
+		{
+			break;
+		}
+
+		merge(buffer->data, buffer->levelBase[ix], buffer->levelBase[ix + 1], buffer->length);
+		buffer->levelLength[ix] += buffer->levelLength[ix + 1];
+		buffer->levels--;
+	}
+}
+
+/**
+ * Read view of `buffer`: collapses its levels, then returns its elements, sorted. The view stays
+ * valid until the next call that changes `buffer`. Collapsing merges O(n) elements, reads that
+ * follow without appends in between cost nothing.
+ * @param buffer buffer to read
+ * @param length output, number of elements of the view
+ * @return The sorted elements of `buffer`, possibly NULL when it is empty
+ */
+const int *sortedBufferView(sorted_buffer_t *buffer, size_t *length)
+{
+	sortedBufferCollapse(buffer);
+	*length = buffer->length;
+
+	return buffer->data;
+}
@@ -0,0 +1,32 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// levels a buffer holds at most: each level is over twice as long as the next one
+#define SORTED_BUFFER_MAX_LEVELS 64
+
+/**
+ * Growing set of ints kept sorted as batches are appended, see `sortedBufferAppend`. The elements
+ * are stored in `data` as a sequence of sorted levels, longest first, laid out one after the other
+ * like the pending runs of `timSort`.
+ * - data, length, capacity: the elements, their number, and the number of ints allocated
+ * - levels: number of levels
+ * - levelBase, levelLength: position and length of each level in `data`
+ */
+typedef struct sorted_buffer
+{
+	int *data;
+	size_t length;
+	size_t capacity;
+	size_t levels;
+	size_t levelBase[SORTED_BUFFER_MAX_LEVELS];
+	size_t levelLength[SORTED_BUFFER_MAX_LEVELS];
+} sorted_buffer_t;
+
+void sortedBufferInit(sorted_buffer_t *buffer);
+void sortedBufferFree(sorted_buffer_t *buffer);
+void sortedBufferReserve(sorted_buffer_t *buffer, size_t capacity);
+void sortedBufferCollapse(sorted_buffer_t *buffer);
+void sortedBufferAppend(sorted_buffer_t *buffer, const int batch[], size_t length);
+const int *sortedBufferView(sorted_buffer_t *buffer, size_t *length);
@@ -0,0 +1,714 @@
+#include "tcache_lib.h"
+
+#include <string.h>
+#include <sys/mman.h>
+
+/**
+ * Pushes `magazine` on a lock-free stack of magazines.
+ * @param cache cache of the magazine
+ * @param stack head of the stack, see `tcache_depot_t`
+ * @param magazine index of the magazine
+ */
+void tcache_stack_push(tcache_t *cache, _Atomic uint64_t *stack, uint32_t magazine)
+{
+	uint64_t head = atomic_load_explicit(stack, memory_order_relaxed);
+	uint64_t next;
+
+	do
+	{
+		atomic_store_explicit(&cache->magazines[magazine].next, (uint32_t)head,
+							  memory_order_relaxed);
+		next = ((head >> 32) + 1) << 32 | ((uint64_t)magazine + 1);
+	} while (!atomic_compare_exchange_weak_explicit(stack, &head, next, memory_order_release,
+													memory_order_relaxed));
+}
+
+/**
+ * Pops the top magazine of a lock-free stack of magazines. The tag of the head changes on every
+ * update, so that a magazine popped and pushed again by other threads between the read of its
+ * link and the exchange is noticed.
+ * @param cache cache of the magazines
+ * @param stack head of the stack, see `tcache_depot_t`
+ * @return The index of the magazine, `TCACHE_NONE` if the stack is empty
+ */
+uint32_t tcache_stack_pop(tcache_t *cache, _Atomic uint64_t *stack)
+{
+	uint64_t head = atomic_load_explicit(stack, memory_order_acquire);
+	uint64_t next;
+
+	do
+	{
+		uint32_t top = (uint32_t)head;
+
+		if (0 == top)
+		{
+			return TCACHE_NONE;
+		}
+
+		uint32_t below =
+			atomic_load_explicit(&cache->magazines[top - 1].next, memory_order_relaxed);
+		next = ((head >> 32) + 1) << 32 | below;
+	} while (!atomic_compare_exchange_weak_explicit(stack, &head, next, memory_order_acquire,
+													memory_order_acquire));
+
+	return (uint32_t)head - 1;
+}
+
+/**
+ * Takes an empty magazine: from the stack of empty magazines, else from the pool.
+ * @param cache cache to take from
+ * @return The index of the magazine, `TCACHE_NONE` if there is none left
+ */
+uint32_t tcache_magazine_acquire(tcache_t *cache)
+{
+	uint32_t magazine = tcache_stack_pop(cache, &cache->empty);
+
+	if (TCACHE_NONE == magazine)
+	{
+		magazine = atomic_fetch_add_explicit(&cache->magazinesUsed, 1, memory_order_relaxed);
+		magazine = (magazine < cache->magazineCapacity) ? magazine : TCACHE_NONE;
+	}
+
+	return magazine;
+}
+
+/**
+ * Slot of the span map where the search for the block `block` starts.
+ * @param block block number, address divided by `SLAB_MIN_BYTES`
+ * @return The slot
+ */
+static size_t tcache_span_slot(uint64_t block)
+{
+	return (size_t)((block * 0x9E3779B97F4A7C15ULL) >> (64 - TCACHE_SPAN_BITS));
+}
+
+/**
+ * Records `owner` as the owner of the `SLAB_MIN_BYTES` blocks of a slab.
+ * @param cache cache of the span map
+ * @param base start of the slab, a multiple of `SLAB_MIN_BYTES`
+ * @param bytes size of the slab (unit: bytes), a multiple of `SLAB_MIN_BYTES`
+ * @param owner thread the slab belongs to
+ * @return false if the span map is full
+ */
+bool tcache_span_register(tcache_t *cache, const void *base, size_t bytes, size_t owner)
+{
+	uint64_t first = (uint64_t)(uintptr_t)base / SLAB_MIN_BYTES;
+	size_t mask = ((size_t)1 << TCACHE_SPAN_BITS) - 1;
+
+	for (uint64_t block = first; block < first + bytes / SLAB_MIN_BYTES; block++)
+	{
+		uint64_t entry = block << 16 | ((uint64_t)owner + 1);
+		size_t slot = tcache_span_slot(block);
+		size_t probes = 0;
+
+		while (true)
+		{
+			uint64_t found = 0;
+
+			// release: the thread cache of the owner is visible to who finds the entry
+			if (atomic_compare_exchange_strong_explicit(&cache->spans[slot], &found, entry,
+														memory_order_release, memory_order_relaxed))
+			{
+				break;
+			}
+
+			if (found >> 16 == block)
+			{
+				atomic_store_explicit(&cache->spans[slot], entry, memory_order_release);
+				break;
+			}
+
+			if (++probes > mask)
+			{
+				return false;
+			}
+
+			slot = (slot + 1) & mask;
+		}
+	}
+
+	return true;
+}
+
+/**
+ * Finds the thread the slab holding `ptr` belongs to.
+ * @param cache cache of the span map
+ * @param ptr object of a slab of one of the threads of `cache`
+ * @return The index of the thread, `TCACHE_NONE` if no slab holds `ptr`
+ */
+size_t tcache_span_owner(const tcache_t *cache, const void *ptr)
+{
+	uint64_t block = (uint64_t)(uintptr_t)ptr / SLAB_MIN_BYTES;
+	size_t mask = ((size_t)1 << TCACHE_SPAN_BITS) - 1;
+	size_t slot = tcache_span_slot(block);
+
+	for (size_t probes = 0; probes <= mask; probes++)
+	{
+		uint64_t entry = atomic_load_explicit(&cache->spans[slot], memory_order_acquire);
+
+		if (0 == entry)
+		{
+			break;
+		}
+
+		if (entry >> 16 == block)
+		{
+			return (size_t)(entry & 0xFFFF) - 1;
+		}
+
+		slot = (slot + 1) & mask;
+	}
+
+	return TCACHE_NONE;
+}
+
+/**
+ * Creates a thread-caching allocator, with a pool of magazines for `TCACHE_MAX_THREADS` threads.
+ * @return The cache, NULL if it could not be allocated
+ */
+tcache_t *tcache_create(void)
+{
+	tcache_t *cache = aligned_alloc(TCACHE_CACHE_LINE, sizeof(tcache_t));
+	if (NULL == cache)
+	{
+		return NULL;
+	}
+
+	memset(cache, 0, sizeof(tcache_t));
+
+	size_t sizes[SLAB_MAX_CLASSES];
+	size_t classes = slab_size_classes(sizes, SLAB_MAX_CLASSES);
+
+	while (cache->classes < classes && sizes[cache->classes] <= TCACHE_MAX_SIZE)
+	{
+		cache->classes++;
+	}
+
+	// mapped rather than allocated, so that magazines never used are never touched
+	cache->magazineCapacity = TCACHE_MAX_THREADS * TCACHE_THREAD_MAGAZINES * cache->classes;
+	cache->magazines = mmap(NULL, cache->magazineCapacity * sizeof(tcache_magazine_t),
+							PROT_READ | PROT_WRITE, MAP_ANON | MAP_PRIVATE, -1, 0);
+	cache->spans = calloc((size_t)1 << TCACHE_SPAN_BITS, sizeof(uint64_t));
+
+	if (MAP_FAILED == cache->magazines || NULL == cache->spans)
+	{
+		if (MAP_FAILED != cache->magazines)
+		{
+			munmap(cache->magazines, cache->magazineCapacity * sizeof(tcache_magazine_t));
+		}
+
+		free(cache->spans);
+		free(cache);
+		return NULL;
+	}
+
+	return cache;
+}
+
+/**
+ * Gives `thread` an empty pair of magazines per class.
+ * @param thread thread cache without magazines
+ * @return false if the pool of magazines is exhausted, `thread` then has none
+ */
+static bool tcache_thread_load(tcache_thread_t *thread)
+{
+	tcache_t *cache = thread->cache;
+
+	for (size_t ix = 0; ix < cache->classes; ix++)
+	{
+		thread->loaded[ix] = tcache_magazine_acquire(cache);
+		thread->previous[ix] = tcache_magazine_acquire(cache);
+
+		if (TCACHE_NONE == thread->loaded[ix] || TCACHE_NONE == thread->previous[ix])
+		{
+			for (size_t jx = 0; jx <= ix; jx++)
+			{
+				if (TCACHE_NONE != thread->loaded[jx])
+				{
+					tcache_stack_push(cache, &cache->empty, thread->loaded[jx]);
+				}
+
+				if (TCACHE_NONE != thread->previous[jx])
+				{
+					tcache_stack_push(cache, &cache->empty, thread->previous[jx]);
+				}
+
+				thread->loaded[jx] = TCACHE_NONE;
+				thread->previous[jx] = TCACHE_NONE;
+			}
+
+			return false;
+		}
+
+		cache->magazines[thread->loaded[ix]].count = 0;
+		cache->magazines[thread->previous[ix]].count = 0;
+	}
+
+	return true;
+}
+
+/**
+ * Takes over the cache of a released thread, if there is one.
+ * @param cache cache the thread allocates from
+ * @return The thread cache, NULL if no thread cache is released
+ */
+static tcache_thread_t *tcache_thread_reclaim(tcache_t *cache)
+{
+	size_t count = atomic_load_explicit(&cache->threadCount, memory_order_relaxed);
+	count = (count < TCACHE_MAX_THREADS) ? count : TCACHE_MAX_THREADS;
+
+	for (size_t id = 0; id < count; id++)
+	{
+		tcache_thread_t *thread = atomic_load_explicit(&cache->threads[id], memory_order_acquire);
+		bool released = true;
+
+		// acquire: the release of the previous thread is complete
+		if (NULL != thread &&
+			atomic_compare_exchange_strong_explicit(&thread->released, &released, false,
+													memory_order_acquire, memory_order_relaxed))
+		{
+			return thread;
+		}
+	}
+
+	return NULL;
+}
+
+/**
+ * Creates the cache of a thread, with an empty pair of magazines per class. The cache of a
+ * released thread is taken over if there is one, with its id, its heap and the objects other
+ * threads sent back to it; otherwise the thread cache gets a new id and a heap of its own. The
+ * thread cache must then only be used by the calling thread.
+ * @param cache cache the thread allocates from
+ * @return The thread cache, NULL if it could not be allocated or `TCACHE_MAX_THREADS` thread
+ *         caches are in use
+ */
+tcache_thread_t *tcache_thread_create(tcache_t *cache)
+{
+	tcache_thread_t *thread = tcache_thread_reclaim(cache);
+
+	if (NULL != thread)
+	{
+		if (!tcache_thread_load(thread))
+		{
+			atomic_store_explicit(&thread->released, true, memory_order_release);
+			return NULL;
+		}
+
+		return thread;
+	}
+
+	size_t id = atomic_fetch_add_explicit(&cache->threadCount, 1, memory_order_relaxed);
+	if (id >= TCACHE_MAX_THREADS)
+	{
+		return NULL;
+	}
+
+	thread = aligned_alloc(TCACHE_CACHE_LINE, sizeof(tcache_thread_t));
+	slab_allocator_t *heap = slab_create();
+
+	if (NULL == thread || NULL == heap)
+	{
+		free(thread);
+		slab_destroy(heap);
+		return NULL;
+	}
+
+	memset(thread, 0, sizeof(tcache_thread_t));
+	thread->cache = cache;
+	thread->id = id;
+	thread->heap = heap;
+	atomic_init(&thread->released, false);
+
+	for (size_t ix = 0; ix < cache->classes; ix++)
+	{
+		atomic_init(&thread->remote[ix], NULL);
+	}
+
+	if (!tcache_thread_load(thread))
+	{
+		free(thread);
+		slab_destroy(heap);
+		return NULL;
+	}
+
+	atomic_store_explicit(&cache->threads[id], thread, memory_order_release);
+
+	return thread;
+}
+
+/**
+ * Sends the remote frees gathered by `thread` for a size class to their owner, with a single
+ * atomic exchange. The owner takes them all at once, so the stack has no ABA problem.
+ * @param thread thread cache sending
+ * @param index size class of the objects
+ */
+void tcache_send(tcache_thread_t *thread, size_t index)
+{
+	tcache_batch_t *batch = &thread->outgoing[index];
+	if (0 == batch->count)
+	{
+		return;
+	}
+
+	tcache_thread_t *owner =
+		atomic_load_explicit(&thread->cache->threads[batch->owner], memory_order_acquire);
+	void *head = atomic_load_explicit(&owner->remote[index], memory_order_relaxed);
+
+	do
+	{
+		*(void **)batch->tail = head;
+	} while (!atomic_compare_exchange_weak_explicit(&owner->remote[index], &head, batch->head,
+													memory_order_release, memory_order_relaxed));
+
+	thread->stats.remoteFreesSent += batch->count;
+	thread->stats.remoteBatchesSent++;
+	memset(batch, 0, sizeof(tcache_batch_t));
+}
+
+/**
+ * Empties `magazine` into the heaps its objects come from: the objects of `thread` go back to its
+ * slab allocator, the others are gathered by owner and sent in batches of up to
+ * `TCACHE_REMOTE_BATCH` objects.
+ * @param thread thread cache flushing
+ * @param index size class of the magazine
+ * @param magazine magazine to empty
+ */
+void tcache_flush(tcache_thread_t *thread, size_t index, tcache_magazine_t *magazine)
+{
+	size_t size = thread->heap->class[index].size;
+	tcache_batch_t *batch = &thread->outgoing[index];
+
+	for (size_t ix = 0; ix < magazine->count; ix++)
+	{
+		void *object = magazine->objects[ix];
+		size_t owner = tcache_span_owner(thread->cache, object);
+
+		if (owner >= TCACHE_MAX_THREADS)
+		{
+			fputs("Freed an object of no thread cache\n", stderr);
+			exit(EXIT_FAILURE);
+		}
+
+		if (owner == thread->id)
+		{
+			slab_free(thread->heap, object, size);
+			continue;
+		}
+
+		if (0 < batch->count && owner != batch->owner)
+		{
+			tcache_send(thread, index);
+		}
+
+		*(void **)object = batch->head;
+		batch->tail = (0 == batch->count) ? object : batch->tail;
+		batch->head = object;
+		batch->owner = owner;
+
+		if (++batch->count == TCACHE_REMOTE_BATCH)
+		{
+			tcache_send(thread, index);
+		}
+	}
+
+	tcache_send(thread, index);
+	magazine->count = 0;
+	thread->stats.flushes++;
+}
+
+/**
+ * Records the slabs mapped by the heap of `thread` since the last call in the span map.
+ * @param thread thread cache
+ * @return false if the span map is full
+ */
+static bool tcache_register_slabs(tcache_thread_t *thread)
+{
+	slab_mapping_t *mapping = thread->heap->mappings;
+
+	for (; mapping != thread->registered; mapping = mapping->next)
+	{
+		if (!tcache_span_register(thread->cache, mapping->base, mapping->bytes, thread->id))
+		{
+			return false;
+		}
+	}
+
+	thread->registered = thread->heap->mappings;
+
+	return true;
+}
+
+/**
+ * Fills the empty loaded magazine of a size class: with the objects other threads sent back, else
+ * with half a magazine of objects of the heap of `thread`.
+ * @param thread thread cache
+ * @param index size class
+ * @return false if no object could be allocated
+ */
+static bool tcache_refill(tcache_thread_t *thread, size_t index)
+{
+	tcache_magazine_t *loaded = &thread->cache->magazines[thread->loaded[index]];
+	size_t size = thread->heap->class[index].size;
+	void *object = atomic_exchange_explicit(&thread->remote[index], NULL, memory_order_acquire);
+
+	while (NULL != object)
+	{
+		void *next = *(void **)object;
+
+		if (loaded->count < TCACHE_MAGAZINE_SIZE)
+		{
+			loaded->objects[loaded->count++] = object;
+		}
+		else
+		{
+			slab_free(thread->heap, object, size);
+		}
+
+		thread->stats.remoteFreesReceived++;
+		object = next;
+	}
+
+	if (0 < loaded->count)
+	{
+		return true;
+	}
+
+	while (loaded->count < TCACHE_MAGAZINE_SIZE / 2 &&
+		   NULL != (object = slab_alloc(thread->heap, size)))
+	{
+		loaded->objects[loaded->count++] = object;
+	}
+
+	if (!tcache_register_slabs(thread))
+	{
+		while (0 < loaded->count)
+		{
+			slab_free(thread->heap, loaded->objects[--loaded->count], size);
+		}
+	}
+
+	thread->stats.slabRefills++;
+
+	return 0 < loaded->count;
+}
+
+/**
+ * Allocation when the loaded magazine of the class is empty: swaps in the previous one if it holds
+ * objects, else exchanges the empty magazine for a full one of the depot, else refills it.
+ * @param thread thread cache
+ * @param index size class
+ * @return The object, NULL if none could be allocated
+ */
+static void *tcache_alloc_slow(tcache_thread_t *thread, size_t index)
+{
+	tcache_t *cache = thread->cache;
+	uint32_t previous = thread->previous[index];
+
+	if (0 < cache->magazines[previous].count)
+	{
+		thread->previous[index] = thread->loaded[index];
+		thread->loaded[index] = previous;
+	}
+	else
+	{
+		uint32_t full = tcache_stack_pop(cache, &cache->depot[index].full);
+
+		if (TCACHE_NONE != full)
+		{
+			atomic_fetch_sub_explicit(&cache->depot[index].fullCount, 1, memory_order_relaxed);
+			tcache_stack_push(cache, &cache->empty, thread->loaded[index]);
+			thread->loaded[index] = full;
+			thread->stats.depotExchanges++;
+		}
+		else if (!tcache_refill(thread, index))
+		{
+			return NULL;
+		}
+	}
+
+	tcache_magazine_t *loaded = &cache->magazines[thread->loaded[index]];
+
+	return loaded->objects[--loaded->count];
+}
+
+/**
+ * Allocates `size` bytes. Sizes up to `TCACHE_MAX_SIZE` are served from the loaded magazine of
+ * their size class, with no atomic operation and no lock; the depot or the heap of the thread are
+ * only used when both magazines of the class are empty. On CHERI the pointer returned has exact
+ * bounds of the size of the class, see `slab_alloc`. Larger allocations are mapped on their own.
+ * @param thread cache of the calling thread
+ * @param size number of bytes to allocate
+ * @return The memory, aligned to `SLAB_MIN_SIZE` at least, NULL if it could not be allocated
+ */
+void *tcache_alloc(tcache_thread_t *thread, size_t size)
+{
+	size_t index = slab_class_index(thread->heap, size);
+	thread->stats.allocations++;
+
+	if (index >= thread->cache->classes)
+	{
+		void *object = mmap(NULL, slab_large_bytes(size), PROT_READ | PROT_WRITE,
+							MAP_ANON | MAP_PRIVATE, -1, 0);
+
+		thread->stats.largeAllocations++;
+
+		return (MAP_FAILED == object) ? NULL : object;
+	}
+
+	tcache_magazine_t *loaded = &thread->cache->magazines[thread->loaded[index]];
+
+	if (0 < loaded->count)
+	{
+		return loaded->objects[--loaded->count];
+	}
+
+	return tcache_alloc_slow(thread, index);
+}
+
+/**
+ * Free when the loaded magazine of the class is full: swaps in the previous one if it is empty,
+ * else exchanges the full magazine for an empty one while the depot holds fewer than
+ * `TCACHE_DEPOT_LIMIT` full ones, else flushes it back to the heaps of its objects.
+ * @param thread thread cache
+ * @param index size class
+ * @param ptr object to free
+ */
+static void tcache_free_slow(tcache_thread_t *thread, size_t index, void *ptr)
+{
+	tcache_t *cache = thread->cache;
+	tcache_depot_t *depot = &cache->depot[index];
+	uint32_t previous = thread->previous[index];
+
+	if (0 == cache->magazines[previous].count)
+	{
+		thread->previous[index] = thread->loaded[index];
+		thread->loaded[index] = previous;
+	}
+	else
+	{
+		uint32_t empty = TCACHE_NONE;
+
+		if (atomic_load_explicit(&depot->fullCount, memory_order_relaxed) < TCACHE_DEPOT_LIMIT)
+		{
+			empty = tcache_magazine_acquire(cache);
+		}
+
+		if (TCACHE_NONE != empty)
+		{
+			cache->magazines[empty].count = 0;
+			tcache_stack_push(cache, &depot->full, thread->loaded[index]);
+			atomic_fetch_add_explicit(&depot->fullCount, 1, memory_order_relaxed);
+			thread->loaded[index] = empty;
+			thread->stats.depotExchanges++;
+		}
+		else
+		{
+			tcache_flush(thread, index, &cache->magazines[thread->loaded[index]]);
+		}
+	}
+
+	tcache_magazine_t *loaded = &cache->magazines[thread->loaded[index]];
+	loaded->objects[loaded->count++] = ptr;
+}
+
+/**
+ * Frees an allocation of any thread of the cache of `thread` into the magazines of `thread`.
+ * Objects of other threads are sent back to them only when their magazine is flushed.
+ * @param thread cache of the calling thread
+ * @param ptr pointer returned by `tcache_alloc`, may be NULL
+ * @param size size `ptr` was allocated with (unit: bytes)
+ */
+void tcache_free(tcache_thread_t *thread, void *ptr, size_t size)
+{
+	if (NULL == ptr)
+	{
+		return;
+	}
+
+	size_t index = slab_class_index(thread->heap, size);
+	thread->stats.frees++;
+
+	if (index >= thread->cache->classes)
+	{
+		munmap(ptr, slab_large_bytes(size));
+		return;
+	}
+
+	tcache_magazine_t *loaded = &thread->cache->magazines[thread->loaded[index]];
+
+	if (loaded->count < TCACHE_MAGAZINE_SIZE)
+	{
+		loaded->objects[loaded->count++] = ptr;
+		return;
+	}
+
+	tcache_free_slow(thread, index, ptr);
+}
+
+/**
+ * Gives back the magazines of `thread` when it stops allocating: their objects go back to the
+ * heaps they come from, and the objects other threads sent back go back to its heap. The heap
+ * stays the owner of its objects, which may still be in use by other threads: the next
+ * `tcache_thread_create` takes it over with the id of `thread`, together with the objects sent
+ * back in the meantime, and `tcache_destroy` unmaps it. `thread` must not be used afterwards.
+ * @param thread cache of the calling thread
+ */
+void tcache_thread_release(tcache_thread_t *thread)
+{
+	tcache_t *cache = thread->cache;
+
+	for (size_t ix = 0; ix < cache->classes; ix++)
+	{
+		size_t size = thread->heap->class[ix].size;
+
+		tcache_flush(thread, ix, &cache->magazines[thread->loaded[ix]]);
+		tcache_flush(thread, ix, &cache->magazines[thread->previous[ix]]);
+		tcache_stack_push(cache, &cache->empty, thread->loaded[ix]);
+		tcache_stack_push(cache, &cache->empty, thread->previous[ix]);
+		thread->loaded[ix] = TCACHE_NONE;
+		thread->previous[ix] = TCACHE_NONE;
+
+		void *object = atomic_exchange_explicit(&thread->remote[ix], NULL, memory_order_acquire);
+
+		while (NULL != object)
+		{
+			void *next = *(void **)object;
+
+			slab_free(thread->heap, object, size);
+			thread->stats.remoteFreesReceived++;
+			object = next;
+		}
+	}
+
+	// release: the heap is complete for the thread that takes it over
+	atomic_store_explicit(&thread->released, true, memory_order_release);
+}
+
+/**
+ * Unmaps the heaps of all threads of `cache` and frees it. All threads must have stopped using
+ * it; allocations larger than `TCACHE_MAX_SIZE` still in use are not unmapped.
+ * @param cache cache to destroy, may be NULL
+ */
+void tcache_destroy(tcache_t *cache)
+{
+	if (NULL == cache)
+	{
+		return;
+	}
+
+	for (size_t ix = 0; ix < TCACHE_MAX_THREADS; ix++)
+	{
+		tcache_thread_t *thread = atomic_load(&cache->threads[ix]);
+
+		if (NULL != thread)
+		{
+			slab_destroy(thread->heap);
+			free(thread);
+		}
+	}
+
+	munmap(cache->magazines, cache->magazineCapacity * sizeof(tcache_magazine_t));
+	free(cache->spans);
+	free(cache);
+}
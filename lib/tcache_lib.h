@@ -0,0 +1,167 @@
+#include "slab_lib.h"
+
+#include <stdatomic.h>
+
+// objects held by a magazine
+#define TCACHE_MAGAZINE_SIZE 64
+
+// largest size served from magazines, larger allocations are mapped on their own
+#define TCACHE_MAX_SIZE (32 * 1024)
+
+// maximum number of thread caches of a cache in use at once, released ones are taken over
+#define TCACHE_MAX_THREADS 64
+
+// magazines of the pool per thread and size class
+#define TCACHE_THREAD_MAGAZINES 4
+
+// full magazines a size class keeps in the depot before they are given back to their heaps
+#define TCACHE_DEPOT_LIMIT 16
+
+// remote frees sent to their owner at once
+#define TCACHE_REMOTE_BATCH 32
+
+// slots of the span map, a power of two: the map covers `SLAB_MIN_BYTES` times fewer bytes
+#define TCACHE_SPAN_BITS 20
+
+// size of the cache lines the depot and the remote queues are aligned to
+#define TCACHE_CACHE_LINE 64
+
+// no magazine, no thread
+#define TCACHE_NONE UINT32_MAX
+
+/**
+ * Magazine: a stack of free objects of one size class.
+ * - next: depot stack link, index of the next magazine plus one, 0 at the bottom
+ * - count: number of objects held
+ * - objects: the objects, the last one handed out first
+ */
+typedef struct tcache_magazine
+{
+	_Atomic uint32_t next;
+	uint32_t count;
+	void *objects[TCACHE_MAGAZINE_SIZE];
+} tcache_magazine_t;
+
+/**
+ * Depot of a size class: full magazines shared by all threads, as a lock-free stack.
+ * - full: stack head, a tag counting its updates in the high 32 bits against ABA, and the index
+ *         of the top magazine plus one in the low 32 bits, 0 when empty
+ * - fullCount: number of magazines in the stack, approximate
+ */
+typedef struct tcache_depot
+{
+	_Alignas(TCACHE_CACHE_LINE) _Atomic uint64_t full;
+	_Atomic size_t fullCount;
+} tcache_depot_t;
+
+/**
+ * Remote frees gathered by a thread for the owner of the objects, linked through their first
+ * bytes, to be sent at once by `tcache_send`.
+ * - head, tail: first and last object of the batch
+ * - owner: thread the objects belong to
+ * - count: number of objects in the batch
+ */
+typedef struct tcache_batch
+{
+	void *head;
+	void *tail;
+	size_t owner;
+	size_t count;
+} tcache_batch_t;
+
+/**
+ * Statistics of a thread cache.
+ * - allocations, frees: `tcache_alloc` and `tcache_free` calls
+ * - depotExchanges: magazines taken from or given to the depot
+ * - slabRefills: magazines filled from the heap of the thread
+ * - flushes: magazines given back to the heaps of their objects
+ * - remoteFreesSent, remoteBatchesSent: objects sent to other threads, and how many sends
+ * - remoteFreesReceived: objects of the thread sent back by others
+ * - largeAllocations: allocations larger than `TCACHE_MAX_SIZE`
+ */
+typedef struct tcache_stats
+{
+	uint64_t allocations;
+	uint64_t frees;
+	uint64_t depotExchanges;
+	uint64_t slabRefills;
+	uint64_t flushes;
+	uint64_t remoteFreesSent;
+	uint64_t remoteBatchesSent;
+	uint64_t remoteFreesReceived;
+	uint64_t largeAllocations;
+} tcache_stats_t;
+
+struct tcache;
+
+/**
+ * Cache of one thread, used by that thread only but for `remote`.
+ * - cache: cache the thread belongs to
+ * - id: index of the thread in the cache, owner of the objects of `heap`
+ * - heap: slab allocator the objects of the thread are carved from
+ * - registered: newest slab of `heap` recorded in the span map
+ * - loaded, previous: the two magazines of each size class, objects are taken from and given to
+ *                     `loaded`, `previous` is swapped in when it is empty or full
+ * - outgoing: remote frees being gathered, per size class
+ * - stats: see `tcache_stats_t`, carried over when the thread cache is taken over
+ * - released: set by `tcache_thread_release`, cleared by the `tcache_thread_create` that takes the
+ *             thread cache over
+ * - remote: objects of the thread freed by others, per size class, a stack of batches pushed by
+ *           any thread and taken all at once by this one
+ */
+typedef struct tcache_thread
+{
+	struct tcache *cache;
+	size_t id;
+	slab_allocator_t *heap;
+	slab_mapping_t *registered;
+	uint32_t loaded[SLAB_MAX_CLASSES];
+	uint32_t previous[SLAB_MAX_CLASSES];
+	tcache_batch_t outgoing[SLAB_MAX_CLASSES];
+	tcache_stats_t stats;
+	_Atomic bool released;
+	_Alignas(TCACHE_CACHE_LINE) _Atomic(void *) remote[SLAB_MAX_CLASSES];
+} tcache_thread_t;
+
+/**
+ * Thread-caching allocator: each thread allocates from magazines of its own, with no atomic
+ * operation, and exchanges full and empty magazines with the depot shared by all threads. The
+ * objects come from a slab allocator per thread; objects freed by another thread are sent back to
+ * it in batches when the magazines they are in are given back.
+ * - classes: number of size classes served from magazines, those of the slab allocator up to
+ *            `TCACHE_MAX_SIZE`
+ * - magazines, magazineCapacity, magazinesUsed: pool of magazines, its size and how many have
+ *                                               been handed out at least once
+ * - empty: lock-free stack of empty magazines, see `tcache_depot_t`
+ * - depot: full magazines of each size class
+ * - spans: span map, owner of every `SLAB_MIN_BYTES` block of slabs: block number in the high 48
+ *          bits and owner plus one in the low 16 bits, 0 for an empty slot
+ * - threadCount, threads: thread caches created, by id; released ones stay, as the owners of
+ *                         their objects
+ */
+typedef struct tcache
+{
+	size_t classes;
+	tcache_magazine_t *magazines;
+	size_t magazineCapacity;
+	_Atomic uint32_t magazinesUsed;
+	_Alignas(TCACHE_CACHE_LINE) _Atomic uint64_t empty;
+	tcache_depot_t depot[SLAB_MAX_CLASSES];
+	_Atomic uint64_t *spans;
+	_Atomic size_t threadCount;
+	_Atomic(tcache_thread_t *) threads[TCACHE_MAX_THREADS];
+} tcache_t;
+
+void tcache_stack_push(tcache_t *cache, _Atomic uint64_t *stack, uint32_t magazine);
+uint32_t tcache_stack_pop(tcache_t *cache, _Atomic uint64_t *stack);
+uint32_t tcache_magazine_acquire(tcache_t *cache);
+bool tcache_span_register(tcache_t *cache, const void *base, size_t bytes, size_t owner);
+size_t tcache_span_owner(const tcache_t *cache, const void *ptr);
+tcache_t *tcache_create(void);
+tcache_thread_t *tcache_thread_create(tcache_t *cache);
+void tcache_send(tcache_thread_t *thread, size_t index);
+void tcache_flush(tcache_thread_t *thread, size_t index, tcache_magazine_t *magazine);
+void *tcache_alloc(tcache_thread_t *thread, size_t size);
+void tcache_free(tcache_thread_t *thread, void *ptr, size_t size);
+void tcache_thread_release(tcache_thread_t *thread);
+void tcache_destroy(tcache_t *cache);
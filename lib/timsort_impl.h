@@ -0,0 +1,1125 @@
+/**
+ * Generic timsort kernels, instantiated once per element type by including this file with the
+ * following macros defined, after `timsort_lib.h`:
+ * - TIMSORT_TYPE: element type, any type that can be copied by assignment
+ * - TIMSORT_SUFFIX: appended to every generated name, e.g. `timSort_i64` for `i64`
+ * - TIMSORT_LESS(a, b): optional, strict weak order on two elements, `(a) < (b)` by default
+ * - TIMSORT_NAME(name): optional, overrides the naming scheme, e.g. to keep the `int` names
+ * - TIMSORT_LINKAGE: optional, e.g. `static inline` for a private instantiation
+ * - TIMSORT_VALUE_TYPE: optional, type of a payload array sorted along with the keys
+ * - TIMSORT_NETWORK: optional, lets short runs be built with sorting networks, which are not
+ *   stable. Only for types whose equal elements are indistinguishable, such as integers
+ *
+ * The comparison is expanded inline in every kernel, so a specialised sort makes no function call
+ * per comparison. Fixed-size records sort by key with a private instantiation:
+ *
+ *	typedef struct { uint64_t timestamp; uint32_t payload[6]; } record_t;
+ *	#define TIMSORT_TYPE record_t
+ *	#define TIMSORT_SUFFIX record
+ *	#define TIMSORT_LESS(a, b) ((a).timestamp < (b).timestamp)
+ *	#define TIMSORT_LINKAGE static inline
+ *	#include "lib/timsort_impl.h"
+ *
+ * With TIMSORT_VALUE_TYPE defined, every kernel that moves elements takes a `vals` array right
+ * after `arr` and applies each move of a key to the value at the same index, so keys and values
+ * stay in two separate arrays (structure of arrays) throughout the sort. Merges copy the values of
+ * the shorter run to the merge buffer, after its keys; `timSortWithBuffer` is not generated.
+ *
+ * The merge state, scratch management and run length helpers are shared by all instantiations and
+ * live in `timsort_lib.c`.
+ *
+ * All macros are undefined again at the end of this file.
+ */
+#include <assert.h>
+#include <string.h>
+
+#ifndef TIMSORT_TYPE
+#error "TIMSORT_TYPE must be defined before including timsort_impl.h"
+#endif
+
+#ifndef TIMSORT_NAME
+#define TIMSORT_CONCAT_(name, suffix) name##_##suffix
+#define TIMSORT_CONCAT(name, suffix) TIMSORT_CONCAT_(name, suffix)
+#define TIMSORT_NAME(name) TIMSORT_CONCAT(name, TIMSORT_SUFFIX)
+#endif
+
+#ifndef TIMSORT_LESS
+#define TIMSORT_LESS(a, b) ((a) < (b))
+#endif
+
+#ifndef TIMSORT_LINKAGE
+#define TIMSORT_LINKAGE
+#endif
+
+// `TIMSORT_VALUES(...)` expands its arguments only when sorting a payload array
+#ifdef TIMSORT_VALUE_TYPE
+#define TIMSORT_VALUES_PARAM , TIMSORT_VALUE_TYPE vals[]
+#define TIMSORT_VALUES_ARG , vals
+#define TIMSORT_VALUES(...) __VA_ARGS__
+#else
+#define TIMSORT_VALUES_PARAM
+#define TIMSORT_VALUES_ARG
+#define TIMSORT_VALUES(...)
+#endif
+
+// the selects of the branchless merge only become conditional moves in an optimised build; without
+// optimisation they compile to branches that mispredict as often as the galloping merge's
+#ifdef __OPTIMIZE__
+#define TIMSORT_BRANCHLESS_MERGE 1
+#else
+#define TIMSORT_BRANCHLESS_MERGE 0
+#endif
+
+// kernels that are used before they are defined
+TIMSORT_LINKAGE void TIMSORT_NAME(mergeRuns)(merge_state_t *state,
+											 TIMSORT_TYPE arr[] TIMSORT_VALUES_PARAM,
+											 size_t lowerBound, size_t midPoint, size_t upperBound);
+TIMSORT_LINKAGE void TIMSORT_NAME(mergeLo)(merge_state_t *state,
+										   TIMSORT_TYPE arr[] TIMSORT_VALUES_PARAM,
+										   size_t lowerBound, size_t midPoint, size_t upperBound);
+TIMSORT_LINKAGE void TIMSORT_NAME(mergeHi)(merge_state_t *state,
+										   TIMSORT_TYPE arr[] TIMSORT_VALUES_PARAM,
+										   size_t lowerBound, size_t midPoint, size_t upperBound);
+
+/**
+ * Checks if an array `arr` having length `length` is sorted in ascending order. The comparisons of
+ * each block of `SORTED_CHECK_BLOCK` elements are all made, without an early exit, so that the
+ * compiler can turn them into vector compares; the scan only stops between blocks.
+ * @param arr Array to sort
+ * @param length The legth of `arr`
+ */
+TIMSORT_LINKAGE bool TIMSORT_NAME(isSorted)(TIMSORT_TYPE arr[], size_t length)
+{
+	// short-circuit: empty and singleton arrays are always sorted.
+	if (length <= 1)
+	{
+		return true;
+	}
+
+	size_t ix = 1;
+	for (; length - ix >= SORTED_CHECK_BLOCK; ix += SORTED_CHECK_BLOCK)
+	{
+		TIMSORT_TYPE *block = &arr[ix - 1];
+		int descent = 0;
+
+		for (size_t jx = 0; jx < SORTED_CHECK_BLOCK; jx++)
+		{
+			descent |= TIMSORT_LESS(block[jx + 1], block[jx]);
+		}
+
+		if (descent)
+		{
+			return false;
+		}
+	}
+
+	for (; ix < length; ix++)
+	{
+		if (TIMSORT_LESS(arr[ix], arr[ix - 1]))
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/**
+ * Sorts `arr[lowerBound .. upperBound)` in place, given that `arr[lowerBound .. start)` is already
+ * sorted. Each remaining element's slot is found with a binary search, to the right of any equal
+ * elements so that the sort is stable, and the elements after the slot are shifted with a single
+ * `memmove`.
+ * @param arr array to sort
+ * @param lowerBound lower bound
+ * @param start first element that is not yet sorted
+ * @param upperBound upper bound (exclusive)
+ */
+TIMSORT_LINKAGE void TIMSORT_NAME(binaryInsertionSort)(TIMSORT_TYPE arr[] TIMSORT_VALUES_PARAM,
+													   size_t lowerBound, size_t start,
+													   size_t upperBound)
+{
+	assert(lowerBound <= start);
+
+	if (start == lowerBound)
+	{
+		start++;
+	}
+
+	for (size_t ix = start; ix < upperBound; ix++)
+	{
+		TIMSORT_TYPE ix_value = arr[ix];
+		TIMSORT_VALUES(TIMSORT_VALUE_TYPE ix_payload = vals[ix]);
+		size_t left = lowerBound;
+		size_t count = ix - lowerBound;
+
+		// find the first element of arr[lowerBound .. ix) that is larger than `ix_value`; the
+		// halving step compiles to a conditional move, so random input does not mispredict on it
+		while (count > 1)
+		{
+			size_t half = count >> 1;
+
+			left = TIMSORT_LESS(ix_value, arr[left + half]) ? left : left + half;
+			count -= half;
+		}
+		left += !TIMSORT_LESS(ix_value, arr[left]);
+
+		memmove(&arr[left + 1], &arr[left], (ix - left) * sizeof(TIMSORT_TYPE));
+		arr[left] = ix_value;
+		TIMSORT_VALUES(memmove(&vals[left + 1], &vals[left],
+							   (ix - left) * sizeof(TIMSORT_VALUE_TYPE));
+					   vals[left] = ix_payload);
+	}
+}
+
+#if defined(TIMSORT_NETWORK) && !defined(TIMSORT_VALUE_TYPE)
+/**
+ * Orders `arr[first]` and `arr[second]`. Both elements are always written back, through selects
+ * rather than a branch, so the compiler can emit conditional moves or min/max instructions.
+ * @param arr array holding the elements
+ * @param first index of the element that ends up the smaller one
+ * @param second index of the element that ends up the larger one
+ */
+TIMSORT_LINKAGE void TIMSORT_NAME(compareExchange)(TIMSORT_TYPE arr[], size_t first, size_t second)
+{
+	TIMSORT_TYPE lower = arr[first];
+	TIMSORT_TYPE upper = arr[second];
+	bool swap = TIMSORT_LESS(upper, lower);
+
+	arr[first] = swap ? upper : lower;
+	arr[second] = swap ? lower : upper;
+}
+
+/**
+ * Sorts the 8 elements starting at `arr` with an optimal 19 comparator sorting network. The
+ * comparators of each of the 6 layers are independent of each other.
+ * @param arr array of (at least) 8 elements
+ */
+TIMSORT_LINKAGE void TIMSORT_NAME(networkSort8)(TIMSORT_TYPE arr[])
+{
+	TIMSORT_NAME(compareExchange)(arr, 0, 2);
+	TIMSORT_NAME(compareExchange)(arr, 1, 3);
+	TIMSORT_NAME(compareExchange)(arr, 4, 6);
+	TIMSORT_NAME(compareExchange)(arr, 5, 7);
+
+	TIMSORT_NAME(compareExchange)(arr, 0, 4);
+	TIMSORT_NAME(compareExchange)(arr, 1, 5);
+	TIMSORT_NAME(compareExchange)(arr, 2, 6);
+	TIMSORT_NAME(compareExchange)(arr, 3, 7);
+
+	TIMSORT_NAME(compareExchange)(arr, 0, 1);
+	TIMSORT_NAME(compareExchange)(arr, 2, 3);
+	TIMSORT_NAME(compareExchange)(arr, 4, 5);
+	TIMSORT_NAME(compareExchange)(arr, 6, 7);
+
+	TIMSORT_NAME(compareExchange)(arr, 2, 4);
+	TIMSORT_NAME(compareExchange)(arr, 3, 5);
+
+	TIMSORT_NAME(compareExchange)(arr, 1, 4);
+	TIMSORT_NAME(compareExchange)(arr, 3, 6);
+
+	TIMSORT_NAME(compareExchange)(arr, 1, 2);
+	TIMSORT_NAME(compareExchange)(arr, 3, 4);
+	TIMSORT_NAME(compareExchange)(arr, 5, 6);
+}
+
+/**
+ * Sorts the short segment `arr[lowerBound .. upperBound)` without data dependent branches, as
+ * an alternative to `binaryInsertionSort` for building runs out of random data. Blocks of 8
+ * elements are sorted with `networkSort8`, the tail with insertion sort, and the blocks are then
+ * merged bottom-up through a stack buffer, picking each element with a select. Not stable.
+ * @param arr array to sort
+ * @param lowerBound lower bound
+ * @param upperBound upper bound (exclusive), at most `NETWORK_MAX_RUN` after `lowerBound`
+ */
+TIMSORT_LINKAGE void TIMSORT_NAME(networkSortRun)(TIMSORT_TYPE arr[], size_t lowerBound,
+												  size_t upperBound)
+{
+	TIMSORT_TYPE merged[NETWORK_MAX_RUN];
+	TIMSORT_TYPE *run = &arr[lowerBound];
+	size_t length = upperBound - lowerBound;
+	size_t blocksEnd = length & ~(size_t)7;
+
+	assert(length <= NETWORK_MAX_RUN);
+
+	for (size_t ix = 0; ix < blocksEnd; ix += 8)
+	{
+		TIMSORT_NAME(networkSort8)(&run[ix]);
+	}
+
+	if (blocksEnd < length)
+	{
+		TIMSORT_NAME(binaryInsertionSort)(run, blocksEnd, blocksEnd, length);
+	}
+
+	for (size_t width = 8; width < length; width *= 2)
+	{
+		for (size_t lower = 0; lower + width < length; lower += 2 * width)
+		{
+			size_t mid = lower + width;
+			size_t upper = min(mid + width, length);
+			size_t ix_fst = lower;
+			size_t ix_snd = mid;
+			size_t ix_out = 0;
+
+			while ((ix_fst < mid) && (ix_snd < upper))
+			{
+				bool takeSnd = TIMSORT_LESS(run[ix_snd], run[ix_fst]);
+
+				merged[ix_out++] = takeSnd ? run[ix_snd] : run[ix_fst];
+				ix_snd += takeSnd;
+				ix_fst += !takeSnd;
+			}
+
+			// what is left of the second block is already in place
+			memcpy(&merged[ix_out], &run[ix_fst], (mid - ix_fst) * sizeof(TIMSORT_TYPE));
+			ix_out += mid - ix_fst;
+			memcpy(&run[lower], merged, ix_out * sizeof(TIMSORT_TYPE));
+		}
+	}
+}
+#endif
+
+/**
+ * Finds the position at which `key` has to be inserted in the sorted segment `arr[0 .. length)`,
+ * to the left of any element equal to it. The search starts at `hint` and gallops (1, 3, 7, 15 ...)
+ * away from it before finishing with a binary search, so it costs O(log d) comparisons where `d` is
+ * the distance between `hint` and the result.
+ * @param key value to look for
+ * @param arr sorted segment to search
+ * @param length length of `arr`
+ * @param hint index to start the search from, `hint < length`
+ * @return The number of elements of `arr` that are strictly smaller than `key`
+ */
+TIMSORT_LINKAGE size_t TIMSORT_NAME(gallopLeft)(TIMSORT_TYPE key, TIMSORT_TYPE arr[], size_t length,
+												size_t hint)
+{
+	assert(hint < length);
+
+	// establish arr[lastOfs] < key <= arr[ofs], with lastOfs == -1 meaning "before the segment"
+	size_t lastOfs = 0;
+	size_t ofs = 1;
+
+	if (TIMSORT_LESS(arr[hint], key))
+	{
+		// gallop right until arr[hint + lastOfs] < key <= arr[hint + ofs]
+		size_t maxOfs = length - hint;
+		while ((ofs < maxOfs) && TIMSORT_LESS(arr[hint + ofs], key))
+		{
+			lastOfs = ofs;
+			ofs = (ofs << 1) + 1;
+		}
+		ofs = min(ofs, maxOfs);
+
+		lastOfs += hint + 1;
+		ofs += hint;
+	}
+	else
+	{
+		// gallop left until arr[hint - ofs] < key <= arr[hint - lastOfs]
+		size_t maxOfs = hint + 1;
+		while ((ofs < maxOfs) && !TIMSORT_LESS(arr[hint - ofs], key))
+		{
+			lastOfs = ofs;
+			ofs = (ofs << 1) + 1;
+		}
+		ofs = min(ofs, maxOfs);
+
+		size_t tmp = lastOfs;
+		lastOfs = hint + 1 - ofs;
+		ofs = hint - tmp;
+	}
+
+	// binary search in arr[lastOfs .. ofs]
+	while (lastOfs < ofs)
+	{
+		size_t mid = lastOfs + ((ofs - lastOfs) >> 1);
+
+		if (TIMSORT_LESS(arr[mid], key))
+		{
+			lastOfs = mid + 1;
+		}
+		else
+		{
+			ofs = mid;
+		}
+	}
+
+	return ofs;
+}
+
+/**
+ * Finds the position at which `key` has to be inserted in the sorted segment `arr[0 .. length)`,
+ * to the right of any element equal to it. See `gallopLeft` for the search strategy.
+ * @param key value to look for
+ * @param arr sorted segment to search
+ * @param length length of `arr`
+ * @param hint index to start the search from, `hint < length`
+ * @return The number of elements of `arr` that are smaller than or equal to `key`
+ */
+TIMSORT_LINKAGE size_t TIMSORT_NAME(gallopRight)(TIMSORT_TYPE key, TIMSORT_TYPE arr[],
+												 size_t length, size_t hint)
+{
+	assert(hint < length);
+
+	// establish arr[lastOfs] <= key < arr[ofs], with lastOfs == -1 meaning "before the segment"
+	size_t lastOfs = 0;
+	size_t ofs = 1;
+
+	if (TIMSORT_LESS(key, arr[hint]))
+	{
+		// gallop left until arr[hint - ofs] <= key < arr[hint - lastOfs]
+		size_t maxOfs = hint + 1;
+		while ((ofs < maxOfs) && TIMSORT_LESS(key, arr[hint - ofs]))
+		{
+			lastOfs = ofs;
+			ofs = (ofs << 1) + 1;
+		}
+		ofs = min(ofs, maxOfs);
+
+		size_t tmp = lastOfs;
+		lastOfs = hint + 1 - ofs;
+		ofs = hint - tmp;
+	}
+	else
+	{
+		// gallop right until arr[hint + lastOfs] <= key < arr[hint + ofs]
+		size_t maxOfs = length - hint;
+		while ((ofs < maxOfs) && !TIMSORT_LESS(key, arr[hint + ofs]))
+		{
+			lastOfs = ofs;
+			ofs = (ofs << 1) + 1;
+		}
+		ofs = min(ofs, maxOfs);
+
+		lastOfs += hint + 1;
+		ofs += hint;
+	}
+
+	// binary search in arr[lastOfs .. ofs]
+	while (lastOfs < ofs)
+	{
+		size_t mid = lastOfs + ((ofs - lastOfs) >> 1);
+
+		if (TIMSORT_LESS(key, arr[mid]))
+		{
+			ofs = mid;
+		}
+		else
+		{
+			lastOfs = mid + 1;
+		}
+	}
+
+	return ofs;
+}
+
+/**
+ * Merges two sorted arrays segments into a single run, using a fresh galloping state and the
+ * thread's shared merge buffer.
+ * @param arr array to sort
+ * @param lowerBound lower bound
+ * @param midPoint middle point that separates the two input runs
+ * @param upperBound upper bound
+ */
+TIMSORT_LINKAGE void TIMSORT_NAME(merge)(TIMSORT_TYPE arr[] TIMSORT_VALUES_PARAM, size_t lowerBound,
+										 size_t midPoint, size_t upperBound)
+{
+	merge_state_t state;
+	initMergeState(&state, upperBound, NULL, 0);
+
+	TIMSORT_NAME(mergeRuns)(&state, arr TIMSORT_VALUES_ARG, lowerBound, midPoint, upperBound);
+}
+
+/**
+ * Guesses whether the merge of the sorted segments `first` and `second` interleaves them randomly,
+ * from the runs that win the first `MERGE_SAMPLE` elements of the merge. A random sequence of wins
+ * differs from itself shifted by any lag at about half of the positions. Structured merges either
+ * change run rarely, so that few wins differ at lag 1, or repeat a short pattern that the branch
+ * predictor learns, such as the merges of arithmetic progressions, so that almost no wins differ
+ * at the length of the pattern.
+ * @param first first sorted segment
+ * @param lengthFirst length of `first`
+ * @param second second sorted segment
+ * @param lengthSecond length of `second`
+ * @return true when at least 3/8 of the sampled wins differ at lag 1, and 1/4 at lags 2 to 8
+ */
+TIMSORT_LINKAGE bool TIMSORT_NAME(mergeLooksRandom)(TIMSORT_TYPE first[], size_t lengthFirst,
+													TIMSORT_TYPE second[], size_t lengthSecond)
+{
+	// bit ix is set when the second run wins element ix of the merge
+	uint64_t wins = 0;
+	size_t sampled = 0;
+	size_t ix_fst = 0;
+	size_t ix_snd = 0;
+
+	assert(MERGE_SAMPLE <= 64);
+
+	while ((sampled < MERGE_SAMPLE) && (ix_fst < lengthFirst) && (ix_snd < lengthSecond))
+	{
+		bool takeSnd = TIMSORT_LESS(second[ix_snd], first[ix_fst]);
+
+		wins |= (uint64_t)takeSnd << sampled++;
+		ix_snd += takeSnd;
+		ix_fst += !takeSnd;
+
+		// merges that rarely change run usually give themselves away in the first quarter
+		if ((MERGE_SAMPLE / 4 == sampled) &&
+			(__builtin_popcountll((wins ^ (wins << 1)) & (((uint64_t)1 << sampled) - 2)) <
+			 (int)sampled / 4))
+		{
+			return false;
+		}
+	}
+
+	if (sampled < MERGE_SAMPLE)
+	{
+		return false;
+	}
+
+	for (size_t lag = 1; lag <= 8; lag++)
+	{
+		// positions lag .. sampled - 1 compared with the position `lag` before them
+		uint64_t compared = ((sampled < 64) ? ((uint64_t)1 << sampled) : 0) - 1;
+		uint64_t differ = (wins ^ (wins << lag)) & compared & ~(((uint64_t)1 << lag) - 1);
+
+		size_t minDiffer = (1 == lag) ? 3 * (sampled - lag) : 2 * (sampled - lag);
+
+		if ((size_t)__builtin_popcountll(differ) * 8 < minDiffer)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/**
+ * Merges two sorted arrays segments into a single run.
+ *
+ * The parts of the runs that are already in place are trimmed off first. Only the shorter of the
+ * remaining runs is copied to the merge buffer; the merge then runs forward (`mergeLo`) or
+ * backward (`mergeHi`) over the other run, in place.
+ * @param state galloping state and merge buffer shared by the merges of one sort
+ * @param arr array to sort
+ * @param lowerBound lower bound
+ * @param midPoint middle point that separates the two input runs
+ * @param upperBound upper bound
+ */
+TIMSORT_LINKAGE void TIMSORT_NAME(mergeRuns)(merge_state_t *state,
+											 TIMSORT_TYPE arr[] TIMSORT_VALUES_PARAM,
+											 size_t lowerBound, size_t midPoint, size_t upperBound)
+{
+	// sanity check
+	assert(lowerBound <= midPoint && midPoint <= upperBound);
+
+	if (lowerBound == midPoint || midPoint == upperBound)
+	{
+		return;
+	}
+
+	// elements of the first run that are not larger than the head of the second one are in place
+	lowerBound +=
+		TIMSORT_NAME(gallopRight)(arr[midPoint], &arr[lowerBound], midPoint - lowerBound, 0);
+	if (lowerBound == midPoint)
+	{
+		return;
+	}
+
+	// elements of the second run that are not smaller than the tail of the first one are in place
+	upperBound = midPoint + TIMSORT_NAME(gallopLeft)(arr[midPoint - 1], &arr[midPoint],
+													 upperBound - midPoint,
+													 upperBound - midPoint - 1);
+
+	if (midPoint - lowerBound <= upperBound - midPoint)
+	{
+		TIMSORT_NAME(mergeLo)(state, arr TIMSORT_VALUES_ARG, lowerBound, midPoint, upperBound);
+	}
+	else
+	{
+		TIMSORT_NAME(mergeHi)(state, arr TIMSORT_VALUES_ARG, lowerBound, midPoint, upperBound);
+	}
+}
+
+/**
+ * Merges two sorted arrays segments front to back, copying the first run to the merge buffer.
+ *
+ * Elements are taken one at a time until one of the runs wins `minGallop` times in a row. The
+ * merge then switches to galloping: it searches the winning run for the next element of the
+ * other run and moves the whole block at once. `minGallop` is lowered while galloping pays off
+ * and raised when it does not, and is carried over between merges in `state`.
+ *
+ * When `mergeLooksRandom` finds the runs randomly interleaved, galloping would not pay off and the
+ * comparison branch would mispredict half of the time. The runs are then merged by a loop that
+ * selects each output element and advances both indices arithmetically; each pass of it runs for
+ * as many elements as the shorter remaining run holds, so it checks no bound per element. That
+ * loop is only taken in optimised builds, see `TIMSORT_BRANCHLESS_MERGE`.
+ * @param state galloping state and merge buffer shared by the merges of one sort
+ * @param arr array to sort
+ * @param lowerBound lower bound
+ * @param midPoint middle point that separates the two input runs
+ * @param upperBound upper bound
+ */
+TIMSORT_LINKAGE void TIMSORT_NAME(mergeLo)(merge_state_t *state,
+										   TIMSORT_TYPE arr[] TIMSORT_VALUES_PARAM,
+										   size_t lowerBound, size_t midPoint, size_t upperBound)
+{
+	size_t lengthFirstHalf = midPoint - lowerBound;
+	size_t keyBytes = lengthFirstHalf * sizeof(TIMSORT_TYPE);
+	size_t scratchBytes = keyBytes;
+
+	// values are stored after the keys, at their own alignment
+	TIMSORT_VALUES(keyBytes = (keyBytes + _Alignof(TIMSORT_VALUE_TYPE) - 1) /
+							  _Alignof(TIMSORT_VALUE_TYPE) * _Alignof(TIMSORT_VALUE_TYPE);
+				   scratchBytes = keyBytes + lengthFirstHalf * sizeof(TIMSORT_VALUE_TYPE));
+
+	ensureScratch(state, scratchBytes);
+	TIMSORT_TYPE *firstHalf = state->scratch;
+	TIMSORT_VALUES(TIMSORT_VALUE_TYPE *valsFirstHalf =
+					   (void *)((char *)state->scratch + keyBytes));
+
+	// copy to intermediate storage, the second run is read in place
+	memcpy(firstHalf, &arr[lowerBound], lengthFirstHalf * sizeof(TIMSORT_TYPE));
+	TIMSORT_VALUES(memcpy(valsFirstHalf, &vals[lowerBound],
+						  lengthFirstHalf * sizeof(TIMSORT_VALUE_TYPE)));
+
+	// merge intermediate back to output
+	size_t ix_fst = 0;
+	size_t ix_snd = midPoint;
+	size_t ix_out = lowerBound;
+	size_t minGallop = state->minGallop;
+
+	if (TIMSORT_BRANCHLESS_MERGE &&
+		TIMSORT_NAME(mergeLooksRandom)(firstHalf, lengthFirstHalf, &arr[midPoint],
+									   upperBound - midPoint))
+	{
+		while ((ix_fst < lengthFirstHalf) && (ix_snd < upperBound))
+		{
+			// neither run can be exhausted within `steps` elements
+			for (size_t steps = min(lengthFirstHalf - ix_fst, upperBound - ix_snd); steps > 0;
+				 steps--)
+			{
+				bool takeSnd = TIMSORT_LESS(arr[ix_snd], firstHalf[ix_fst]);
+
+				TIMSORT_VALUES(vals[ix_out] = takeSnd ? vals[ix_snd] : valsFirstHalf[ix_fst]);
+				arr[ix_out++] = takeSnd ? arr[ix_snd] : firstHalf[ix_fst];
+				ix_snd += takeSnd;
+				ix_fst += !takeSnd;
+			}
+		}
+	}
+
+	while ((ix_fst < lengthFirstHalf) && (ix_snd < upperBound))
+	{
+		size_t winsFst = 0;
+		size_t winsSnd = 0;
+
+		// one element at a time, until one run keeps winning
+		while ((ix_fst < lengthFirstHalf) && (ix_snd < upperBound) && (winsFst < minGallop) &&
+			   (winsSnd < minGallop))
+		{
+			if (!TIMSORT_LESS(arr[ix_snd], firstHalf[ix_fst]))
+			{
+				TIMSORT_VALUES(vals[ix_out] = valsFirstHalf[ix_fst]);
+				arr[ix_out++] = firstHalf[ix_fst++];
+				winsFst++;
+				winsSnd = 0;
+			}
+			else
+			{
+				TIMSORT_VALUES(vals[ix_out] = vals[ix_snd]);
+				arr[ix_out++] = arr[ix_snd++];
+				winsSnd++;
+				winsFst = 0;
+			}
+		}
+
+		// gallop, until neither run wins a long enough block
+		while ((ix_fst < lengthFirstHalf) && (ix_snd < upperBound))
+		{
+			winsFst = TIMSORT_NAME(gallopRight)(arr[ix_snd], &firstHalf[ix_fst],
+												lengthFirstHalf - ix_fst, 0);
+			memcpy(&arr[ix_out], &firstHalf[ix_fst], winsFst * sizeof(TIMSORT_TYPE));
+			TIMSORT_VALUES(memcpy(&vals[ix_out], &valsFirstHalf[ix_fst],
+								  winsFst * sizeof(TIMSORT_VALUE_TYPE)));
+			ix_out += winsFst;
+			ix_fst += winsFst;
+
+			if (ix_fst == lengthFirstHalf)
+			{
+				break;
+			}
+
+			winsSnd =
+				TIMSORT_NAME(gallopLeft)(firstHalf[ix_fst], &arr[ix_snd], upperBound - ix_snd, 0);
+			memmove(&arr[ix_out], &arr[ix_snd], winsSnd * sizeof(TIMSORT_TYPE));
+			TIMSORT_VALUES(
+				memmove(&vals[ix_out], &vals[ix_snd], winsSnd * sizeof(TIMSORT_VALUE_TYPE)));
+			ix_out += winsSnd;
+			ix_snd += winsSnd;
+
+			if (ix_snd == upperBound)
+			{
+				break;
+			}
+
+			// both heads are now known to belong next: firstHalf[ix_fst] <= arr[ix_snd]
+			TIMSORT_VALUES(vals[ix_out] = valsFirstHalf[ix_fst]);
+			arr[ix_out++] = firstHalf[ix_fst++];
+
+			if ((winsFst < MIN_GALLOP) && (winsSnd < MIN_GALLOP))
+			{
+				// galloping stopped paying off, make it harder to re-enter
+				minGallop += 2;
+				break;
+			}
+
+			if (minGallop > 1)
+			{
+				minGallop--;
+			}
+		}
+	}
+
+	state->minGallop = minGallop;
+
+	// copy straglers, what is left of the second run is already in place
+	if (ix_fst < lengthFirstHalf)
+	{
+		memcpy(&arr[ix_out], &firstHalf[ix_fst], (lengthFirstHalf - ix_fst) * sizeof(TIMSORT_TYPE));
+		TIMSORT_VALUES(memcpy(&vals[ix_out], &valsFirstHalf[ix_fst],
+							  (lengthFirstHalf - ix_fst) * sizeof(TIMSORT_VALUE_TYPE)));
+	}
+}
+
+/**
+ * Merges two sorted arrays segments back to front, copying the second run to the merge buffer.
+ * Mirror image of `mergeLo`, including the branchless loop for randomly interleaved runs.
+ * @param state galloping state and merge buffer shared by the merges of one sort
+ * @param arr array to sort
+ * @param lowerBound lower bound
+ * @param midPoint middle point that separates the two input runs
+ * @param upperBound upper bound
+ */
+TIMSORT_LINKAGE void TIMSORT_NAME(mergeHi)(merge_state_t *state,
+										   TIMSORT_TYPE arr[] TIMSORT_VALUES_PARAM,
+										   size_t lowerBound, size_t midPoint, size_t upperBound)
+{
+	size_t lengthSecondHalf = upperBound - midPoint;
+	size_t keyBytes = lengthSecondHalf * sizeof(TIMSORT_TYPE);
+	size_t scratchBytes = keyBytes;
+
+	// values are stored after the keys, at their own alignment
+	TIMSORT_VALUES(keyBytes = (keyBytes + _Alignof(TIMSORT_VALUE_TYPE) - 1) /
+							  _Alignof(TIMSORT_VALUE_TYPE) * _Alignof(TIMSORT_VALUE_TYPE);
+				   scratchBytes = keyBytes + lengthSecondHalf * sizeof(TIMSORT_VALUE_TYPE));
+
+	ensureScratch(state, scratchBytes);
+	TIMSORT_TYPE *secondHalf = state->scratch;
+	TIMSORT_VALUES(TIMSORT_VALUE_TYPE *valsSecondHalf =
+					   (void *)((char *)state->scratch + keyBytes));
+
+	// copy to intermediate storage, the first run is read in place
+	memcpy(secondHalf, &arr[midPoint], lengthSecondHalf * sizeof(TIMSORT_TYPE));
+	TIMSORT_VALUES(memcpy(valsSecondHalf, &vals[midPoint],
+						  lengthSecondHalf * sizeof(TIMSORT_VALUE_TYPE)));
+
+	// merge intermediate back to output, `left_*` count the elements not yet merged
+	size_t left_fst = midPoint - lowerBound;
+	size_t left_snd = lengthSecondHalf;
+	size_t ix_out = upperBound;
+	size_t minGallop = state->minGallop;
+
+	if (TIMSORT_BRANCHLESS_MERGE &&
+		TIMSORT_NAME(mergeLooksRandom)(&arr[lowerBound], left_fst, secondHalf, left_snd))
+	{
+		while ((left_fst > 0) && (left_snd > 0))
+		{
+			// neither run can be exhausted within `steps` elements
+			for (size_t steps = min(left_fst, left_snd); steps > 0; steps--)
+			{
+				bool takeFst =
+					TIMSORT_LESS(secondHalf[left_snd - 1], arr[lowerBound + left_fst - 1]);
+
+				--ix_out;
+				TIMSORT_VALUES(vals[ix_out] = takeFst ? vals[lowerBound + left_fst - 1]
+													  : valsSecondHalf[left_snd - 1]);
+				arr[ix_out] = takeFst ? arr[lowerBound + left_fst - 1] : secondHalf[left_snd - 1];
+				left_fst -= takeFst;
+				left_snd -= !takeFst;
+			}
+		}
+	}
+
+	while ((left_fst > 0) && (left_snd > 0))
+	{
+		size_t winsFst = 0;
+		size_t winsSnd = 0;
+
+		// one element at a time, until one run keeps winning
+		while ((left_fst > 0) && (left_snd > 0) && (winsFst < minGallop) &&
+			   (winsSnd < minGallop))
+		{
+			if (TIMSORT_LESS(secondHalf[left_snd - 1], arr[lowerBound + left_fst - 1]))
+			{
+				arr[--ix_out] = arr[lowerBound + --left_fst];
+				TIMSORT_VALUES(vals[ix_out] = vals[lowerBound + left_fst]);
+				winsFst++;
+				winsSnd = 0;
+			}
+			else
+			{
+				arr[--ix_out] = secondHalf[--left_snd];
+				TIMSORT_VALUES(vals[ix_out] = valsSecondHalf[left_snd]);
+				winsSnd++;
+				winsFst = 0;
+			}
+		}
+
+		// gallop, until neither run wins a long enough block
+		while ((left_fst > 0) && (left_snd > 0))
+		{
+			winsFst = left_fst - TIMSORT_NAME(gallopRight)(secondHalf[left_snd - 1],
+														   &arr[lowerBound], left_fst,
+														   left_fst - 1);
+			ix_out -= winsFst;
+			left_fst -= winsFst;
+			memmove(&arr[ix_out], &arr[lowerBound + left_fst], winsFst * sizeof(TIMSORT_TYPE));
+			TIMSORT_VALUES(memmove(&vals[ix_out], &vals[lowerBound + left_fst],
+								   winsFst * sizeof(TIMSORT_VALUE_TYPE)));
+
+			if (0 == left_fst)
+			{
+				break;
+			}
+
+			winsSnd = left_snd - TIMSORT_NAME(gallopLeft)(arr[lowerBound + left_fst - 1],
+														  secondHalf, left_snd, left_snd - 1);
+			ix_out -= winsSnd;
+			left_snd -= winsSnd;
+			memcpy(&arr[ix_out], &secondHalf[left_snd], winsSnd * sizeof(TIMSORT_TYPE));
+			TIMSORT_VALUES(memcpy(&vals[ix_out], &valsSecondHalf[left_snd],
+								  winsSnd * sizeof(TIMSORT_VALUE_TYPE)));
+
+			if (0 == left_snd)
+			{
+				break;
+			}
+
+			// both tails are now known to belong next: secondHalf[left_snd - 1] < first tail
+			arr[--ix_out] = arr[lowerBound + --left_fst];
+			TIMSORT_VALUES(vals[ix_out] = vals[lowerBound + left_fst]);
+
+			if ((winsFst < MIN_GALLOP) && (winsSnd < MIN_GALLOP))
+			{
+				// galloping stopped paying off, make it harder to re-enter
+				minGallop += 2;
+				break;
+			}
+
+			if (minGallop > 1)
+			{
+				minGallop--;
+			}
+		}
+	}
+
+	state->minGallop = minGallop;
+
+	// copy straglers, what is left of the first run is already in place
+	if (left_snd > 0)
+	{
+		memcpy(&arr[lowerBound], secondHalf, left_snd * sizeof(TIMSORT_TYPE));
+		TIMSORT_VALUES(
+			memcpy(&vals[lowerBound], valsSecondHalf, left_snd * sizeof(TIMSORT_VALUE_TYPE)));
+	}
+}
+
+/**
+ * Reverses the segment `arr[lowerBound .. upperBound)` in place.
+ * @param arr array holding the segment
+ * @param lowerBound lower bound
+ * @param upperBound upper bound (exclusive)
+ */
+TIMSORT_LINKAGE void TIMSORT_NAME(reverseRange)(TIMSORT_TYPE arr[] TIMSORT_VALUES_PARAM,
+												size_t lowerBound, size_t upperBound)
+{
+	while (lowerBound + 1 < upperBound)
+	{
+		TIMSORT_TYPE tmp = arr[lowerBound];
+		arr[lowerBound] = arr[--upperBound];
+		arr[upperBound] = tmp;
+
+		TIMSORT_VALUES(TIMSORT_VALUE_TYPE payload = vals[lowerBound];
+					   vals[lowerBound] = vals[upperBound]; vals[upperBound] = payload);
+
+		lowerBound++;
+	}
+}
+
+/**
+ * Finds the natural run that starts at `lowerBound`. A run is either non-descending or strictly
+ * descending; strictly descending runs are reversed in place so that every run is returned in
+ * ascending order. Equal elements never make a run descending, which keeps the sort stable.
+ * @param arr array to scan
+ * @param lowerBound start of the run
+ * @param upperBound upper bound (exclusive) of the scan
+ * @return The end (exclusive) of the run
+ */
+TIMSORT_LINKAGE size_t TIMSORT_NAME(countRunAndMakeAscending)(
+	TIMSORT_TYPE arr[] TIMSORT_VALUES_PARAM, size_t lowerBound, size_t upperBound)
+{
+	size_t runEnd = lowerBound + 1;
+
+	if (runEnd >= upperBound)
+	{
+		return upperBound;
+	}
+
+	if (TIMSORT_LESS(arr[runEnd], arr[lowerBound]))
+	{
+		runEnd++;
+		while ((runEnd < upperBound) && TIMSORT_LESS(arr[runEnd], arr[runEnd - 1]))
+		{
+			runEnd++;
+		}
+		TIMSORT_NAME(reverseRange)(arr TIMSORT_VALUES_ARG, lowerBound, runEnd);
+	}
+	else
+	{
+		runEnd++;
+		while ((runEnd < upperBound) && !TIMSORT_LESS(arr[runEnd], arr[runEnd - 1]))
+		{
+			runEnd++;
+		}
+	}
+
+	return runEnd;
+}
+
+/**
+ * Merges the pending runs `ix` and `ix + 1` of `state`, which are neighbours in the array.
+ * @param state merge state of the current sort
+ * @param arr array being sorted
+ * @param ix position of the first run on the pending run stack
+ */
+TIMSORT_LINKAGE void TIMSORT_NAME(mergeAt)(merge_state_t *state,
+										   TIMSORT_TYPE arr[] TIMSORT_VALUES_PARAM, size_t ix)
+{
+	assert(ix + 1 < state->pendingRuns);
+
+	size_t lowerBound = state->runBase[ix];
+	size_t midPoint = state->runBase[ix + 1];
+	size_t upperBound = midPoint + state->runLength[ix + 1];
+
+	TIMSORT_NAME(mergeRuns)(state, arr TIMSORT_VALUES_ARG, lowerBound, midPoint, upperBound);
+
+	state->runLength[ix] += state->runLength[ix + 1];
+	state->runLevel[ix]++;
+	state->runPower[ix] = state->runPower[ix + 1];
+
+	// the run above the merged pair, if any, moves down
+	if (ix + 2 < state->pendingRuns)
+	{
+		state->runBase[ix + 1] = state->runBase[ix + 2];
+		state->runLength[ix + 1] = state->runLength[ix + 2];
+		state->runLevel[ix + 1] = state->runLevel[ix + 2];
+		state->runPower[ix + 1] = state->runPower[ix + 2];
+	}
+
+	state->pendingRuns--;
+}
+
+/**
+ * Merges pending runs until the invariants of the merge policy of `state` hold again, after a
+ * run has been pushed.
+ * - bottom-up: two neighbouring runs are merged as soon as they hold the same number of natural
+ *   runs, like the carries of a binary counter. This is the fixed-width doubling of a bottom-up
+ *   merge sort, applied to natural runs of uneven length.
+ * - timsort: going down the stack, every run is longer than the two above it combined, and every
+ *   run is longer than the one above it.
+ * - powersort: the node powers of the boundaries between pending runs increase up the stack. The
+ *   runs below a boundary with a higher power than the new one are merged first, so merges follow
+ *   a balanced tree and recently found runs are merged while they are still in cache.
+ * @param state merge state of the current sort
+ * @param arr array being sorted
+ */
+TIMSORT_LINKAGE void TIMSORT_NAME(mergeCollapse)(merge_state_t *state,
+												 TIMSORT_TYPE arr[] TIMSORT_VALUES_PARAM)
+{
+	switch (state->policy)
+	{
+	case MERGE_POLICY_BOTTOM_UP:
+		while ((state->pendingRuns >= 2) && (state->runLevel[state->pendingRuns - 2] ==
+											 state->runLevel[state->pendingRuns - 1]))
+		{
+			TIMSORT_NAME(mergeAt)(state, arr TIMSORT_VALUES_ARG, state->pendingRuns - 2);
+		}
+		break;
+
+	case MERGE_POLICY_TIMSORT:
+		while (state->pendingRuns >= 2)
+		{
+			size_t ix = state->pendingRuns - 2;
+			size_t *runLength = state->runLength;
+
+			if (((ix >= 1) && (runLength[ix - 1] <= runLength[ix] + runLength[ix + 1])) ||
+				((ix >= 2) && (runLength[ix - 2] <= runLength[ix - 1] + runLength[ix])))
+			{
+				// merge the middle run with the shorter of its neighbours
+				if (runLength[ix - 1] < runLength[ix + 1])
+				{
+					ix--;
+				}
+			}
+			else if (runLength[ix] > runLength[ix + 1])
+			{
+				break;
+			}
+
+			TIMSORT_NAME(mergeAt)(state, arr TIMSORT_VALUES_ARG, ix);
+		}
+		break;
+
+	case MERGE_POLICY_POWERSORT:
+		if (state->pendingRuns >= 2)
+		{
+			size_t top = state->pendingRuns - 1;
+			size_t power = nodePower(state->runBase[top - 1], state->runLength[top - 1],
+									 state->runLength[top], state->arrayLength);
+
+			while ((state->pendingRuns >= 3) && (state->runPower[state->pendingRuns - 3] > power))
+			{
+				TIMSORT_NAME(mergeAt)(state, arr TIMSORT_VALUES_ARG, state->pendingRuns - 3);
+			}
+
+			state->runPower[state->pendingRuns - 2] = power;
+		}
+		break;
+	}
+}
+
+/**
+ * Merges all pending runs, leaving a single sorted run. The middle run of the top three is merged
+ * with the shorter of its neighbours, which keeps merges balanced for every policy.
+ * @param state merge state of the current sort
+ * @param arr array being sorted
+ */
+TIMSORT_LINKAGE void TIMSORT_NAME(mergeForceCollapse)(merge_state_t *state,
+													  TIMSORT_TYPE arr[] TIMSORT_VALUES_PARAM)
+{
+	while (state->pendingRuns >= 2)
+	{
+		size_t ix = state->pendingRuns - 2;
+
+		if ((ix >= 1) && (state->runLength[ix - 1] < state->runLength[ix + 1]))
+		{
+			ix--;
+		}
+
+		TIMSORT_NAME(mergeAt)(state, arr TIMSORT_VALUES_ARG, ix);
+	}
+}
+
+/**
+ * Sorts runs and merges them, using the merge buffer already attached to `state`.
+ * @param state merge state, with an empty run stack
+ * @param arr Array to sort
+ * @param length The legth of `arr`
+ */
+TIMSORT_LINKAGE void TIMSORT_NAME(sortRuns)(merge_state_t *state,
+											TIMSORT_TYPE arr[] TIMSORT_VALUES_PARAM, size_t length)
+{
+	size_t minRun = timSortRunLength(length);
+	size_t lowerBound = 0;
+
+	while (lowerBound < length)
+	{
+		size_t upperBound =
+			TIMSORT_NAME(countRunAndMakeAscending)(arr TIMSORT_VALUES_ARG, lowerBound, length);
+
+		// extend short runs to `minRun` elements
+		if (upperBound - lowerBound < minRun)
+		{
+			size_t runEnd = upperBound;
+
+			upperBound = min(lowerBound + minRun, length);
+
+#if defined(TIMSORT_NETWORK) && !defined(TIMSORT_VALUE_TYPE)
+			// random data: sort the whole run without branching on the elements
+			if ((runEnd - lowerBound < 8) && (upperBound - lowerBound <= NETWORK_MAX_RUN))
+			{
+				TIMSORT_NAME(networkSortRun)(arr, lowerBound, upperBound);
+			}
+			else
+#endif
+			{
+				TIMSORT_NAME(binaryInsertionSort)(arr TIMSORT_VALUES_ARG, lowerBound, runEnd,
+												  upperBound);
+			}
+		}
+
+		pushRun(state, lowerBound, upperBound - lowerBound);
+		TIMSORT_NAME(mergeCollapse)(state, arr TIMSORT_VALUES_ARG);
+
+		lowerBound = upperBound;
+	}
+
+	TIMSORT_NAME(mergeForceCollapse)(state, arr TIMSORT_VALUES_ARG);
+}
+
+/**
+ * Timsort routine for an array of `TIMSORT_TYPE`.
+ *
+ * The array is split into natural runs (descending ones are reversed), runs shorter than
+ * `timSortRunLength(length)` are extended with insertion sort and the runs are then merged. Sorted,
+ * reversed and nearly sorted inputs are handled in O(n). Merges use a heap buffer that is shared
+ * by all sorts on the calling thread and grows as needed; see `timSortFreeBuffer`.
+ * @param arr Array to sort
+ * @param length The legth of `arr`
+ */
+TIMSORT_LINKAGE void TIMSORT_NAME(timSort)(TIMSORT_TYPE arr[] TIMSORT_VALUES_PARAM, size_t length)
+{
+	merge_state_t state;
+	initMergeState(&state, length, NULL, 0);
+
+	TIMSORT_NAME(sortRuns)(&state, arr TIMSORT_VALUES_ARG, length);
+}
+
+#ifndef TIMSORT_VALUE_TYPE
+/**
+ * Timsort routine for an array of `TIMSORT_TYPE` that merges through a caller-supplied buffer and
+ * does no allocation. One buffer can be reused across any number of calls.
+ * @param arr Array to sort
+ * @param length The legth of `arr`
+ * @param scratch merge buffer
+ * @param scratchLength length of `scratch`, at least `timSortBufferLength(length)`
+ * @return true on success. false, leaving `arr` untouched, when `scratch` is too short
+ */
+TIMSORT_LINKAGE bool TIMSORT_NAME(timSortWithBuffer)(TIMSORT_TYPE arr[], size_t length,
+													 TIMSORT_TYPE scratch[], size_t scratchLength)
+{
+	if (scratchLength < timSortBufferLength(length))
+	{
+		return false;
+	}
+
+	merge_state_t state;
+	initMergeState(&state, length, scratch, scratchLength * sizeof(TIMSORT_TYPE));
+
+	TIMSORT_NAME(sortRuns)(&state, arr, length);
+
+	return true;
+}
+#endif
+
+#undef TIMSORT_TYPE
+#undef TIMSORT_SUFFIX
+#undef TIMSORT_LESS
+#undef TIMSORT_NAME
+#undef TIMSORT_LINKAGE
+#undef TIMSORT_VALUE_TYPE
+#undef TIMSORT_NETWORK
+#undef TIMSORT_VALUES_PARAM
+#undef TIMSORT_VALUES_ARG
+#undef TIMSORT_VALUES
+#undef TIMSORT_BRANCHLESS_MERGE
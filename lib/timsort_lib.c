@@ -4,174 +4,1542 @@
 #include <assert.h>
 #include <cheri/cheric.h>
 #include <cheriintrin.h>
+#include <pthread.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 const int RUN_LENGTH = 32;
+const size_t MIN_GALLOP = 7;
+const size_t MERGE_SAMPLE = 64;
+const size_t PARALLEL_MIN_CHUNK = 4096;
+const size_t PROFILE_SAMPLES = 256;
+const size_t SELECT_SMALL = 32;
+
+// run length set with `timSortSetRunLength`, 0 when runs use `minRunLength`
+static size_t runLengthOverride = 0;
+
+// merge policy set with `timSortSetMergePolicy`
+static merge_policy_t mergePolicy = MERGE_POLICY_POWERSORT;
+
+// merge buffer shared by the sorts of each thread, see `ensureScratch`
+static _Thread_local void *sharedScratch = NULL;
+static _Thread_local size_t sharedScratchBytes = 0;
+
+// thresholds of `timSortChoose`, set with `timSortSetThresholds`
+static const sort_thresholds_t defaultThresholds = {.minLength = 1024,
+													.minAverageRun = 8,
+													.maxInversionPercent = 0,
+													.countingMaxRange = 1 << 16,
+													.radixWideLength = 1 << 18};
+static sort_thresholds_t sortThresholds = defaultThresholds;
+
+// comparison function of the running `timSortQsort`
+static _Thread_local int (*qsortCompar)(const void *, const void *) = NULL;
+
+/**
+ * Sorts the input array, in place, using `insertion sort`.
+ * @param arr array to sort
+ * @param lowerBound lower bound
+ * @param upperBound upper bound
+ */
+void insertionSort(int arr[], size_t lowerBound, size_t upperBound)
+{
+	binaryInsertionSort(arr, lowerBound, lowerBound + 1, upperBound + 1);
+}
+
+/**
+ * Sets the length to which `timSort` extends short natural runs, e.g. to benchmark run lengths
+ * between 32 and 128. The setting is process wide.
+ * @param runLength the run length to use, 0 restores the default of `minRunLength(n)`
+ */
+void timSortSetRunLength(size_t runLength)
+{
+	runLengthOverride = runLength;
+}
+
+/**
+ * Length to which short natural runs are extended when sorting `length` elements: the value set
+ * with `timSortSetRunLength`, or `minRunLength(length)` by default.
+ * @param length The legth of the array to sort
+ * @return The minimum run length
+ */
+size_t timSortRunLength(size_t length)
+{
+	return (0 != runLengthOverride) ? runLengthOverride : minRunLength(length);
+}
+
+/**
+ * Grows the merge buffer of `state` so that it holds at least `bytes` bytes. Only the thread's
+ * shared buffer can grow; a buffer supplied by the caller is checked up front to be large enough
+ * for any merge. The shared buffer grows geometrically and is never shrunk, so that it is
+ * allocated a handful of times per thread rather than once per merge.
+ * @param state merge state of the current sort
+ * @param bytes number of bytes needed
+ */
+void ensureScratch(merge_state_t *state, size_t bytes)
+{
+	if (bytes <= state->scratchBytes)
+	{
+		return;
+	}
+
+	assert(state->scratchShared);
+
+	size_t newBytes = sharedScratchBytes;
+	while (newBytes < bytes)
+	{
+		newBytes = (newBytes < 1024) ? 1024 : newBytes * 2;
+	}
+
+	void *newScratch = realloc(sharedScratch, newBytes);
+	if (NULL == newScratch)
+	{
+		error("Could not allocate the merge buffer");
+		exit(EXIT_FAILURE);
+	}
+
+	sharedScratch = newScratch;
+	sharedScratchBytes = newBytes;
+
+	state->scratch = sharedScratch;
+	state->scratchBytes = sharedScratchBytes;
+}
+
+/**
+ * Releases the calling thread's shared merge buffer, used by `timSort`, `merge` and their typed
+ * variants. The next sort on this thread allocates it again.
+ */
+void timSortFreeBuffer(void)
+{
+	free(sharedScratch);
+	sharedScratch = NULL;
+	sharedScratchBytes = 0;
+}
+
+/**
+ * Number of elements of scratch space `timSortWithBuffer` needs to sort `length` elements: no
+ * merge copies more than the shorter of its two runs.
+ * @param length The legth of the array to sort
+ * @return The minimum length of the scratch buffer
+ */
+size_t timSortBufferLength(size_t length)
+{
+	return length / 2;
+}
+
+/**
+ * Min of two size_t arguments.
+ * @param a first value to choose from
+ * @param b second value to choose from
+ * @return The minimum value between `a` and `b`
+ */
+size_t min(size_t a, size_t b)
+{
+	if (a <= b)
+	{
+		return a;
+	}
+	else
+	{
+		return b;
+	}
+}
+
+/**
+ * Computes the minimum run length for an array of `length` elements. Short natural runs are
+ * extended to this length with insertion sort. The result lies in [RUN_LENGTH, 2 * RUN_LENGTH]
+ * and is chosen so that `length / minRun` is equal to, or slightly less than, a power of two,
+ * which keeps the merges balanced. Arrays shorter than `2 * RUN_LENGTH` are a single run.
+ * @param length The legth of the array to sort
+ * @return The minimum run length
+ */
+size_t minRunLength(size_t length)
+{
+	// becomes 1 if any bit shifted off is set
+	size_t remainder = 0;
+
+	while (length >= 2 * (size_t)RUN_LENGTH)
+	{
+		remainder |= length & 1;
+		length >>= 1;
+	}
+
+	return length + remainder;
+}
+
+/**
+ * Computes the powersort node power of the boundary between the neighbouring runs
+ * `[runBase, runBase + lengthFirst)` and `[runBase + lengthFirst, ... + lengthSecond)` of an array
+ * of `length` elements: the depth, in a perfectly balanced merge tree over [0, 1), of the node
+ * that separates the midpoints of the two runs. Computed by long division on the doubled
+ * midpoints, one quotient bit per iteration.
+ * @param runBase start of the first run
+ * @param lengthFirst length of the first run
+ * @param lengthSecond length of the second run
+ * @param length The legth of the array being sorted
+ * @return The node power, at least 1
+ */
+size_t nodePower(size_t runBase, size_t lengthFirst, size_t lengthSecond, size_t length)
+{
+	size_t power = 0;
+
+	// twice the midpoints of both runs, as fractions of `length`
+	size_t midFirst = 2 * runBase + lengthFirst;
+	size_t midSecond = midFirst + lengthFirst + lengthSecond;
+
+	while (true)
+	{
+		power++;
+
+		if (midFirst >= length)
+		{
+			// both quotient bits are 1
+			midFirst -= length;
+			midSecond -= length;
+		}
+		else if (midSecond >= length)
+		{
+			// the midpoints fall on either side of this node
+			break;
+		}
+
+		midFirst <<= 1;
+		midSecond <<= 1;
+	}
+
+	return power;
+}
+
+/**
+ * Selects how `timSort` decides which pending runs to merge. The setting is process wide.
+ * - MERGE_POLICY_BOTTOM_UP: merge neighbours holding the same number of natural runs
+ * - MERGE_POLICY_TIMSORT: keep run lengths growing faster than Fibonacci down the stack
+ * - MERGE_POLICY_POWERSORT: merge along a nearly optimal tree given by `nodePower` (default)
+ * @param policy the merge policy to use
+ */
+void timSortSetMergePolicy(merge_policy_t policy)
+{
+	mergePolicy = policy;
+}
+
+/**
+ * Prepares `state` for a sort of `length` elements with the current merge policy.
+ * @param state merge state to initialise
+ * @param length The legth of the array to sort
+ * @param scratch merge buffer supplied by the caller, NULL to use the thread's shared buffer
+ * @param scratchBytes size of `scratch` in bytes
+ */
+void initMergeState(merge_state_t *state, size_t length, void *scratch, size_t scratchBytes)
+{
+	state->minGallop = MIN_GALLOP;
+	state->pendingRuns = 0;
+	state->policy = mergePolicy;
+	state->arrayLength = length;
+
+	if (NULL == scratch)
+	{
+		state->scratch = sharedScratch;
+		state->scratchBytes = sharedScratchBytes;
+		state->scratchShared = true;
+	}
+	else
+	{
+		state->scratch = scratch;
+		state->scratchBytes = scratchBytes;
+		state->scratchShared = false;
+	}
+}
+
+/**
+ * Pushes the run `arr[runBase .. runBase + runLength)` on the pending run stack of `state`.
+ * @param state merge state of the current sort
+ * @param runBase start of the run
+ * @param runLength length of the run
+ */
+void pushRun(merge_state_t *state, size_t runBase, size_t runLength)
+{
+	assert(state->pendingRuns < MAX_PENDING_RUNS);
+
+	state->runBase[state->pendingRuns] = runBase;
+	state->runLength[state->pendingRuns] = runLength;
+	state->runLevel[state->pendingRuns] = 0;
+	state->runPower[state->pendingRuns] = 0;
+	state->pendingRuns++;
+}
+
+// `int` keeps the unsuffixed names of the original library
+#define TIMSORT_TYPE int
+#define TIMSORT_NAME(name) name
+#define TIMSORT_NETWORK
+#include "timsort_impl.h"
+
+#define TIMSORT_TYPE int64_t
+#define TIMSORT_SUFFIX i64
+#define TIMSORT_NETWORK
+#include "timsort_impl.h"
+
+#define TIMSORT_TYPE uint32_t
+#define TIMSORT_SUFFIX u32
+#define TIMSORT_NETWORK
+#include "timsort_impl.h"
+
+#define TIMSORT_TYPE float
+#define TIMSORT_SUFFIX f32
+#include "timsort_impl.h"
+
+#define TIMSORT_TYPE double
+#define TIMSORT_SUFFIX f64
+#include "timsort_impl.h"
+
+// keys with a payload of the same type, behind `timSortKV`
+#define TIMSORT_TYPE int
+#define TIMSORT_SUFFIX kv
+#define TIMSORT_VALUE_TYPE int
+#define TIMSORT_LINKAGE static inline
+#include "timsort_impl.h"
+
+// keys with their original positions, behind `timArgSort`
+#define TIMSORT_TYPE int
+#define TIMSORT_SUFFIX argsort
+#define TIMSORT_VALUE_TYPE size_t
+#define TIMSORT_LINKAGE static inline
+#include "timsort_impl.h"
+
+/**
+ * Stable sort of `keys` that applies the same permutation to `values`. Keys and values stay in
+ * their own arrays: every move of a key in the kernels is mirrored on `values`, and merges copy the
+ * values of the shorter run to the shared merge buffer after its keys.
+ * @param keys Array to sort
+ * @param values payload of each key, permuted along with `keys`
+ * @param length The legth of `keys` and `values`
+ */
+void timSortKV(int keys[], int values[], size_t length)
+{
+	timSort_kv(keys, values, length);
+}
+
+/**
+ * Computes the permutation that stably sorts `keys`, which are left untouched: `keys[order[0]]`,
+ * `keys[order[1]]` ... is in ascending order, and equal keys keep their original order. The keys
+ * are sorted in a temporary copy, with the positions co-sorted in `order`.
+ * @param keys keys to order
+ * @param order output, receives the position in `keys` of each element of the sorted sequence
+ * @param length The legth of `keys` and `order`
+ */
+void timArgSort(int keys[], size_t order[], size_t length)
+{
+	for (size_t ix = 0; ix < length; ix++)
+	{
+		order[ix] = ix;
+	}
+
+	if (length <= 1)
+	{
+		return;
+	}
+
+	int *sortedKeys = malloc(length * sizeof(int));
+	if (NULL == sortedKeys)
+	{
+		error("Could not allocate the argsort keys");
+		exit(EXIT_FAILURE);
+	}
+
+	memcpy(sortedKeys, keys, length * sizeof(int));
+	timSort_argsort(sortedKeys, order, length);
+
+	free(sortedKeys);
+}
+
+/**
+ * Work shared by the threads of one `timSortParallel` call.
+ * - arr, aux: the array being sorted and a buffer of the same length, merges alternate between them
+ * - length, threads: length of `arr` and number of threads taking part
+ * - barrier: separates the chunk sorting and each level of merges
+ */
+typedef struct parallel_sort
+{
+	int *arr;
+	int *aux;
+	size_t length;
+	size_t threads;
+	pthread_barrier_t barrier;
+} parallel_sort_t;
+
+/**
+ * A thread's share of a `parallel_sort_t`.
+ * - sort: work shared by all threads
+ * - id: index of the thread, 0 is the calling thread
+ */
+typedef struct parallel_worker
+{
+	parallel_sort_t *sort;
+	size_t id;
+} parallel_worker_t;
+
+/**
+ * Merge path co-rank: the number of elements of `first` among the first `rank` elements of the
+ * stable merge of the sorted arrays `first` and `second`. Ties are taken from `first`, as in
+ * `mergeRuns`, so that merges split at any rank still produce the stable order.
+ * @param rank rank in the merged output, at most `lengthFirst + lengthSecond`
+ * @param first first sorted array
+ * @param lengthFirst length of `first`
+ * @param second second sorted array
+ * @param lengthSecond length of `second`
+ * @return The number of elements taken from `first`
+ */
+size_t mergeCoRank(size_t rank, int first[], size_t lengthFirst, int second[], size_t lengthSecond)
+{
+	size_t lower = (rank > lengthSecond) ? rank - lengthSecond : 0;
+	size_t upper = min(rank, lengthFirst);
+
+	while (lower < upper)
+	{
+		size_t mid = lower + ((upper - lower) >> 1);
+
+		// first[mid] is merged before second[rank - mid - 1] unless it is strictly larger
+		if (first[mid] <= second[rank - mid - 1])
+		{
+			lower = mid + 1;
+		}
+		else
+		{
+			upper = mid;
+		}
+	}
+
+	return lower;
+}
+
+/**
+ * Merges the sorted arrays `first` and `second` into `out`, taking ties from `first`.
+ * @param out output, `lengthFirst + lengthSecond` elements
+ * @param first first sorted array
+ * @param lengthFirst length of `first`
+ * @param second second sorted array
+ * @param lengthSecond length of `second`
+ */
+void mergeInto(int out[], int first[], size_t lengthFirst, int second[], size_t lengthSecond)
+{
+	size_t ix_fst = 0;
+	size_t ix_snd = 0;
+	size_t ix_out = 0;
+
+	while ((ix_fst < lengthFirst) && (ix_snd < lengthSecond))
+	{
+		if (second[ix_snd] < first[ix_fst])
+		{
+			out[ix_out++] = second[ix_snd++];
+		}
+		else
+		{
+			out[ix_out++] = first[ix_fst++];
+		}
+	}
+
+	memcpy(&out[ix_out], &first[ix_fst], (lengthFirst - ix_fst) * sizeof(int));
+	ix_out += lengthFirst - ix_fst;
+	memcpy(&out[ix_out], &second[ix_snd], (lengthSecond - ix_snd) * sizeof(int));
+}
+
+/**
+ * Body of each thread of `timSortParallel`. Thread `id` first timsorts chunk `id` of the array.
+ * Neighbouring chunks are then merged pairwise, level by level, from one buffer to the other. The
+ * threads are spread evenly over the merges of a level and each takes an equal share of the output
+ * of its merge, located in the inputs with `mergeCoRank`, so every thread keeps working up to the
+ * final merge. Every thread tracks the run boundaries itself, they only depend on `length` and
+ * `threads`.
+ * @param arg the thread's `parallel_worker_t`
+ * @return NULL
+ */
+void *timSortParallelWorker(void *arg)
+{
+	parallel_worker_t *worker = arg;
+	parallel_sort_t *sort = worker->sort;
+	size_t threads = sort->threads;
+	size_t id = worker->id;
+
+	// runBound[ix] is the start of run ix, runBound[runs] the end of the array
+	size_t *runBound = malloc((threads + 1) * sizeof(size_t));
+	if (NULL == runBound)
+	{
+		error("Could not allocate the run bounds");
+		exit(EXIT_FAILURE);
+	}
+
+	for (size_t ix = 0; ix <= threads; ix++)
+	{
+		runBound[ix] = ix * sort->length / threads;
+	}
+
+	timSort(&sort->arr[runBound[id]], runBound[id + 1] - runBound[id]);
+
+	// the caller's merge buffer outlives the sort, the workers' would leak
+	if (0 != id)
+	{
+		timSortFreeBuffer();
+	}
+
+	pthread_barrier_wait(&sort->barrier);
+
+	int *from = sort->arr;
+	int *to = sort->aux;
+	size_t runs = threads;
+
+	while (runs > 1)
+	{
+		// an odd run out is "merged" with an empty run, which copies it
+		size_t merges = (runs + 1) / 2;
+		size_t ix_merge = id * merges / threads;
+
+		// threads [firstThread, lastThread) share this merge
+		size_t firstThread = (ix_merge * threads + merges - 1) / merges;
+		size_t lastThread = ((ix_merge + 1) * threads + merges - 1) / merges;
+
+		size_t lowerBound = runBound[2 * ix_merge];
+		size_t midPoint = runBound[min(2 * ix_merge + 1, runs)];
+		size_t upperBound = runBound[min(2 * ix_merge + 2, runs)];
+		size_t lengthFirst = midPoint - lowerBound;
+		size_t lengthSecond = upperBound - midPoint;
+		size_t lengthOut = lengthFirst + lengthSecond;
+
+		size_t part = id - firstThread;
+		size_t parts = lastThread - firstThread;
+		size_t rankLower = part * lengthOut / parts;
+		size_t rankUpper = (part + 1) * lengthOut / parts;
+
+		size_t fstLower =
+			mergeCoRank(rankLower, &from[lowerBound], lengthFirst, &from[midPoint], lengthSecond);
+		size_t fstUpper =
+			mergeCoRank(rankUpper, &from[lowerBound], lengthFirst, &from[midPoint], lengthSecond);
+
+		mergeInto(&to[lowerBound + rankLower], &from[lowerBound + fstLower], fstUpper - fstLower,
+				  &from[midPoint + rankLower - fstLower],
+				  (rankUpper - fstUpper) - (rankLower - fstLower));
+
+		// the merged runs start at every other boundary
+		for (size_t ix = 1; ix < merges; ix++)
+		{
+			runBound[ix] = runBound[2 * ix];
+		}
+		runBound[merges] = sort->length;
+		runs = merges;
+
+		int *swap = from;
+		from = to;
+		to = swap;
+
+		pthread_barrier_wait(&sort->barrier);
+	}
+
+	// after an odd number of levels the sorted array is in `aux`
+	if (from != sort->arr)
+	{
+		size_t lowerBound = id * sort->length / threads;
+		size_t upperBound = (id + 1) * sort->length / threads;
+
+		memcpy(&sort->arr[lowerBound], &from[lowerBound], (upperBound - lowerBound) * sizeof(int));
+	}
+
+	free(runBound);
+
+	return NULL;
+}
+
+/**
+ * Timsort routine that uses up to `nthreads` threads, the calling one included. The array is cut
+ * into one chunk per thread, the chunks are timsorted concurrently and then merged pairwise with
+ * every thread taking part in every level of merges; see `timSortParallelWorker`. The sort is
+ * stable, so the result is identical to that of `timSort`. Fewer threads are used when chunks
+ * would be shorter than `PARALLEL_MIN_CHUNK` elements, down to a plain `timSort`.
+ * @param arr Array to sort
+ * @param length The legth of `arr`
+ * @param nthreads maximum number of threads to use
+ */
+void timSortParallel(int arr[], size_t length, size_t nthreads)
+{
+	size_t threads = min(nthreads, length / PARALLEL_MIN_CHUNK);
+
+	if (threads <= 1)
+	{
+		timSort(arr, length);
+		return;
+	}
+
+	parallel_sort_t sort = {.arr = arr, .length = length, .threads = threads};
+	pthread_t *thread = malloc(threads * sizeof(pthread_t));
+	parallel_worker_t *worker = malloc(threads * sizeof(parallel_worker_t));
+	sort.aux = malloc(length * sizeof(int));
+	if (NULL == thread || NULL == worker || NULL == sort.aux)
+	{
+		error("Could not allocate the parallel sort");
+		exit(EXIT_FAILURE);
+	}
+
+	if (0 != pthread_barrier_init(&sort.barrier, NULL, threads))
+	{
+		error("Could not create the parallel sort barrier");
+		exit(EXIT_FAILURE);
+	}
+
+	for (size_t ix = 0; ix < threads; ix++)
+	{
+		worker[ix].sort = &sort;
+		worker[ix].id = ix;
+	}
+
+	for (size_t ix = 1; ix < threads; ix++)
+	{
+		if (0 != pthread_create(&thread[ix], NULL, timSortParallelWorker, &worker[ix]))
+		{
+			error("Could not start a parallel sort thread");
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	timSortParallelWorker(&worker[0]);
+
+	for (size_t ix = 1; ix < threads; ix++)
+	{
+		pthread_join(thread[ix], NULL);
+	}
+
+	pthread_barrier_destroy(&sort.barrier);
+	free(sort.aux);
+	free(worker);
+	free(thread);
+}
+
+// elements of `timSortQsort`, ordered through the caller's comparison function
+#define TIMSORT_TYPE char *
+#define TIMSORT_SUFFIX qsort
+#define TIMSORT_LESS(a, b) (qsortCompar((a), (b)) < 0)
+#define TIMSORT_LINKAGE static inline
+#include "timsort_impl.h"
+
+/**
+ * Stable, `qsort`-compatible sort of `nmemb` elements of `size` bytes each. The elements are not
+ * moved while sorting: an array of pointers to them is timsorted through `compar`, and the
+ * elements are then put in place by following the cycles of the resulting permutation, moving each
+ * element once. Typed variants such as `timSort_i64` avoid the indirect call per comparison.
+ * @param base array to sort
+ * @param nmemb number of elements of `base`
+ * @param size size of an element in bytes
+ * @param compar comparison function, with the same contract as for `qsort`
+ */
+void timSortQsort(void *base, size_t nmemb, size_t size, int (*compar)(const void *, const void *))
+{
+	if (nmemb <= 1 || 0 == size)
+	{
+		return;
+	}
+
+	char **order = malloc(nmemb * sizeof(char *));
+	char *carry = malloc(size);
+	if (NULL == order || NULL == carry)
+	{
+		error("Could not allocate the sort permutation");
+		exit(EXIT_FAILURE);
+	}
+
+	for (size_t ix = 0; ix < nmemb; ix++)
+	{
+		order[ix] = (char *)base + ix * size;
+	}
+
+	int (*callerCompar)(const void *, const void *) = qsortCompar;
+	qsortCompar = compar;
+	timSort_qsort(order, nmemb);
+	qsortCompar = callerCompar;
+
+	// order[ix] is the element that belongs at position ix; place each cycle with one carry slot
+	for (size_t ix = 0; ix < nmemb; ix++)
+	{
+		char *slot = (char *)base + ix * size;
+
+		if (order[ix] == slot)
+		{
+			continue;
+		}
+
+		memcpy(carry, slot, size);
+
+		// fill each hole from the slot whose element belongs there, until the cycle closes
+		char *hole = slot;
+		while (true)
+		{
+			size_t ixHole = (size_t)(hole - (char *)base) / size;
+			char *from = order[ixHole];
+			order[ixHole] = hole;
+
+			if (from == slot)
+			{
+				memcpy(hole, carry, size);
+				break;
+			}
+
+			memcpy(hole, from, size);
+			hole = from;
+		}
+	}
+
+	free(carry);
+	free(order);
+}
+
+/**
+ * Loser tree over the heads of `k` sorted inputs, see `mergeK`. Input `ix` is leaf `k + ix` of
+ * an implicit binary tree in which node `n` has children `2n` and `2n + 1`. Nodes hold the keys
+ * of `loserKey`, which carry the index of their input.
+ * - k: number of inputs
+ * - node: node[0] holds the key of the input with the smallest head, node[1 .. k) the key of the
+ *   loser of the match played at each internal node
+ * - next, remaining: next element of each input, and number of elements left in its current
+ *   block, 0 once the input is exhausted
+ */
+typedef struct loser_tree
+{
+	size_t k;
+	int64_t *node;
+	const int **next;
+	size_t *remaining;
+} loser_tree_t;
+
+/**
+ * Sort key of the head of input `input` of `tree`: the head in the upper 32 bits and the index of
+ * the input in the lower ones, so that ties go to the input with the lower index, which keeps the
+ * merge stable. Exhausted inputs get the largest key and lose to every other. A match is then a
+ * minimum and a maximum, which compile to conditional moves.
+ * @param tree loser tree
+ * @param input input of `tree`
+ * @return The key of the input
+ */
+static inline int64_t loserKey(const loser_tree_t *tree, size_t input)
+{
+	if (0 == tree->remaining[input])
+	{
+		return INT64_MAX;
+	}
+
+	return (int64_t)*tree->next[input] * ((int64_t)1 << 32) + (int64_t)input;
+}
+
+/**
+ * Input whose key is at the root of `tree`, the next one to merge.
+ * @param tree loser tree
+ * @return The index of the winning input
+ */
+static inline size_t loserWinner(const loser_tree_t *tree)
+{
+	return (size_t)(tree->node[0] & 0xFFFFFFFF);
+}
+
+/**
+ * Allocates the nodes of `tree` for `k` inputs. `next` and `remaining` are then set by the caller
+ * before `loserTreeBuild`.
+ * @param tree loser tree
+ * @param k number of inputs, at least 1 and below 2^32
+ */
+static void loserTreeInit(loser_tree_t *tree, size_t k)
+{
+	tree->k = k;
+	tree->node = malloc(3 * k * sizeof(int64_t));
+	tree->next = malloc(k * sizeof(int *));
+	tree->remaining = malloc(k * sizeof(size_t));
+
+	if (NULL == tree->node || NULL == tree->next || NULL == tree->remaining)
+	{
+		error("Could not allocate the loser tree");
+		exit(EXIT_FAILURE);
+	}
+}
+
+/**
+ * Frees the nodes of `tree`.
+ * @param tree loser tree
+ */
+static void loserTreeFree(loser_tree_t *tree)
+{
+	free(tree->remaining);
+	free(tree->next);
+	free(tree->node);
+}
+
+/**
+ * Plays all matches of `tree` bottom-up, once the heads of all inputs are set.
+ * @param tree loser tree
+ */
+static void loserTreeBuild(loser_tree_t *tree)
+{
+	size_t k = tree->k;
+
+	// winners of each match, only needed while building: node[k .. 3k) is free space
+	int64_t *winner = &tree->node[k];
+
+	for (size_t ix = 0; ix < k; ix++)
+	{
+		winner[k + ix] = loserKey(tree, ix);
+	}
+
+	for (size_t ix = k - 1; ix >= 1; ix--)
+	{
+		int64_t left = winner[2 * ix];
+		int64_t right = winner[2 * ix + 1];
+
+		winner[ix] = (left < right) ? left : right;
+		tree->node[ix] = (left < right) ? right : left;
+	}
+
+	// with a single input, winner[1] is its leaf
+	tree->node[0] = winner[1];
+}
+
+/**
+ * Replays the matches on the path from input `input` to the root, after its head has changed.
+ * Only the losers stored along the path are compared, about log2(k) comparisons.
+ * @param tree loser tree
+ * @param input input whose head changed, the previous winner
+ */
+static inline void loserTreeReplay(loser_tree_t *tree, size_t input)
+{
+	int64_t winnerKey = loserKey(tree, input);
+
+	for (size_t ix = (tree->k + input) / 2; ix >= 1; ix /= 2)
+	{
+		int64_t otherKey = tree->node[ix];
+
+		tree->node[ix] = (otherKey < winnerKey) ? winnerKey : otherKey;
+		winnerKey = (otherKey < winnerKey) ? otherKey : winnerKey;
+	}
+
+	tree->node[0] = winnerKey;
+}
+
+/**
+ * Merges `k` sorted runs into `out` in a single pass, with a loser tree: each element costs about
+ * log2(k) comparisons, where merging the runs pairwise would make log2(k) passes over the data.
+ * Equal elements keep the order of their runs.
+ * @param runs sorted runs to merge
+ * @param k number of runs
+ * @param out output, as long as all runs together; must not overlap them
+ */
+void mergeK(sorted_run_t runs[], size_t k, int out[])
+{
+	if (0 == k)
+	{
+		return;
+	}
+
+	loser_tree_t tree;
+	loserTreeInit(&tree, k);
+
+	size_t length = 0;
+	for (size_t ix = 0; ix < k; ix++)
+	{
+		tree.next[ix] = runs[ix].data;
+		tree.remaining[ix] = runs[ix].length;
+		length += runs[ix].length;
+	}
+
+	loserTreeBuild(&tree);
+
+	for (size_t ix_out = 0; ix_out < length; ix_out++)
+	{
+		size_t winner = loserWinner(&tree);
+
+		out[ix_out] = *tree.next[winner]++;
+		tree.remaining[winner]--;
+		loserTreeReplay(&tree, winner);
+	}
+
+	loserTreeFree(&tree);
+}
+
+/**
+ * Streaming variant of `mergeK`: the inputs are read and the output is written in blocks of
+ * `blockLength` elements through callbacks, so that inputs and output need not fit in memory.
+ * The merge holds one block per input and one output block.
+ * @param sources sorted inputs, each read until its `read` callback returns 0
+ * @param k number of inputs
+ * @param write called with each block of the merged output, the last one may be shorter
+ * @param writeContext passed to `write`
+ * @param blockLength length of the blocks, at least 1
+ * @return The number of elements merged
+ */
+size_t mergeKStream(merge_source_t sources[], size_t k, merge_write_t write, void *writeContext,
+					size_t blockLength)
+{
+	if (0 == k)
+	{
+		return 0;
+	}
+
+	loser_tree_t tree;
+	loserTreeInit(&tree, k);
+
+	int *blocks = malloc((k + 1) * blockLength * sizeof(int));
+	if (NULL == blocks)
+	{
+		error("Could not allocate the merge blocks");
+		exit(EXIT_FAILURE);
+	}
+
+	for (size_t ix = 0; ix < k; ix++)
+	{
+		int *block = &blocks[ix * blockLength];
+
+		tree.next[ix] = block;
+		tree.remaining[ix] = sources[ix].read(sources[ix].context, block, blockLength);
+	}
+
+	loserTreeBuild(&tree);
+
+	int *out = &blocks[k * blockLength];
+	size_t outLength = 0;
+	size_t merged = 0;
+
+	while (INT64_MAX != tree.node[0])
+	{
+		size_t winner = loserWinner(&tree);
+
+		out[outLength++] = *tree.next[winner]++;
+
+		if (blockLength == outLength)
+		{
+			write(writeContext, out, outLength);
+			merged += outLength;
+			outLength = 0;
+		}
+
+		// an emptied block is refilled before the matches are replayed
+		if (0 == --tree.remaining[winner])
+		{
+			int *block = &blocks[winner * blockLength];
+
+			tree.next[winner] = block;
+			tree.remaining[winner] =
+				sources[winner].read(sources[winner].context, block, blockLength);
+		}
+
+		loserTreeReplay(&tree, winner);
+	}
+
+	if (outLength > 0)
+	{
+		write(writeContext, out, outLength);
+		merged += outLength;
+	}
+
+	free(blocks);
+	loserTreeFree(&tree);
+
+	return merged;
+}
 
 /**
- * Checks if an array of integers `arr` having length `length` is sorted in ascending order.
- * @param arr Array to sort
+ * splitmix64 finaliser, which picks the pairs sampled by `sortProfile`.
+ * @param x value to mix
+ * @return mixed value
+ */
+static inline uint64_t profileMix(uint64_t x)
+{
+	x += 0x9E3779B97F4A7C15ULL;
+	x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+
+	return x ^ (x >> 31);
+}
+
+/**
+ * Measures the presortedness of `arr` in one pass, to decide whether and how to sort it. The pass
+ * goes through blocks of `SORTED_CHECK_BLOCK` elements, counted and ranged without data-dependent
+ * branches; runs are only followed element by element in the blocks where some of them end. The
+ * inversions are estimated from `PROFILE_SAMPLES` pairs at random positions, which are the same
+ * for every call with the same length.
+ * @param arr array to profile, left untouched
  * @param length The legth of `arr`
+ * @param profile output, see `sort_profile_t`
  */
-bool isSorted(int arr[], size_t length)
+void sortProfile(int arr[], size_t length, sort_profile_t *profile)
 {
-	// short-circuit: empty and singleton arrays are always sorted.
-	if (length <= 1)
+	*profile = (sort_profile_t){.length = length};
+
+	if (0 == length)
+	{
+		return;
+	}
+
+	size_t descents = 0;
+	size_t descendingRuns = 0;
+	size_t runBase = 0;
+	size_t longestRun = 1;
+	int minValue = arr[0];
+	int maxValue = arr[0];
+
+	// position 1 has no previous pair, so that every block below compares 3 elements
+	if (length > 1)
 	{
-		return true;
+		descents = descendingRuns = (arr[1] < arr[0]);
+		runBase = descents;
+		minValue = (arr[1] < minValue) ? arr[1] : minValue;
+		maxValue = (arr[1] > maxValue) ? arr[1] : maxValue;
 	}
 
-	for (size_t ix = 1; ix < length; ix++)
+	for (size_t ix = 2; ix < length; ix += SORTED_CHECK_BLOCK)
 	{
-		if (arr[ix - 1] > arr[ix])
+		size_t upperBound = (length - ix < SORTED_CHECK_BLOCK) ? length : ix + SORTED_CHECK_BLOCK;
+
+		// per block counts are ints, which keeps all lanes of the vectorised loops the same width
+		int blockDescents = 0;
+		int blockDescendingRuns = 0;
+
+		// counts and range without branches, vectorised by the compiler
+		for (size_t jx = ix; jx < upperBound; jx++)
+		{
+			blockDescents += (arr[jx] < arr[jx - 1]);
+			minValue = (arr[jx] < minValue) ? arr[jx] : minValue;
+			maxValue = (arr[jx] > maxValue) ? arr[jx] : maxValue;
+		}
+
+		for (size_t jx = ix; jx < upperBound; jx++)
 		{
-			return false;
+			blockDescendingRuns += (arr[jx] < arr[jx - 1]) & !(arr[jx - 1] < arr[jx - 2]);
 		}
+
+		// runs only need following through blocks that end some of them, with selects rather than
+		// branches, which would be mispredicted on random data
+		for (size_t jx = ix; (0 != blockDescents) && (jx < upperBound); jx++)
+		{
+			bool descent = arr[jx] < arr[jx - 1];
+			size_t runLength = jx - runBase;
+
+			longestRun = (descent && runLength > longestRun) ? runLength : longestRun;
+			runBase = descent ? jx : runBase;
+		}
+
+		descents += (size_t)blockDescents;
+		descendingRuns += (size_t)blockDescendingRuns;
+	}
+
+	longestRun = (length - runBase > longestRun) ? length - runBase : longestRun;
+
+	profile->runs = descents + 1;
+	profile->longestRun = longestRun;
+	profile->descendingRuns = descendingRuns;
+	profile->minValue = minValue;
+	profile->maxValue = maxValue;
+
+	if (length < 2)
+	{
+		return;
+	}
+
+	size_t inversions = 0;
+
+	for (size_t ix = 0; ix < PROFILE_SAMPLES; ix++)
+	{
+		uint64_t bits = profileMix(length ^ profileMix(ix));
+		size_t first = (size_t)(bits % length);
+		size_t second = (size_t)(profileMix(bits) % (length - 1));
+
+		// two distinct positions, in order
+		second += (second >= first);
+		size_t lower = (first < second) ? first : second;
+		size_t upper = (first < second) ? second : first;
+
+		inversions += (arr[upper] < arr[lower]);
 	}
 
-	return true;
+	profile->sampledPairs = PROFILE_SAMPLES;
+	profile->sampledInversions = inversions;
+	profile->inversions =
+		(uint64_t)((double)inversions / (double)PROFILE_SAMPLES * (double)length *
+				   (double)(length - 1) / 2.0);
 }
 
 /**
- * Sorts the input array, in place, using `insertion sort`.
- * @param arr array to sort
- * @param lowerBound lower bound
- * @param upperBound upper bound
+ * Unsigned radix key of `value`: flipping the sign bit maps the ints to the same order of uint32.
+ * @param value value to sort
+ * @return The key of `value`
  */
-void insertionSort(int arr[], size_t lowerBound, size_t upperBound)
+static inline uint32_t radixKey(int value)
+{
+	return (uint32_t)value ^ 0x80000000u;
+}
+
+/**
+ * Sorts `arr` with a stable least significant digit radix sort, by digits of `digitBits` bits.
+ * The histograms of all digits are built in a single pass; a digit that is the same for all
+ * elements is skipped, so that small or clustered key ranges take fewer passes. The elements go
+ * back and forth between `arr` and the thread's shared merge buffer, which also holds the
+ * histograms.
+ * @param arr Array to sort
+ * @param length The legth of `arr`
+ * @param digitBits bits of each digit, 1 to `RADIX_MAX_DIGIT_BITS`
+ */
+void radixSort(int arr[], size_t length, size_t digitBits)
 {
-	for (size_t ix = lowerBound + 1; ix <= upperBound; ix++)
+	assert(digitBits >= 1 && digitBits <= RADIX_MAX_DIGIT_BITS);
+
+	if (length <= 1)
+	{
+		return;
+	}
+
+	size_t digits = (32 + digitBits - 1) / digitBits;
+	size_t buckets = (size_t)1 << digitBits;
+	size_t countBytes = digits * buckets * sizeof(size_t);
+
+	merge_state_t state;
+	initMergeState(&state, length, NULL, 0);
+	ensureScratch(&state, countBytes + length * sizeof(int));
+
+	size_t *counts = state.scratch;
+	int *buffer = (int *)&counts[digits * buckets];
+	memset(counts, 0, countBytes);
+
+	for (size_t ix = 0; ix < length; ix++)
 	{
-		int ix_value = arr[ix];
-		size_t ixp = ix - 1;
-		bool hitBottom = false;
+		uint32_t key = radixKey(arr[ix]);
 
-		while ((ixp >= lowerBound) && (arr[ixp] > ix_value))
+		for (size_t digit = 0; digit < digits; digit++)
 		{
-			arr[ixp + 1] = arr[ixp];
+			counts[digit * buckets + ((key >> (digit * digitBits)) & (buckets - 1))]++;
+		}
+	}
 
-			if (ixp > 0)
-			{
-				ixp--;
-			}
-			else
-			{
-				arr[ixp] = ix_value;
-				hitBottom = true;
-				break;
-			}
+	int *from = arr;
+	int *to = buffer;
+
+	for (size_t digit = 0; digit < digits; digit++)
+	{
+		size_t *count = &counts[digit * buckets];
+		size_t shift = digit * digitBits;
+
+		// skip pass: every element falls in the bucket of the first one
+		if (length == count[(radixKey(from[0]) >> shift) & (buckets - 1)])
+		{
+			continue;
 		}
 
-		if (!hitBottom)
+		// bucket counts become the position of the first element of each bucket
+		size_t position = 0;
+		for (size_t bucket = 0; bucket < buckets; bucket++)
 		{
-			arr[ixp + 1] = ix_value;
+			size_t bucketLength = count[bucket];
+			count[bucket] = position;
+			position += bucketLength;
 		}
+
+		for (size_t ix = 0; ix < length; ix++)
+		{
+			to[count[(radixKey(from[ix]) >> shift) & (buckets - 1)]++] = from[ix];
+		}
+
+		int *swap = from;
+		from = to;
+		to = swap;
+	}
+
+	if (from != arr)
+	{
+		memcpy(arr, from, length * sizeof(int));
 	}
 }
 
 /**
- * Merges two sorted arrays segments into a single run.
- * @param arr array to sort
+ * Sorts `arr` by counting the occurrences of each value of `[minValue, maxValue]`, then writing
+ * them back in order. Equal ints cannot be told apart, so the result is the one of a stable sort.
+ * The counts live in the thread's shared merge buffer.
+ * @param arr Array to sort, all elements within `[minValue, maxValue]`
+ * @param length The legth of `arr`
+ * @param minValue smallest element of `arr`
+ * @param maxValue largest element of `arr`
+ */
+void countingSort(int arr[], size_t length, int minValue, int maxValue)
+{
+	if (length <= 1)
+	{
+		return;
+	}
+
+	size_t range = (size_t)((int64_t)maxValue - (int64_t)minValue) + 1;
+
+	merge_state_t state;
+	initMergeState(&state, length, NULL, 0);
+	ensureScratch(&state, range * sizeof(size_t));
+
+	size_t *counts = state.scratch;
+	memset(counts, 0, range * sizeof(size_t));
+
+	for (size_t ix = 0; ix < length; ix++)
+	{
+		counts[(int64_t)arr[ix] - (int64_t)minValue]++;
+	}
+
+	size_t ix_out = 0;
+	for (size_t value = 0; value < range; value++)
+	{
+		for (size_t count = counts[value]; count > 0; count--)
+		{
+			arr[ix_out++] = (int)((int64_t)minValue + (int64_t)value);
+		}
+	}
+}
+
+/**
+ * Sets the thresholds `timSortChoose` uses to pick a sort.
+ * @param thresholds new thresholds, NULL restores the defaults
+ */
+void timSortSetThresholds(const sort_thresholds_t *thresholds)
+{
+	sortThresholds = (NULL != thresholds) ? *thresholds : defaultThresholds;
+}
+
+/**
+ * Reads the thresholds `timSortChoose` uses to pick a sort, for instance to change one of them.
+ * @param thresholds output, the current thresholds
+ */
+void timSortGetThresholds(sort_thresholds_t *thresholds)
+{
+	*thresholds = sortThresholds;
+}
+
+/**
+ * Picks the sort of `timSortAdaptive` from the profile of an array. Short arrays, arrays made of
+ * long ascending or descending runs and arrays with few sampled inversions are left to timsort,
+ * which takes advantage of their order.
+ * The others go to counting sort when their values span a small range, and to radix sort
+ * otherwise.
+ * @param profile profile of the array, see `sortProfile`
+ * @return The algorithm to sort the array with
+ */
+sort_algorithm_t timSortChoose(const sort_profile_t *profile)
+{
+	const sort_thresholds_t *thresholds = &sortThresholds;
+
+	// every descent lies in a descending stretch, so the array splits into at most
+	// 2 * descendingRuns + 1 ascending and descending runs, which timsort finds as they are
+	if (profile->length < thresholds->minLength ||
+		(2 * profile->descendingRuns + 1) * thresholds->minAverageRun <= profile->length ||
+		profile->sampledInversions * 100 < profile->sampledPairs * thresholds->maxInversionPercent)
+	{
+		return SORT_ALGORITHM_TIMSORT;
+	}
+
+	uint64_t range = (uint64_t)((int64_t)profile->maxValue - (int64_t)profile->minValue) + 1;
+
+	if (range <= thresholds->countingMaxRange && range <= profile->length)
+	{
+		return SORT_ALGORITHM_COUNTING;
+	}
+
+	return SORT_ALGORITHM_RADIX;
+}
+
+/**
+ * Sorts `arr` with timsort, counting sort or radix sort, as picked by `timSortChoose` from the
+ * profile of `arr`. The result is the same whatever the sort picked. Arrays shorter than the
+ * `minLength` threshold go straight to timsort, without being profiled.
+ * @param arr Array to sort
+ * @param length The legth of `arr`
+ * @return The algorithm `arr` was sorted with
+ */
+sort_algorithm_t timSortAdaptive(int arr[], size_t length)
+{
+	if (length < sortThresholds.minLength)
+	{
+		timSort(arr, length);
+		return SORT_ALGORITHM_TIMSORT;
+	}
+
+	sort_profile_t profile;
+	sortProfile(arr, length, &profile);
+
+	sort_algorithm_t algorithm = timSortChoose(&profile);
+
+	switch (algorithm)
+	{
+	case SORT_ALGORITHM_TIMSORT:
+		timSort(arr, length);
+		break;
+
+	case SORT_ALGORITHM_COUNTING:
+		countingSort(arr, length, profile.minValue, profile.maxValue);
+		break;
+
+	case SORT_ALGORITHM_RADIX:
+		radixSort(arr, length, (length >= sortThresholds.radixWideLength) ? 11 : 8);
+		break;
+	}
+
+	return algorithm;
+}
+
+/**
+ * Median of three ints.
+ * @param a first value
+ * @param b second value
+ * @param c third value
+ * @return The median of `a`, `b` and `c`
+ */
+static inline int medianOfThree(int a, int b, int c)
+{
+	if (a < b)
+	{
+		return (b < c) ? b : ((a < c) ? c : a);
+	}
+
+	return (a < c) ? a : ((b < c) ? c : b);
+}
+
+/**
+ * Pivot of a partition of `arr[lowerBound .. upperBound)` by `timNthElement`: the median of three
+ * elements at pseudo-random positions, or on ranges of 1024 elements or more the median of three
+ * such medians. Random positions keep periodic inputs, such as sawtooths, from handing out the
+ * same poor pivot at every step.
+ * @param arr array being partitioned
  * @param lowerBound lower bound
- * @param midPoint middle point that separates the two input runs
  * @param upperBound upper bound
+ * @param seed state of the position generator, advanced by the call
+ * @return The pivot, an element of the range
  */
-void merge(int arr[], size_t lowerBound, size_t midPoint, size_t upperBound)
+static int selectPivot(int arr[], size_t lowerBound, size_t upperBound, uint64_t *seed)
 {
-	// sanity check
-	assert(lowerBound <= midPoint && midPoint <= upperBound);
+	size_t range = upperBound - lowerBound;
+	size_t samples = (range >= 1024) ? 3 : 1;
+	int medians[3];
+
+	for (size_t ix = 0; ix < samples; ix++)
+	{
+		int values[3];
+
+		for (size_t jx = 0; jx < 3; jx++)
+		{
+			*seed = profileMix(*seed);
+			values[jx] = arr[lowerBound + (size_t)(*seed % range)];
+		}
+
+		medians[ix] = medianOfThree(values[0], values[1], values[2]);
+	}
 
-	// allocations
-	size_t lengthFirstHalf = midPoint - lowerBound;
-	size_t lengthSecondHalf = upperBound - midPoint;
+	return (1 == samples) ? medians[0] : medianOfThree(medians[0], medians[1], medians[2]);
+}
 
-	int firstHalf[lengthFirstHalf];
-	int secondHalf[lengthSecondHalf];
+/**
+ * Rearranges `arr` so that `arr[nth]` is the element that would be there if `arr` was sorted,
+ * with no larger element before it and no smaller one after it. Introselect: quickselect on the
+ * pivots of `selectPivot`, with a three-way partition so that runs of equal elements end the
+ * search, and ranges of up to `SELECT_SMALL` elements finished by binary insertion sort. After
+ * 2 log2(n) partitions the remaining range is sorted with `timSort`, which bounds the worst case
+ * to O(n log n); the expected work is O(n).
+ * @param arr Array to rearrange
+ * @param length The legth of `arr`
+ * @param nth position of the element to place, nothing is done if it is out of `arr`
+ */
+void timNthElement(int arr[], size_t length, size_t nth)
+{
+	if (nth >= length)
+	{
+		return;
+	}
 
-	// copy to inntermediate storage
-	memcpy(firstHalf, &arr[lowerBound], lengthFirstHalf * sizeof(int));
-	memcpy(secondHalf, &arr[midPoint], lengthSecondHalf * sizeof(int));
+	size_t lowerBound = 0;
+	size_t upperBound = length;
+	size_t depth = 2 * (size_t)(64 - __builtin_clzll((unsigned long long)length));
+	uint64_t seed = length ^ nth;
 
-	// merge intermediate back to output
-	size_t ix_fst = 0;
-	size_t ix_snd = 0;
-	size_t ix_out = lowerBound;
-	while ((ix_fst < lengthFirstHalf) && (ix_snd < lengthSecondHalf))
+	while (upperBound - lowerBound > SELECT_SMALL)
 	{
+		if (0 == depth--)
+		{
+			timSort(&arr[lowerBound], upperBound - lowerBound);
+			return;
+		}
+
+		int pivot = selectPivot(arr, lowerBound, upperBound, &seed);
+
+		// below `less` the elements are smaller than the pivot, from `greater` on they are larger,
+		// and in between the ones up to `ix` are equal to it
+		size_t less = lowerBound;
+		size_t greater = upperBound;
 
-		if (firstHalf[ix_fst] <= secondHalf[ix_snd])
+		for (size_t ix = lowerBound; ix < greater;)
 		{
-			arr[ix_out++] = firstHalf[ix_fst++];
+			int value = arr[ix];
+
+			if (value < pivot)
+			{
+				arr[ix++] = arr[less];
+				arr[less++] = value;
+			}
+			else if (pivot < value)
+			{
+				arr[ix] = arr[--greater];
+				arr[greater] = value;
+			}
+			else
+			{
+				ix++;
+			}
+		}
+
+		if (nth < less)
+		{
+			upperBound = less;
+		}
+		else if (nth >= greater)
+		{
+			lowerBound = greater;
 		}
 		else
 		{
-			arr[ix_out++] = secondHalf[ix_snd++];
+			return;
 		}
 	}
 
-	// copy straglers
-	if (ix_fst < lengthFirstHalf)
+	binaryInsertionSort(arr, lowerBound, lowerBound + 1, upperBound);
+}
+
+/**
+ * Sorts the `k` smallest elements of `arr` into `arr[0 .. k)`, the others are left in
+ * `arr[k .. length)` in no particular order. `timNthElement` splits the array at `k`, then
+ * `timSort` sorts the first part: O(n + k log k) work.
+ * @param arr Array to partially sort
+ * @param length The legth of `arr`
+ * @param k number of elements to sort, the whole array is sorted if it is `length` or more
+ */
+void timPartialSort(int arr[], size_t length, size_t k)
+{
+	k = min(k, length);
+
+	if (k < length)
 	{
-		size_t delta = lengthFirstHalf - ix_fst;
-		memcpy(&arr[ix_out], &firstHalf[ix_fst], delta * sizeof(int));
-		ix_out += delta;
-		ix_fst += delta;
+		timNthElement(arr, length, k);
 	}
 
-	if (ix_snd < lengthSecondHalf)
+	timSort(arr, k);
+}
+
+/**
+ * Restores the max-heap order of `heap` below position `ix`.
+ * @param heap binary max-heap, the children of `ix` are `2 ix + 1` and `2 ix + 2`
+ * @param length number of elements of `heap`
+ * @param ix position of the element to move down
+ */
+static void topKSiftDown(int heap[], size_t length, size_t ix)
+{
+	int value = heap[ix];
+
+	for (size_t child = 2 * ix + 1; child < length; child = 2 * ix + 1)
 	{
-		size_t delta = lengthSecondHalf - ix_snd;
-		memcpy(&arr[ix_out], &secondHalf[ix_snd], delta * sizeof(int));
-		ix_out += delta;
-		ix_snd += delta;
+		child += (child + 1 < length) && (heap[child] < heap[child + 1]);
+
+		if (heap[child] <= value)
+		{
+			break;
+		}
+
+		heap[ix] = heap[child];
+		ix = child;
 	}
 
-	return;
+	heap[ix] = value;
 }
 
 /**
- * Min of two size_t arguments.
- * @param a first value to choose from
- * @param b second value to choose from
- * @return The minimum value between `a` and `b`
+ * Copies the `k` smallest elements of `arr` into `out`, sorted, leaving `arr` untouched. A max-heap
+ * of the `k` smallest elements seen so far is kept in `out`; an element only enters it if it is
+ * below its top, which after the first elements happens to few of them on unordered inputs. The
+ * heap is then sorted with `timSort`. The memory needed is `out` alone, whatever the length of
+ * `arr`.
+ * @param arr elements to select from
+ * @param length The legth of `arr`
+ * @param k number of elements to select, all of `arr` if it is `length` or more
+ * @param out output, receives the `min(k, length)` smallest elements in ascending order
  */
-size_t min(size_t a, size_t b)
+void timTopK(int arr[], size_t length, size_t k, int out[])
 {
-	if (a <= b)
+	k = min(k, length);
+
+	if (0 == k)
 	{
-		return a;
+		return;
 	}
-	else
+
+	memcpy(out, arr, k * sizeof(int));
+
+	for (size_t ix = k / 2; ix > 0; ix--)
 	{
-		return b;
+		topKSiftDown(out, k, ix - 1);
+	}
+
+	for (size_t ix = k; ix < length; ix++)
+	{
+		if (arr[ix] < out[0])
+		{
+			out[0] = arr[ix];
+			topKSiftDown(out, k, 0);
+		}
 	}
+
+	timSort(out, k);
 }
 
 /**
- * Timsort routine for an array of `int`.
- * @param arr Array to sort
- * @param length The legth of `arr`
+ * Stable top-k: positions of the `k` smallest keys, in the order a stable sort of `keys` would
+ * list them, so that equal keys come by position and the keys equal to the `k`-th smallest that do
+ * not fit are the last ones. `timNthElement` on a copy of the keys finds the `k`-th smallest, one
+ * pass collects the positions of the selected keys in order, and the co-sort of `timArgSort`, with
+ * its insertion and merge kernels, orders them: O(n + k log k) work.
+ * @param keys keys to select from, left untouched
+ * @param length The legth of `keys`
+ * @param k number of keys to select, all of them if it is `length` or more
+ * @param order output, receives the positions of the `min(k, length)` smallest keys
  */
-void timSort(int arr[], size_t length)
+void timArgTopK(int keys[], size_t length, size_t k, size_t order[])
 {
-	// insertion sort on `RUN_LENGTH` segments
-	for (size_t i = 0; i < length; i += RUN_LENGTH)
+	k = min(k, length);
+
+	if (0 == k)
 	{
-		insertionSort(arr, i, min((i + RUN_LENGTH), (length - 1)));
+		return;
 	}
-	// Merge window doubles every iteration
-	for (size_t size = RUN_LENGTH; size < length; size *= 2)
+
+	int *selected = malloc(length * sizeof(int));
+	if (NULL == selected)
 	{
-		// Merge
-		for (size_t left = 0; left + size < length; left += 2 * size)
-		{
-			size_t mid = left + size;
-			size_t right = min((left + 2 * size), (length - 1));
+		error("Could not allocate the top-k keys");
+		exit(EXIT_FAILURE);
+	}
+
+	memcpy(selected, keys, length * sizeof(int));
+	timNthElement(selected, length, k - 1);
 
-			merge(arr, left, mid, right);
+	// keys below the k-th smallest are all selected, equal ones until there are k
+	int threshold = selected[k - 1];
+	size_t equal = k;
+	for (size_t ix = 0; ix < k; ix++)
+	{
+		equal -= (selected[ix] < threshold);
+	}
+
+	size_t ix_out = 0;
+	for (size_t ix = 0; ix < length && ix_out < k; ix++)
+	{
+		bool take = (keys[ix] < threshold) || ((keys[ix] == threshold) && (equal > 0));
+
+		if (take)
+		{
+			equal -= (keys[ix] == threshold);
+			selected[ix_out] = keys[ix];
+			order[ix_out++] = ix;
 		}
 	}
+
+	timSort_argsort(selected, order, k);
+
+	free(selected);
 }
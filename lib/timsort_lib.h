@@ -3,8 +3,217 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+#define MAX_PENDING_RUNS 85
+#define NETWORK_MAX_RUN 64
+#define SORTED_CHECK_BLOCK 64
+#define RADIX_MAX_DIGIT_BITS 16
+
+extern const int RUN_LENGTH;
+extern const size_t MIN_GALLOP;
+extern const size_t MERGE_SAMPLE;
+extern const size_t PARALLEL_MIN_CHUNK;
+extern const size_t PROFILE_SAMPLES;
+extern const size_t SELECT_SMALL;
+
+/**
+ * Rules used to pick the pending runs to merge, see `mergeCollapse`.
+ */
+typedef enum merge_policy
+{
+	MERGE_POLICY_BOTTOM_UP,
+	MERGE_POLICY_TIMSORT,
+	MERGE_POLICY_POWERSORT
+} merge_policy_t;
+
+/**
+ * State carried between the merges of a single sort.
+ * - minGallop: number of consecutive wins of a run after which `mergeRuns` starts galloping
+ * - pendingRuns: number of runs on the stack of runs waiting to be merged
+ * - runBase, runLength: position of each pending run in the array being sorted
+ * - runLevel: number of merges that produced each pending run
+ * - runPower: node power of the boundary between each pending run and the next one
+ * - policy, arrayLength: merge policy and length of the array being sorted
+ * - scratch, scratchBytes: merge buffer, holds the shorter run of each merge
+ * - scratchShared: whether `scratch` is the thread's shared buffer, which `ensureScratch` grows
+ */
+typedef struct merge_state
+{
+	size_t minGallop;
+	size_t pendingRuns;
+	size_t runBase[MAX_PENDING_RUNS];
+	size_t runLength[MAX_PENDING_RUNS];
+	size_t runLevel[MAX_PENDING_RUNS];
+	size_t runPower[MAX_PENDING_RUNS];
+	merge_policy_t policy;
+	size_t arrayLength;
+	void *scratch;
+	size_t scratchBytes;
+	bool scratchShared;
+} merge_state_t;
+
+/**
+ * Sorted run merged by `mergeK`: `length` elements starting at `data`.
+ */
+typedef struct sorted_run
+{
+	int *data;
+	size_t length;
+} sorted_run_t;
+
+/**
+ * Callback reading the next elements of an input of `mergeKStream`: fills `buffer` with up to
+ * `capacity` elements and returns how many, 0 once the input is exhausted.
+ */
+typedef size_t (*merge_read_t)(void *context, int buffer[], size_t capacity);
+
+/**
+ * Callback receiving each block of `length` elements of the output of `mergeKStream`.
+ */
+typedef void (*merge_write_t)(void *context, const int buffer[], size_t length);
+
+/**
+ * Input of `mergeKStream`: `read` is called with `context`.
+ */
+typedef struct merge_source
+{
+	merge_read_t read;
+	void *context;
+} merge_source_t;
+
+/**
+ * Presortedness of an array, measured by `sortProfile`.
+ * - length: number of elements
+ * - runs: number of maximal non-descending runs: 1 when sorted, `length` when strictly descending
+ * - longestRun: length of the longest of these runs
+ * - descendingRuns: number of maximal strictly descending stretches of 2 elements or more
+ * - sampledPairs, sampledInversions: number of random pairs compared, and of those out of order
+ * - inversions: number of pairs out of order, estimated from the sampled pairs
+ * - minValue, maxValue: smallest and largest element, 0 for an empty array
+ */
+typedef struct sort_profile
+{
+	size_t length;
+	size_t runs;
+	size_t longestRun;
+	size_t descendingRuns;
+	size_t sampledPairs;
+	size_t sampledInversions;
+	uint64_t inversions;
+	int minValue;
+	int maxValue;
+} sort_profile_t;
+
+/**
+ * Algorithms `timSortAdaptive` picks from, see `timSortChoose`.
+ */
+typedef enum sort_algorithm
+{
+	SORT_ALGORITHM_TIMSORT,
+	SORT_ALGORITHM_COUNTING,
+	SORT_ALGORITHM_RADIX
+} sort_algorithm_t;
+
+/**
+ * Thresholds of `timSortChoose`, set with `timSortSetThresholds`.
+ * - minLength: shorter arrays are left to timsort
+ * - minAverageRun: arrays whose non-descending runs are this long on average are left to timsort,
+ *   which merges the runs
+ * - maxInversionPercent: arrays with less than this percentage of sampled pairs out of order are
+ *   left to timsort, 0 disables the test
+ * - countingMaxRange: arrays spanning at most this many values, and no more than their length, go
+ *   to counting sort
+ * - radixWideLength: arrays of this length or more are radix sorted by 11 bit digits, shorter ones
+ *   by 8 bit digits
+ */
+typedef struct sort_thresholds
+{
+	size_t minLength;
+	size_t minAverageRun;
+	size_t maxInversionPercent;
+	size_t countingMaxRange;
+	size_t radixWideLength;
+} sort_thresholds_t;
+
 bool isSorted(int arr[], size_t length);
 void insertionSort(int arr[], size_t lowerBound, size_t upperBound);
+void binaryInsertionSort(int arr[], size_t lowerBound, size_t start, size_t upperBound);
+void compareExchange(int arr[], size_t first, size_t second);
+void networkSort8(int arr[]);
+void networkSortRun(int arr[], size_t lowerBound, size_t upperBound);
+void timSortSetRunLength(size_t runLength);
+size_t timSortRunLength(size_t length);
+size_t gallopLeft(int key, int arr[], size_t length, size_t hint);
+size_t gallopRight(int key, int arr[], size_t length, size_t hint);
+void ensureScratch(merge_state_t *state, size_t bytes);
+void timSortFreeBuffer(void);
+size_t timSortBufferLength(size_t length);
+bool mergeLooksRandom(int first[], size_t lengthFirst, int second[], size_t lengthSecond);
 void merge(int arr[], size_t lowerBound, size_t midPoint, size_t upperBound);
+void mergeRuns(merge_state_t *state, int arr[], size_t lowerBound, size_t midPoint,
+			   size_t upperBound);
+void mergeLo(merge_state_t *state, int arr[], size_t lowerBound, size_t midPoint,
+			 size_t upperBound);
+void mergeHi(merge_state_t *state, int arr[], size_t lowerBound, size_t midPoint,
+			 size_t upperBound);
 size_t min(size_t a, size_t b);
-void timSort(int arr[], size_t arr_length);
\ No newline at end of file
+void reverseRange(int arr[], size_t lowerBound, size_t upperBound);
+size_t countRunAndMakeAscending(int arr[], size_t lowerBound, size_t upperBound);
+size_t minRunLength(size_t length);
+size_t nodePower(size_t runBase, size_t lengthFirst, size_t lengthSecond, size_t length);
+void timSortSetMergePolicy(merge_policy_t policy);
+void initMergeState(merge_state_t *state, size_t length, void *scratch, size_t scratchBytes);
+void pushRun(merge_state_t *state, size_t runBase, size_t runLength);
+void mergeAt(merge_state_t *state, int arr[], size_t ix);
+void mergeCollapse(merge_state_t *state, int arr[]);
+void mergeForceCollapse(merge_state_t *state, int arr[]);
+void sortRuns(merge_state_t *state, int arr[], size_t length);
+void timSort(int arr[], size_t arr_length);
+bool timSortWithBuffer(int arr[], size_t length, int scratch[], size_t scratchLength);
+bool isSorted_i64(int64_t arr[], size_t length);
+void merge_i64(int64_t arr[], size_t lowerBound, size_t midPoint, size_t upperBound);
+void timSort_i64(int64_t arr[], size_t length);
+bool timSortWithBuffer_i64(int64_t arr[], size_t length, int64_t scratch[], size_t scratchLength);
+
+bool isSorted_u32(uint32_t arr[], size_t length);
+void merge_u32(uint32_t arr[], size_t lowerBound, size_t midPoint, size_t upperBound);
+void timSort_u32(uint32_t arr[], size_t length);
+bool timSortWithBuffer_u32(uint32_t arr[], size_t length, uint32_t scratch[],
+						   size_t scratchLength);
+
+bool isSorted_f32(float arr[], size_t length);
+void merge_f32(float arr[], size_t lowerBound, size_t midPoint, size_t upperBound);
+void timSort_f32(float arr[], size_t length);
+bool timSortWithBuffer_f32(float arr[], size_t length, float scratch[], size_t scratchLength);
+
+bool isSorted_f64(double arr[], size_t length);
+void merge_f64(double arr[], size_t lowerBound, size_t midPoint, size_t upperBound);
+void timSort_f64(double arr[], size_t length);
+bool timSortWithBuffer_f64(double arr[], size_t length, double scratch[], size_t scratchLength);
+
+void timSortKV(int keys[], int values[], size_t length);
+void timArgSort(int keys[], size_t order[], size_t length);
+
+size_t mergeCoRank(size_t rank, int first[], size_t lengthFirst, int second[], size_t lengthSecond);
+void mergeInto(int out[], int first[], size_t lengthFirst, int second[], size_t lengthSecond);
+void *timSortParallelWorker(void *arg);
+void timSortParallel(int arr[], size_t length, size_t nthreads);
+
+void timSortQsort(void *base, size_t nmemb, size_t size, int (*compar)(const void *, const void *));
+
+void mergeK(sorted_run_t runs[], size_t k, int out[]);
+size_t mergeKStream(merge_source_t sources[], size_t k, merge_write_t write, void *writeContext,
+					size_t blockLength);
+
+void sortProfile(int arr[], size_t length, sort_profile_t *profile);
+
+void radixSort(int arr[], size_t length, size_t digitBits);
+void countingSort(int arr[], size_t length, int minValue, int maxValue);
+void timSortSetThresholds(const sort_thresholds_t *thresholds);
+void timSortGetThresholds(sort_thresholds_t *thresholds);
+sort_algorithm_t timSortChoose(const sort_profile_t *profile);
+sort_algorithm_t timSortAdaptive(int arr[], size_t length);
+
+void timNthElement(int arr[], size_t length, size_t nth);
+void timPartialSort(int arr[], size_t length, size_t k);
+void timTopK(int arr[], size_t length, size_t k, int out[]);
+void timArgTopK(int keys[], size_t length, size_t k, size_t order[]);
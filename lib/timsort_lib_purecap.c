@@ -9,6 +9,91 @@
 #include <string.h>
 
 const int RUN_LENGTH = 32;
+const size_t MIN_GALLOP = 7;
+
+// run length set with `timSortSetRunLength`, 0 when runs use `minRunLength`
+static size_t runLengthOverride = 0;
+
+// merge policy set with `timSortSetMergePolicy`
+static merge_policy_t mergePolicy = MERGE_POLICY_POWERSORT;
+
+// bounds mode set with `timSortSetBoundsMode`
+static bounds_mode_t boundsMode = BOUNDS_MODE_HOISTED;
+
+// capability operations counted since the last `timSortResetBoundsStats`
+static bounds_stats_t boundsStats = {0, 0, 0, 0};
+
+/**
+ * `cheri_bounds_set`, counted in `boundsStats`.
+ * @param arr capability to narrow
+ * @param bytes length of the new bounds, starting at the address of `arr`
+ * @return The narrowed capability
+ */
+static int *countedBoundsSet(int *arr, size_t bytes)
+{
+	boundsStats.boundsSet++;
+
+	return cheri_bounds_set(arr, bytes);
+}
+
+/**
+ * `cheri_bounds_set_exact`, counted in `boundsStats`, for the kernels that read their slice back
+ * from the bounds with `cheri_getoffset` / `cheri_getlen`. `cheri_bounds_set` rounds the base down
+ * and the length up once the length is past a few KiB and the base is not aligned enough, which
+ * would shift the offsets and lengths those kernels read; such ranges are not narrowed.
+ * @param arr capability to narrow
+ * @param bytes length of the new bounds, starting at the address of `arr`
+ * @return The narrowed capability, or NULL when the bounds cannot be represented exactly
+ */
+static int *countedBoundsSetExact(int *arr, size_t bytes)
+{
+	if ((0 != (cheri_address_get(arr) & ~cheri_representable_alignment_mask(bytes))) ||
+		(cheri_representable_length(bytes) != bytes))
+	{
+		return NULL;
+	}
+
+	boundsStats.boundsSet++;
+
+	return cheri_bounds_set_exact(arr, bytes);
+}
+
+/**
+ * `cheri_offset_set`, counted in `boundsStats`.
+ * @param arr capability to move
+ * @param bytes new offset, from the base of `arr`
+ * @return The moved capability
+ */
+static int *countedOffsetSet(int *arr, size_t bytes)
+{
+	boundsStats.offsetSet++;
+
+	return cheri_offset_set(arr, bytes);
+}
+
+/**
+ * `cheri_getlen`, counted in `boundsStats`.
+ * @param arr capability to read
+ * @return The length of the bounds of `arr` (unit: bytes)
+ */
+static size_t countedLengthGet(int *arr)
+{
+	boundsStats.lengthGet++;
+
+	return cheri_getlen(arr);
+}
+
+/**
+ * `cheri_getoffset`, counted in `boundsStats`.
+ * @param arr capability to read
+ * @return The offset of `arr` from its base (unit: bytes)
+ */
+static size_t countedOffsetGet(int *arr)
+{
+	boundsStats.offsetGet++;
+
+	return cheri_getoffset(arr);
+}
 
 /**
  * Checks if an array of integers `arr` is sorted in ascending order. Uses capability instructions
@@ -20,7 +105,7 @@ const int RUN_LENGTH = 32;
 bool isSorted(int *arr)
 {
 	assert(cheri_is_valid(arr));
-	size_t length = cheri_getlen(arr) / sizeof(int);
+	size_t length = countedLengthGet(arr) / sizeof(int);
 
 	// short-circuit: empty and singleton arrays are always sorted.
 	// still makes sense in capability land as lengths <= 1024 are exact
@@ -29,7 +114,25 @@ bool isSorted(int *arr)
 		return true;
 	}
 
-	for (size_t ix = 1; ix < length; ix++)
+	// blocks of compares without an early exit, which the compiler can vectorise
+	size_t ix = 1;
+	for (; length - ix >= SORTED_CHECK_BLOCK; ix += SORTED_CHECK_BLOCK)
+	{
+		const int *block = &arr[ix - 1];
+		int descent = 0;
+
+		for (size_t jx = 0; jx < SORTED_CHECK_BLOCK; jx++)
+		{
+			descent |= (block[jx] > block[jx + 1]);
+		}
+
+		if (descent)
+		{
+			return false;
+		}
+	}
+
+	for (; ix < length; ix++)
 	{
 		if (arr[ix - 1] > arr[ix])
 		{
@@ -49,7 +152,7 @@ bool isSorted(int *arr)
 void printArray(int *arr)
 {
 	assert(cheri_is_valid(arr));
-	size_t length = cheri_getlen(arr) / sizeof(int);
+	size_t length = countedLengthGet(arr) / sizeof(int);
 
 	printf("Length: %lu  \n", length);
 
@@ -83,43 +186,271 @@ void printArray(int *arr)
 void insertionSort(int *arr)
 {
 	assert(cheri_is_valid(arr));
-	size_t lowerBound = cheri_getoffset(arr) / sizeof(int);
-	size_t upperBound = (cheri_getlen(arr) / sizeof(int)) - lowerBound;
+	size_t lowerBound = countedOffsetGet(arr) / sizeof(int);
+	size_t upperBound = countedLengthGet(arr) / sizeof(int);
+
+	if (lowerBound + 1 >= upperBound)
+	{
+		return;
+	}
 
 	// reset offset otherwise arr[x] is actually arr[x+offset]
-	arr = cheri_offset_set(arr, 0);
+	arr = countedOffsetSet(arr, 0);
+
+	int *arr_base_length_set =
+		countedBoundsSetExact(&arr[lowerBound], (upperBound - lowerBound) * sizeof(int));
 
-	for (size_t ix = lowerBound + 1; ix < upperBound; ix++)
+	if (NULL == arr_base_length_set)
+	{
+		sliceBinaryInsertionSort(arr, lowerBound, lowerBound + 1, upperBound);
+		return;
+	}
+
+	binaryInsertionSort(countedOffsetSet(arr_base_length_set, sizeof(int)));
+}
+
+/**
+ * Sorts the input array in place, given that it starts with a sorted prefix. Each remaining
+ * element's slot is found with a binary search, to the right of any equal elements so that the
+ * sort is stable, and the elements after the slot are shifted with a single `memmove`.
+ * @param arr array to sort
+ * Capability implicit paramters:
+ * - uses offset to indicate the first element that is not yet sorted (unit: bytes)
+ * - uses length of memory allocation chunk as upper bound (unit: bytes)
+ */
+void binaryInsertionSort(int *arr)
+{
+	assert(cheri_is_valid(arr));
+	size_t start = countedOffsetGet(arr) / sizeof(int);
+	size_t upperBound = countedLengthGet(arr) / sizeof(int);
+
+	// reset offset otherwise arr[x] is actually arr[x+offset]
+	sliceBinaryInsertionSort(countedOffsetSet(arr, 0), 0, start, upperBound);
+}
+
+/**
+ * Slice version of `binaryInsertionSort`: sorts `arr[lowerBound .. upperBound)` in place, given
+ * that `arr[lowerBound .. start)` is already sorted.
+ * @param arr capability to the array holding the slice, its bounds and offset are not read
+ * @param lowerBound lower bound of the slice
+ * @param start first element that is not yet sorted
+ * @param upperBound upper bound of the slice (exclusive)
+ */
+void sliceBinaryInsertionSort(int *arr, size_t lowerBound, size_t start, size_t upperBound)
+{
+	if (lowerBound == start)
+	{
+		start++;
+	}
+
+	for (size_t ix = start; ix < upperBound; ix++)
 	{
 		int ix_value = arr[ix];
-		size_t ixp = ix - 1;
-		bool hitBottom = false;
+		size_t left = lowerBound;
+		size_t count = ix - lowerBound;
 
-		while ((ixp >= lowerBound) && (arr[ixp] > ix_value))
+		// find the first element of arr[lowerBound .. ix) that is larger than `ix_value`; the
+		// halving step compiles to a conditional move, so random input does not mispredict on it
+		while (count > 1)
 		{
-			arr[ixp + 1] = arr[ixp];
+			size_t half = count >> 1;
 
-			if (ixp > 0)
-			{
-				ixp--;
-			}
-			else
-			{
-				arr[ixp] = ix_value;
-				hitBottom = true;
-				break;
-			}
+			left = (ix_value < arr[left + half]) ? left : left + half;
+			count -= half;
 		}
+		left += (arr[left] <= ix_value);
+
+		memmove(&arr[left + 1], &arr[left], (ix - left) * sizeof(int));
+		arr[left] = ix_value;
+	}
+}
 
-		if (!hitBottom)
+/**
+ * Sets the length to which `timSort` extends short natural runs, e.g. to benchmark run lengths
+ * between 32 and 128. The setting is process wide.
+ * @param runLength the run length to use, 0 restores the default of `minRunLength(n)`
+ */
+void timSortSetRunLength(size_t runLength)
+{
+	runLengthOverride = runLength;
+}
+
+/**
+ * Finds the position at which `key` has to be inserted in the sorted array `arr`, to the left of
+ * any element equal to it. The search starts at `hint` and gallops (1, 3, 7, 15 ...) away from it
+ * before finishing with a binary search.
+ * @param key value to look for
+ * @param arr sorted array to search
+ * @param hint index to start the search from
+ * @return The number of elements of `arr` that are strictly smaller than `key`
+ * Capability implicit paramters:
+ * - uses length of memory allocation chunk as upper bound (unit: bytes)
+ */
+size_t gallopLeft(int key, int *arr, size_t hint)
+{
+	assert(cheri_is_valid(arr));
+
+	return sliceGallopLeft(key, arr, 0, countedLengthGet(arr) / sizeof(int), hint);
+}
+
+/**
+ * Slice version of `gallopLeft`: searches the sorted slice `arr[lowerBound .. upperBound)`.
+ * @param key value to look for
+ * @param arr capability to the array holding the slice, its bounds and offset are not read
+ * @param lowerBound lower bound of the slice
+ * @param upperBound upper bound of the slice (exclusive)
+ * @param hint index to start the search from, relative to `lowerBound`
+ * @return The number of elements of the slice that are strictly smaller than `key`
+ */
+size_t sliceGallopLeft(int key, int *arr, size_t lowerBound, size_t upperBound, size_t hint)
+{
+	size_t length = upperBound - lowerBound;
+	assert(hint < length);
+
+	// indices below are relative to the slice; moving the address does not touch the bounds
+	arr = &arr[lowerBound];
+
+	// establish arr[lastOfs] < key <= arr[ofs], with lastOfs == -1 meaning "before the array"
+	size_t lastOfs = 0;
+	size_t ofs = 1;
+
+	if (arr[hint] < key)
+	{
+		// gallop right until arr[hint + lastOfs] < key <= arr[hint + ofs]
+		size_t maxOfs = length - hint;
+		while ((ofs < maxOfs) && (arr[hint + ofs] < key))
 		{
-			arr[ixp + 1] = ix_value;
+			lastOfs = ofs;
+			ofs = (ofs << 1) + 1;
 		}
+		ofs = min(ofs, maxOfs);
+
+		lastOfs += hint + 1;
+		ofs += hint;
 	}
+	else
+	{
+		// gallop left until arr[hint - ofs] < key <= arr[hint - lastOfs]
+		size_t maxOfs = hint + 1;
+		while ((ofs < maxOfs) && (key <= arr[hint - ofs]))
+		{
+			lastOfs = ofs;
+			ofs = (ofs << 1) + 1;
+		}
+		ofs = min(ofs, maxOfs);
+
+		size_t tmp = lastOfs;
+		lastOfs = hint + 1 - ofs;
+		ofs = hint - tmp;
+	}
+
+	// binary search in arr[lastOfs .. ofs]
+	while (lastOfs < ofs)
+	{
+		size_t mid = lastOfs + ((ofs - lastOfs) >> 1);
+
+		if (arr[mid] < key)
+		{
+			lastOfs = mid + 1;
+		}
+		else
+		{
+			ofs = mid;
+		}
+	}
+
+	return ofs;
 }
 
 /**
- * Merges two runs of an array.
+ * Finds the position at which `key` has to be inserted in the sorted array `arr`, to the right of
+ * any element equal to it. See `gallopLeft` for the search strategy.
+ * @param key value to look for
+ * @param arr sorted array to search
+ * @param hint index to start the search from
+ * @return The number of elements of `arr` that are smaller than or equal to `key`
+ * Capability implicit paramters:
+ * - uses length of memory allocation chunk as upper bound (unit: bytes)
+ */
+size_t gallopRight(int key, int *arr, size_t hint)
+{
+	assert(cheri_is_valid(arr));
+
+	return sliceGallopRight(key, arr, 0, countedLengthGet(arr) / sizeof(int), hint);
+}
+
+/**
+ * Slice version of `gallopRight`: searches the sorted slice `arr[lowerBound .. upperBound)`.
+ * @param key value to look for
+ * @param arr capability to the array holding the slice, its bounds and offset are not read
+ * @param lowerBound lower bound of the slice
+ * @param upperBound upper bound of the slice (exclusive)
+ * @param hint index to start the search from, relative to `lowerBound`
+ * @return The number of elements of the slice that are smaller than or equal to `key`
+ */
+size_t sliceGallopRight(int key, int *arr, size_t lowerBound, size_t upperBound, size_t hint)
+{
+	size_t length = upperBound - lowerBound;
+	assert(hint < length);
+
+	// indices below are relative to the slice; moving the address does not touch the bounds
+	arr = &arr[lowerBound];
+
+	// establish arr[lastOfs] <= key < arr[ofs], with lastOfs == -1 meaning "before the array"
+	size_t lastOfs = 0;
+	size_t ofs = 1;
+
+	if (key < arr[hint])
+	{
+		// gallop left until arr[hint - ofs] <= key < arr[hint - lastOfs]
+		size_t maxOfs = hint + 1;
+		while ((ofs < maxOfs) && (key < arr[hint - ofs]))
+		{
+			lastOfs = ofs;
+			ofs = (ofs << 1) + 1;
+		}
+		ofs = min(ofs, maxOfs);
+
+		size_t tmp = lastOfs;
+		lastOfs = hint + 1 - ofs;
+		ofs = hint - tmp;
+	}
+	else
+	{
+		// gallop right until arr[hint + lastOfs] <= key < arr[hint + ofs]
+		size_t maxOfs = length - hint;
+		while ((ofs < maxOfs) && (arr[hint + ofs] <= key))
+		{
+			lastOfs = ofs;
+			ofs = (ofs << 1) + 1;
+		}
+		ofs = min(ofs, maxOfs);
+
+		lastOfs += hint + 1;
+		ofs += hint;
+	}
+
+	// binary search in arr[lastOfs .. ofs]
+	while (lastOfs < ofs)
+	{
+		size_t mid = lastOfs + ((ofs - lastOfs) >> 1);
+
+		if (key < arr[mid])
+		{
+			ofs = mid;
+		}
+		else
+		{
+			lastOfs = mid + 1;
+		}
+	}
+
+	return ofs;
+}
+
+/**
+ * Merges two runs of an array, using a fresh galloping state and a workspace allocated for this
+ * merge.
  * @param arr super-array to merge
  * Capability implicit paramters:
  * - uses offset to indicate the end of the first leg to merge (unit: bytes)
@@ -127,38 +458,168 @@ void insertionSort(int *arr)
  */
 void merge(int *arr)
 {
+	size_t length = countedLengthGet(arr) / sizeof(int);
+
+	if (length < 2)
+	{
+		return;
+	}
+
+	int *region = malloc(timSortWorkspaceBytes(length));
+	if (NULL == region)
+	{
+		error("Could not allocate the merge workspace");
+		exit(EXIT_FAILURE);
+	}
+
+	workspace_t workspace;
+	workspaceInit(&workspace, region);
+
+	merge_state_t state = {.minGallop = MIN_GALLOP, .pendingRuns = 0, .workspace = &workspace};
 
-	// allocations
-	size_t lengthFirstHalf = cheri_getoffset(arr) / sizeof(int);
-	size_t lengthSecondHalf = (cheri_getlen(arr) / sizeof(int)) - lengthFirstHalf;
+	mergeRuns(&state, arr);
+
+	free(region);
+}
+
+/**
+ * Merges two runs of an array.
+ *
+ * Elements are taken one at a time until one of the runs wins `minGallop` times in a row. The
+ * merge then switches to galloping: it searches the winning run for the next element of the
+ * other run and moves the whole block at once. `minGallop` is lowered while galloping pays off
+ * and raised when it does not, and is carried over between merges in `state`.
+ * @param state galloping state shared by the merges of one sort
+ * @param arr super-array to merge
+ * Capability implicit paramters:
+ * - uses offset to indicate the end of the first leg to merge (unit: bytes)
+ * - uses length of memory allocation as end of sencond leg to merge (unit: bytes)
+ */
+void mergeRuns(merge_state_t *state, int *arr)
+{
+	assert(cheri_is_valid(arr));
+	size_t midPoint = countedOffsetGet(arr) / sizeof(int);
+	size_t upperBound = countedLengthGet(arr) / sizeof(int);
 
 	// reset offset otherwise arr[x] is actually arr[x+offset]
-	arr = cheri_offset_set(arr, 0);
+	sliceMergeRuns(state, countedOffsetSet(arr, 0), 0, midPoint, upperBound);
+}
+
+/**
+ * Slice version of `mergeRuns`: merges the neighbouring sorted slices `arr[lowerBound ..
+ * midPoint)` and `arr[midPoint .. upperBound)`. The slice is described by indices into a single
+ * capability; the only capabilities derived are those of the two scratch copies, taken from the
+ * workspace of `state`.
+ * @param state galloping state shared by the merges of one sort
+ * @param arr capability to the array holding both runs, its bounds and offset are not read
+ * @param lowerBound start of the first run
+ * @param midPoint end of the first run and start of the second one
+ * @param upperBound end of the second run (exclusive)
+ */
+void sliceMergeRuns(merge_state_t *state, int *arr, size_t lowerBound, size_t midPoint,
+					size_t upperBound)
+{
+	if (lowerBound == midPoint || midPoint == upperBound)
+	{
+		return;
+	}
+
+	// elements of the first run that are not larger than the head of the second one are in place
+	lowerBound += sliceGallopRight(arr[midPoint], arr, lowerBound, midPoint, 0);
+	if (lowerBound == midPoint)
+	{
+		return;
+	}
+
+	// elements of the second run that are not smaller than the tail of the first one are in place
+	upperBound = midPoint + sliceGallopLeft(arr[midPoint - 1], arr, midPoint, upperBound,
+											upperBound - midPoint - 1);
 
-	int firstHalf[lengthFirstHalf];
-	int secondHalf[lengthSecondHalf];
+	// allocations, bounded to each run and released when the merge is done
+	size_t lengthFirstHalf = midPoint - lowerBound;
+	size_t lengthSecondHalf = upperBound - midPoint;
+	workspace_t *workspace = state->workspace;
+	size_t mark = workspace->used;
+
+	int *firstHalf = workspaceAlloc(workspace, lengthFirstHalf);
+	int *secondHalf = workspaceAlloc(workspace, lengthSecondHalf);
+	assert(NULL != firstHalf && NULL != secondHalf);
 
 	// copy to intermediate storage
-	memcpy(firstHalf, &arr[0], lengthFirstHalf * sizeof(int));
-	memcpy(secondHalf, &arr[lengthFirstHalf], lengthSecondHalf * sizeof(int));
+	memcpy(firstHalf, &arr[lowerBound], lengthFirstHalf * sizeof(int));
+	memcpy(secondHalf, &arr[midPoint], lengthSecondHalf * sizeof(int));
 
 	// merge intermediate back to output
 	size_t ix_fst = 0;
 	size_t ix_snd = 0;
-	size_t ix_out = 0;
+	size_t ix_out = lowerBound;
+	size_t minGallop = state->minGallop;
+
 	while ((ix_fst < lengthFirstHalf) && (ix_snd < lengthSecondHalf))
 	{
+		size_t winsFst = 0;
+		size_t winsSnd = 0;
 
-		if (firstHalf[ix_fst] <= secondHalf[ix_snd])
+		// one element at a time, until one run keeps winning
+		while ((ix_fst < lengthFirstHalf) && (ix_snd < lengthSecondHalf) &&
+			   (winsFst < minGallop) && (winsSnd < minGallop))
 		{
-			arr[ix_out++] = firstHalf[ix_fst++];
+			if (firstHalf[ix_fst] <= secondHalf[ix_snd])
+			{
+				arr[ix_out++] = firstHalf[ix_fst++];
+				winsFst++;
+				winsSnd = 0;
+			}
+			else
+			{
+				arr[ix_out++] = secondHalf[ix_snd++];
+				winsSnd++;
+				winsFst = 0;
+			}
 		}
-		else
+
+		// gallop, until neither run wins a long enough block
+		while ((ix_fst < lengthFirstHalf) && (ix_snd < lengthSecondHalf))
 		{
-			arr[ix_out++] = secondHalf[ix_snd++];
+			winsFst = sliceGallopRight(secondHalf[ix_snd], firstHalf, ix_fst, lengthFirstHalf, 0);
+			memcpy(&arr[ix_out], &firstHalf[ix_fst], winsFst * sizeof(int));
+			ix_out += winsFst;
+			ix_fst += winsFst;
+
+			if (ix_fst == lengthFirstHalf)
+			{
+				break;
+			}
+
+			winsSnd = sliceGallopLeft(firstHalf[ix_fst], secondHalf, ix_snd, lengthSecondHalf, 0);
+			memcpy(&arr[ix_out], &secondHalf[ix_snd], winsSnd * sizeof(int));
+			ix_out += winsSnd;
+			ix_snd += winsSnd;
+
+			if (ix_snd == lengthSecondHalf)
+			{
+				break;
+			}
+
+			// both heads are now known to belong next: firstHalf[ix_fst] <= secondHalf[ix_snd]
+			arr[ix_out++] = firstHalf[ix_fst++];
+
+			if ((winsFst < MIN_GALLOP) && (winsSnd < MIN_GALLOP))
+			{
+				// galloping stopped paying off, make it harder to re-enter
+				minGallop += 2;
+				break;
+			}
+
+			if (minGallop > 1)
+			{
+				minGallop--;
+			}
 		}
 	}
 
+	state->minGallop = minGallop;
+
 	// copy straglers
 	if (ix_fst < lengthFirstHalf)
 	{
@@ -176,6 +637,8 @@ void merge(int *arr)
 		ix_snd += delta;
 	}
 
+	workspace->used = mark;
+
 	return;
 }
 
@@ -198,39 +661,531 @@ size_t min(size_t a, size_t b)
 }
 
 /**
- * Timsort routine for an array of `int`.
- * @param arr Array to sort
+ * Reverses an array in place.
+ * @param arr array to reverse
  * Capability implicit paramters:
- * - uses length of memory allocation chunk: n = cheri_getlen(arr) / sizeof(int)
+ * - uses length of memory allocation chunk as upper bound (unit: bytes)
  */
-void timSort(int *arr)
+void reverseRange(int *arr)
 {
-	size_t length = cheri_getlen(arr) / sizeof(int);
+	assert(cheri_is_valid(arr));
+
+	sliceReverseRange(arr, 0, countedLengthGet(arr) / sizeof(int));
+}
 
-	// insertion sort on `RUN_LENGTH` segments
-	for (size_t ix = 0; ix < length; ix += RUN_LENGTH)
+/**
+ * Slice version of `reverseRange`: reverses `arr[lowerBound .. upperBound)` in place.
+ * @param arr capability to the array holding the slice, its bounds and offset are not read
+ * @param lowerBound lower bound of the slice
+ * @param upperBound upper bound of the slice (exclusive)
+ */
+void sliceReverseRange(int *arr, size_t lowerBound, size_t upperBound)
+{
+	while (lowerBound + 1 < upperBound)
 	{
-		size_t min_offset = min((ix + RUN_LENGTH), (length - 1));
+		int tmp = arr[lowerBound];
+		arr[lowerBound++] = arr[--upperBound];
+		arr[upperBound] = tmp;
+	}
+}
+
+/**
+ * Finds the natural run at the start of `arr`. A run is either non-descending or strictly
+ * descending; strictly descending runs are reversed in place so that every run is returned in
+ * ascending order. Equal elements never make a run descending, which keeps the sort stable.
+ * @param arr array to scan
+ * @return The length of the run
+ * Capability implicit paramters:
+ * - uses length of memory allocation chunk as upper bound of the scan (unit: bytes)
+ */
+size_t countRunAndMakeAscending(int *arr)
+{
+	assert(cheri_is_valid(arr));
 
-		int *arr_base_length_set = cheri_bounds_set(&arr[ix], (min_offset - ix) * sizeof(int));
-		arr_base_length_set = cheri_offset_set(arr, ix * sizeof(int));
+	return sliceCountRunAndMakeAscending(arr, 0, countedLengthGet(arr) / sizeof(int));
+}
 
-		insertionSort(arr_base_length_set);
+/**
+ * Slice version of `countRunAndMakeAscending`: finds the natural run starting at `lowerBound`,
+ * without going past `upperBound`.
+ * @param arr capability to the array holding the slice, its bounds and offset are not read
+ * @param lowerBound start of the scan
+ * @param upperBound upper bound of the scan (exclusive)
+ * @return The length of the run
+ */
+size_t sliceCountRunAndMakeAscending(int *arr, size_t lowerBound, size_t upperBound)
+{
+	size_t runEnd = lowerBound + 1;
+
+	if (runEnd >= upperBound)
+	{
+		return upperBound - lowerBound;
 	}
 
-	// Merge window doubles every iteration
-	for (size_t size = RUN_LENGTH; size < length; size *= 2)
+	if (arr[runEnd++] < arr[lowerBound])
 	{
-		// Merge
-		for (size_t left = 0; left + size < length; left += 2 * size)
+		while ((runEnd < upperBound) && (arr[runEnd] < arr[runEnd - 1]))
 		{
-			size_t mid = left + size;
-			size_t right = min((left + 2 * size), (length - 1));
+			runEnd++;
+		}
+		sliceReverseRange(arr, lowerBound, runEnd);
+	}
+	else
+	{
+		while ((runEnd < upperBound) && (arr[runEnd - 1] <= arr[runEnd]))
+		{
+			runEnd++;
+		}
+	}
+
+	return runEnd - lowerBound;
+}
 
-			int *arr_base_length_set = cheri_bounds_set(&arr[left], (right - left) * sizeof(int));
-			arr_base_length_set = cheri_offset_set(arr_base_length_set, (mid - left) * sizeof(int));
+/**
+ * Computes the minimum run length for an array of `length` elements. Short natural runs are
+ * extended to this length with insertion sort. The result lies in [RUN_LENGTH, 2 * RUN_LENGTH]
+ * and is chosen so that `length / minRun` is equal to, or slightly less than, a power of two,
+ * which keeps the merges balanced. Arrays shorter than `2 * RUN_LENGTH` are a single run.
+ * @param length The legth of the array to sort
+ * @return The minimum run length
+ */
+size_t minRunLength(size_t length)
+{
+	// becomes 1 if any bit shifted off is set
+	size_t remainder = 0;
+
+	while (length >= 2 * (size_t)RUN_LENGTH)
+	{
+		remainder |= length & 1;
+		length >>= 1;
+	}
 
-			merge(arr_base_length_set);
+	return length + remainder;
+}
+
+/**
+ * Computes the powersort node power of the boundary between the neighbouring runs
+ * `[runBase, runBase + lengthFirst)` and `[runBase + lengthFirst, ... + lengthSecond)` of an array
+ * of `length` elements: the depth, in a perfectly balanced merge tree over [0, 1), of the node
+ * that separates the midpoints of the two runs. Computed by long division on the doubled
+ * midpoints, one quotient bit per iteration.
+ * @param runBase start of the first run
+ * @param lengthFirst length of the first run
+ * @param lengthSecond length of the second run
+ * @param length The legth of the array being sorted
+ * @return The node power, at least 1
+ */
+size_t nodePower(size_t runBase, size_t lengthFirst, size_t lengthSecond, size_t length)
+{
+	size_t power = 0;
+
+	// twice the midpoints of both runs, as fractions of `length`
+	size_t midFirst = 2 * runBase + lengthFirst;
+	size_t midSecond = midFirst + lengthFirst + lengthSecond;
+
+	while (true)
+	{
+		power++;
+
+		if (midFirst >= length)
+		{
+			// both quotient bits are 1
+			midFirst -= length;
+			midSecond -= length;
 		}
+		else if (midSecond >= length)
+		{
+			// the midpoints fall on either side of this node
+			break;
+		}
+
+		midFirst <<= 1;
+		midSecond <<= 1;
 	}
+
+	return power;
+}
+
+/**
+ * Selects how `timSort` decides which pending runs to merge. The setting is process wide.
+ * - MERGE_POLICY_BOTTOM_UP: merge neighbours holding the same number of natural runs
+ * - MERGE_POLICY_TIMSORT: keep run lengths growing faster than Fibonacci down the stack
+ * - MERGE_POLICY_POWERSORT: merge along a nearly optimal tree given by `nodePower` (default)
+ * @param policy the merge policy to use
+ */
+void timSortSetMergePolicy(merge_policy_t policy)
+{
+	mergePolicy = policy;
+}
+
+/**
+ * Pushes the run `arr[runBase .. runBase + runLength)` on the pending run stack of `state`.
+ * @param state merge state of the current sort
+ * @param runBase start of the run
+ * @param runLength length of the run
+ */
+void pushRun(merge_state_t *state, size_t runBase, size_t runLength)
+{
+	assert(state->pendingRuns < MAX_PENDING_RUNS);
+
+	state->runBase[state->pendingRuns] = runBase;
+	state->runLength[state->pendingRuns] = runLength;
+	state->runLevel[state->pendingRuns] = 0;
+	state->runPower[state->pendingRuns] = 0;
+	state->pendingRuns++;
+}
+
+/**
+ * Merges the pending runs `ix` and `ix + 1` of `state`, which are neighbours in the array.
+ * @param state merge state of the current sort
+ * @param arr array being sorted
+ * @param ix position of the first run on the pending run stack
+ */
+void mergeAt(merge_state_t *state, int *arr, size_t ix)
+{
+	assert(ix + 1 < state->pendingRuns);
+
+	size_t lowerBound = state->runBase[ix];
+	size_t midPoint = state->runBase[ix + 1];
+	size_t upperBound = midPoint + state->runLength[ix + 1];
+
+	int *arr_base_length_set =
+		(BOUNDS_MODE_HOISTED == state->boundsMode)
+			? NULL
+			: countedBoundsSetExact(&arr[lowerBound], (upperBound - lowerBound) * sizeof(int));
+
+	if (NULL == arr_base_length_set)
+	{
+		// the narrowed capability is the only one derived for this merge; its bounds may be
+		// rounded, so the runs are passed as indices from its address
+		sliceMergeRuns(state,
+					   countedBoundsSet(&arr[lowerBound], (upperBound - lowerBound) * sizeof(int)),
+					   0, midPoint - lowerBound, upperBound - lowerBound);
+	}
+	else
+	{
+		arr_base_length_set =
+			countedOffsetSet(arr_base_length_set, (midPoint - lowerBound) * sizeof(int));
+
+		mergeRuns(state, arr_base_length_set);
+	}
+
+	state->runLength[ix] += state->runLength[ix + 1];
+	state->runLevel[ix]++;
+	state->runPower[ix] = state->runPower[ix + 1];
+
+	// the run above the merged pair, if any, moves down
+	if (ix + 2 < state->pendingRuns)
+	{
+		state->runBase[ix + 1] = state->runBase[ix + 2];
+		state->runLength[ix + 1] = state->runLength[ix + 2];
+		state->runLevel[ix + 1] = state->runLevel[ix + 2];
+		state->runPower[ix + 1] = state->runPower[ix + 2];
+	}
+
+	state->pendingRuns--;
+}
+
+/**
+ * Merges pending runs until the invariants of the merge policy of `state` hold again, after a
+ * run has been pushed.
+ * - bottom-up: two neighbouring runs are merged as soon as they hold the same number of natural
+ *   runs, like the carries of a binary counter. This is the fixed-width doubling of a bottom-up
+ *   merge sort, applied to natural runs of uneven length.
+ * - timsort: going down the stack, every run is longer than the two above it combined, and every
+ *   run is longer than the one above it.
+ * - powersort: the node powers of the boundaries between pending runs increase up the stack. The
+ *   runs below a boundary with a higher power than the new one are merged first, so merges follow
+ *   a balanced tree and recently found runs are merged while they are still in cache.
+ * @param state merge state of the current sort
+ * @param arr array being sorted
+ */
+void mergeCollapse(merge_state_t *state, int *arr)
+{
+	switch (state->policy)
+	{
+	case MERGE_POLICY_BOTTOM_UP:
+		while ((state->pendingRuns >= 2) && (state->runLevel[state->pendingRuns - 2] ==
+											 state->runLevel[state->pendingRuns - 1]))
+		{
+			mergeAt(state, arr, state->pendingRuns - 2);
+		}
+		break;
+
+	case MERGE_POLICY_TIMSORT:
+		while (state->pendingRuns >= 2)
+		{
+			size_t ix = state->pendingRuns - 2;
+			size_t *runLength = state->runLength;
+
+			if (((ix >= 1) && (runLength[ix - 1] <= runLength[ix] + runLength[ix + 1])) ||
+				((ix >= 2) && (runLength[ix - 2] <= runLength[ix - 1] + runLength[ix])))
+			{
+				// merge the middle run with the shorter of its neighbours
+				if (runLength[ix - 1] < runLength[ix + 1])
+				{
+					ix--;
+				}
+			}
+			else if (runLength[ix] > runLength[ix + 1])
+			{
+				break;
+			}
+
+			mergeAt(state, arr, ix);
+		}
+		break;
+
+	case MERGE_POLICY_POWERSORT:
+		if (state->pendingRuns >= 2)
+		{
+			size_t top = state->pendingRuns - 1;
+			size_t power = nodePower(state->runBase[top - 1], state->runLength[top - 1],
+									 state->runLength[top], state->arrayLength);
+
+			while ((state->pendingRuns >= 3) && (state->runPower[state->pendingRuns - 3] > power))
+			{
+				mergeAt(state, arr, state->pendingRuns - 3);
+			}
+
+			state->runPower[state->pendingRuns - 2] = power;
+		}
+		break;
+	}
+}
+
+/**
+ * Merges all pending runs, leaving a single sorted run. The middle run of the top three is merged
+ * with the shorter of its neighbours, which keeps merges balanced for every policy.
+ * @param state merge state of the current sort
+ * @param arr array being sorted
+ */
+void mergeForceCollapse(merge_state_t *state, int *arr)
+{
+	while (state->pendingRuns >= 2)
+	{
+		size_t ix = state->pendingRuns - 2;
+
+		if ((ix >= 1) && (state->runLength[ix - 1] < state->runLength[ix + 1]))
+		{
+			ix--;
+		}
+
+		mergeAt(state, arr, ix);
+	}
+}
+
+/**
+ * Sorts `arr[0 .. length)`, the common part of `timSort` and `timSortWithWorkspace`.
+ *
+ * The array is split into natural runs (descending ones are reversed), runs shorter than
+ * `minRunLength(n)` are extended with insertion sort and the runs are then merged. Sorted,
+ * reversed and nearly sorted inputs are handled in O(n). How runs are handed to the kernels
+ * depends on `timSortSetBoundsMode`.
+ * @param arr Array to sort
+ * @param length The legth of `arr`
+ * @param workspace scratch region of the merges, of at least `timSortWorkspaceBytes(length)`
+ */
+void sortRuns(int *arr, size_t length, workspace_t *workspace)
+{
+	merge_state_t state = {.minGallop = MIN_GALLOP,
+						   .pendingRuns = 0,
+						   .policy = mergePolicy,
+						   .arrayLength = length,
+						   .boundsMode = boundsMode,
+						   .workspace = workspace};
+	size_t minRun = (0 != runLengthOverride) ? runLengthOverride : minRunLength(length);
+	size_t lowerBound = 0;
+	bool hoisted = (BOUNDS_MODE_HOISTED == state.boundsMode);
+
+	while (lowerBound < length)
+	{
+		int *arr_remaining =
+			hoisted ? NULL
+					: countedBoundsSetExact(&arr[lowerBound], (length - lowerBound) * sizeof(int));
+		size_t upperBound =
+			lowerBound + ((NULL == arr_remaining)
+							  ? sliceCountRunAndMakeAscending(arr, lowerBound, length)
+							  : countRunAndMakeAscending(arr_remaining));
+
+		// extend short runs to `minRun` elements
+		if (upperBound - lowerBound < minRun)
+		{
+			size_t runLength = upperBound - lowerBound;
+
+			upperBound = min(lowerBound + minRun, length);
+
+			int *arr_base_length_set =
+				hoisted ? NULL
+						: countedBoundsSetExact(&arr[lowerBound],
+												(upperBound - lowerBound) * sizeof(int));
+
+			if (NULL == arr_base_length_set)
+			{
+				sliceBinaryInsertionSort(arr, lowerBound, lowerBound + runLength, upperBound);
+			}
+			else
+			{
+				binaryInsertionSort(
+					countedOffsetSet(arr_base_length_set, runLength * sizeof(int)));
+			}
+		}
+
+		pushRun(&state, lowerBound, upperBound - lowerBound);
+		mergeCollapse(&state, arr);
+
+		lowerBound = upperBound;
+	}
+
+	mergeForceCollapse(&state, arr);
+}
+
+/**
+ * Timsort routine for an array of `int`. The merges take their scratch copies from a workspace
+ * allocated on the heap for this sort, so that the stack does not limit the length of `arr`.
+ * @param arr Array to sort
+ * Capability implicit paramters:
+ * - uses length of memory allocation chunk: n = cheri_getlen(arr) / sizeof(int)
+ */
+void timSort(int *arr)
+{
+	size_t length = countedLengthGet(arr) / sizeof(int);
+
+	if (length < 2)
+	{
+		return;
+	}
+
+	int *region = malloc(timSortWorkspaceBytes(length));
+	if (NULL == region)
+	{
+		error("Could not allocate the merge workspace");
+		exit(EXIT_FAILURE);
+	}
+
+	workspace_t workspace;
+	workspaceInit(&workspace, region);
+
+	sortRuns(arr, length, &workspace);
+
+	free(region);
+}
+
+/**
+ * Timsort routine for an array of `int` that merges through a caller-supplied workspace and does
+ * no allocation. One workspace can be reused across any number of calls.
+ * @param arr Array to sort
+ * @param region workspace, of at least `timSortWorkspaceBytes(n)` bytes
+ * @return true on success. false, leaving `arr` untouched, when `region` is too short
+ * Capability implicit paramters:
+ * - uses length of memory allocation chunk: n = cheri_getlen(arr) / sizeof(int)
+ * - uses length of memory allocation chunk of `region` as the size of the workspace
+ */
+bool timSortWithWorkspace(int *arr, int *region)
+{
+	size_t length = countedLengthGet(arr) / sizeof(int);
+	workspace_t workspace;
+	workspaceInit(&workspace, region);
+
+	if (workspace.capacity < timSortWorkspaceBytes(length))
+	{
+		return false;
+	}
+
+	sortRuns(arr, length, &workspace);
+
+	return true;
+}
+
+/**
+ * Selects how `timSort` hands runs to its kernels. The setting is process wide.
+ * - BOUNDS_MODE_PER_CALL: every run and every merge gets a capability narrowed exactly to it,
+ *   from which the kernels read their bounds back with `cheri_getlen` / `cheri_getoffset`; runs
+ *   and merges whose bounds cannot be represented exactly are handed over as slices instead
+ * - BOUNDS_MODE_HOISTED: runs are found and extended through the capability of the whole array,
+ *   and bounds are narrowed once per merge; the kernels then work on `(arr, lowerBound,
+ *   upperBound)` slices (default)
+ * @param mode the bounds mode to use
+ */
+void timSortSetBoundsMode(bounds_mode_t mode)
+{
+	boundsMode = mode;
+}
+
+/**
+ * Reads the number of capability operations performed since the last `timSortResetBoundsStats`.
+ * The counters are process wide, like the settings of the library.
+ * @param stats output, the counters
+ */
+void timSortBoundsStats(bounds_stats_t *stats)
+{
+	*stats = boundsStats;
+}
+
+/**
+ * Resets the counters read by `timSortBoundsStats`.
+ */
+void timSortResetBoundsStats(void)
+{
+	boundsStats = (bounds_stats_t){0, 0, 0, 0};
+}
+
+/**
+ * Number of bytes of workspace `timSortWithWorkspace` needs to sort `length` elements. A merge
+ * copies both of its runs, and `workspaceAlloc` may round each copy up and align it by up to the
+ * alignment needed for exact bounds on the whole array.
+ * @param length The legth of the array to sort
+ * @return The minimum size of the workspace (unit: bytes)
+ */
+size_t timSortWorkspaceBytes(size_t length)
+{
+	size_t bytes = length * sizeof(int);
+
+	return bytes + 4 * ~cheri_representable_alignment_mask(bytes);
+}
+
+/**
+ * Prepares `workspace` to hand out parts of `region`.
+ * @param workspace workspace to set up
+ * @param region scratch region, its offset has to be 0
+ * Capability implicit paramters:
+ * - uses length of memory allocation chunk of `region` as the size of the workspace
+ */
+void workspaceInit(workspace_t *workspace, int *region)
+{
+	assert(cheri_is_valid(region));
+
+	workspace->region = region;
+	workspace->capacity = countedLengthGet(region);
+	workspace->used = 0;
+}
+
+/**
+ * Hands out `length` ints from `workspace` with a bump pointer. The returned capability is
+ * bounded to the ints it hands out, rounded up to the nearest exactly representable length, so
+ * that no two parts of the workspace overlap and overruns still trap. Parts are released by
+ * resetting `workspace->used` to an earlier value.
+ * @param workspace workspace to allocate from
+ * @param length number of ints
+ * @return The bounded capability, NULL when the workspace is exhausted
+ */
+int *workspaceAlloc(workspace_t *workspace, size_t length)
+{
+	size_t bytes = length * sizeof(int);
+	size_t mask = cheri_representable_alignment_mask(bytes);
+	size_t base = cheri_address_get(workspace->region);
+
+	// align the start, so that the bounds are exact
+	size_t start = ((base + workspace->used + ~mask) & mask) - base;
+	size_t end = start + cheri_representable_length(bytes);
+
+	if (end > workspace->capacity)
+	{
+		return NULL;
+	}
+
+	workspace->used = end;
+	boundsStats.boundsSet++;
+
+	return cheri_bounds_set_exact(&workspace->region[start / sizeof(int)], end - start);
 }
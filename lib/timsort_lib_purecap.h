@@ -3,9 +3,116 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+#define MAX_PENDING_RUNS 85
+#define SORTED_CHECK_BLOCK 64
+
+extern const int RUN_LENGTH;
+extern const size_t MIN_GALLOP;
+
+/**
+ * Rules used to pick the pending runs to merge, see `mergeCollapse`.
+ */
+typedef enum merge_policy
+{
+	MERGE_POLICY_BOTTOM_UP,
+	MERGE_POLICY_TIMSORT,
+	MERGE_POLICY_POWERSORT
+} merge_policy_t;
+
+/**
+ * How `timSort` derives the capabilities of the runs it works on, see `timSortSetBoundsMode`.
+ */
+typedef enum bounds_mode
+{
+	BOUNDS_MODE_PER_CALL,
+	BOUNDS_MODE_HOISTED
+} bounds_mode_t;
+
+/**
+ * Number of capability operations performed by the library since the last
+ * `timSortResetBoundsStats`.
+ * - boundsSet: bounds narrowed with `cheri_bounds_set`
+ * - offsetSet: offsets moved with `cheri_offset_set`
+ * - lengthGet, offsetGet: lengths and offsets read back with `cheri_getlen` / `cheri_getoffset`
+ */
+typedef struct bounds_stats
+{
+	size_t boundsSet;
+	size_t offsetSet;
+	size_t lengthGet;
+	size_t offsetGet;
+} bounds_stats_t;
+
+/**
+ * Scratch region handed out to the merges of one sort, see `workspaceAlloc`.
+ * - region: capability to the whole region
+ * - capacity: length of `region` (unit: bytes)
+ * - used: bytes handed out, from the base of `region`
+ */
+typedef struct workspace
+{
+	int *region;
+	size_t capacity;
+	size_t used;
+} workspace_t;
+
+/**
+ * State carried between the merges of a single sort.
+ * - minGallop: number of consecutive wins of a run after which `mergeRuns` starts galloping
+ * - pendingRuns: number of runs on the stack of runs waiting to be merged
+ * - runBase, runLength: position of each pending run in the array being sorted
+ * - runLevel: number of merges that produced each pending run
+ * - runPower: node power of the boundary between each pending run and the next one
+ * - policy, arrayLength: merge policy and length of the array being sorted
+ * - boundsMode: how the runs to merge are handed to `mergeRuns`
+ * - workspace: where the merges copy their runs to
+ */
+typedef struct merge_state
+{
+	size_t minGallop;
+	size_t pendingRuns;
+	size_t runBase[MAX_PENDING_RUNS];
+	size_t runLength[MAX_PENDING_RUNS];
+	size_t runLevel[MAX_PENDING_RUNS];
+	size_t runPower[MAX_PENDING_RUNS];
+	merge_policy_t policy;
+	size_t arrayLength;
+	bounds_mode_t boundsMode;
+	workspace_t *workspace;
+} merge_state_t;
+
 bool isSorted(int *arr);
 void printArray(int *arr);
 void insertionSort(int *arr);
+void binaryInsertionSort(int *arr);
+void sliceBinaryInsertionSort(int *arr, size_t lowerBound, size_t start, size_t upperBound);
+void timSortSetRunLength(size_t runLength);
+size_t gallopLeft(int key, int *arr, size_t hint);
+size_t gallopRight(int key, int *arr, size_t hint);
+size_t sliceGallopLeft(int key, int *arr, size_t lowerBound, size_t upperBound, size_t hint);
+size_t sliceGallopRight(int key, int *arr, size_t lowerBound, size_t upperBound, size_t hint);
 void merge(int *arr);
+void mergeRuns(merge_state_t *state, int *arr);
+void sliceMergeRuns(merge_state_t *state, int *arr, size_t lowerBound, size_t midPoint,
+					size_t upperBound);
 size_t min(size_t a, size_t b);
-void timSort(int *arr);
\ No newline at end of file
+void reverseRange(int *arr);
+void sliceReverseRange(int *arr, size_t lowerBound, size_t upperBound);
+size_t countRunAndMakeAscending(int *arr);
+size_t sliceCountRunAndMakeAscending(int *arr, size_t lowerBound, size_t upperBound);
+size_t minRunLength(size_t length);
+size_t nodePower(size_t runBase, size_t lengthFirst, size_t lengthSecond, size_t length);
+void timSortSetMergePolicy(merge_policy_t policy);
+void pushRun(merge_state_t *state, size_t runBase, size_t runLength);
+void mergeAt(merge_state_t *state, int *arr, size_t ix);
+void mergeCollapse(merge_state_t *state, int *arr);
+void mergeForceCollapse(merge_state_t *state, int *arr);
+void sortRuns(int *arr, size_t length, workspace_t *workspace);
+void timSort(int *arr);
+bool timSortWithWorkspace(int *arr, int *region);
+void timSortSetBoundsMode(bounds_mode_t mode);
+void timSortBoundsStats(bounds_stats_t *stats);
+void timSortResetBoundsStats(void);
+size_t timSortWorkspaceBytes(size_t length);
+void workspaceInit(workspace_t *workspace, int *region);
+int *workspaceAlloc(workspace_t *workspace, size_t length);
@@ -0,0 +1,223 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "timsortdata.h"
+
+#define BENCH_INPUTS 9
+#define BENCH_MAX_REPETITIONS 64
+
+/**
+ * Input of the benchmark: name in the CSV, and distribution and parameter passed to `dataFill`.
+ */
+typedef struct bench_input
+{
+	const char *name;
+	data_distribution_t distribution;
+	size_t param;
+} bench_input_t;
+
+const bench_input_t benchInputs[BENCH_INPUTS] = {{"random", DATA_UNIFORM, 0},
+												 {"sorted", DATA_SORTED, 0},
+												 {"reversed", DATA_REVERSED, 0},
+												 {"sawtooth", DATA_SAWTOOTH, 1024},
+												 {"few-unique", DATA_FEW_DISTINCT, 16},
+												 {"organ-pipe", DATA_ORGAN_PIPE, 0},
+												 {"k-sorted", DATA_K_SORTED, 64},
+												 {"zipf", DATA_ZIPF, 1 << 20},
+												 {"runs", DATA_RUNS, 4096}};
+
+/**
+ * Sort routine under test, with the length passed explicitly whatever the ABI.
+ */
+typedef void (*bench_sort_t)(int arr[], size_t length);
+
+/**
+ * Fills `arr` with benchmark input `input`, on all online processors. The data only depends on
+ * `input` and `length`.
+ * @param arr array to fill
+ * @param length The legth of `arr`
+ * @param input index of the input in `benchInputs`
+ */
+void benchFill(int arr[], size_t length, size_t input)
+{
+	long processors = sysconf(_SC_NPROCESSORS_ONLN);
+
+	dataFillParallel(arr, length, benchInputs[input].distribution, benchInputs[input].param,
+					 DATA_SEED, (processors > 0) ? (size_t)processors : 1);
+}
+
+/**
+ * Monotonic wall clock time.
+ * @return nanoseconds since an arbitrary origin
+ */
+uint64_t benchNanoseconds(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+}
+
+/**
+ * Cycle counter of the calling hart, read with `rdcycle` on RISC-V.
+ * @return cycles since an arbitrary origin, 0 on other architectures
+ */
+uint64_t benchCycles(void)
+{
+#if defined(__riscv)
+	uint64_t cycles;
+	__asm__ volatile("rdcycle %0" : "=r"(cycles));
+
+	return cycles;
+#else
+	return 0;
+#endif
+}
+
+/**
+ * Sorts `count` measurements in place, to pick their median.
+ * @param values measurements
+ * @param count number of measurements
+ */
+void benchSortMeasurements(uint64_t values[], size_t count)
+{
+	for (size_t ix = 1; ix < count; ix++)
+	{
+		uint64_t value = values[ix];
+		size_t jx = ix;
+
+		for (; (jx > 0) && (values[jx - 1] > value); jx--)
+		{
+			values[jx] = values[jx - 1];
+		}
+		values[jx] = value;
+	}
+}
+
+/**
+ * Prints the header line of the CSV written by `benchRun`.
+ */
+void benchHeader(void)
+{
+	printf("abi,algorithm,input,length,repetitions,min_ns,median_ns,min_cycles,"
+		   "median_cycles,ns_per_element\n");
+}
+
+/**
+ * Times `sort` on `arr` and prints one CSV line. Every repetition sorts a fresh copy of `input`,
+ * copied outside of the timed region; one untimed warm-up run comes first.
+ * @param abi name of the ABI the benchmark was built for
+ * @param algorithm name of `sort`
+ * @param inputName name of the input in the CSV
+ * @param sort sort routine under test
+ * @param arr array sorted by `sort`
+ * @param input pristine input, copied to `arr` before each run
+ * @param length The legth of `arr` and `input`
+ * @param repetitions number of timed runs, at most `BENCH_MAX_REPETITIONS`
+ * @return false if a run left `arr` unsorted
+ */
+bool benchRun(const char *abi, const char *algorithm, const char *inputName,
+			  bench_sort_t sort, int arr[], int input[], size_t length, size_t repetitions)
+{
+	uint64_t nanoseconds[BENCH_MAX_REPETITIONS];
+	uint64_t cycles[BENCH_MAX_REPETITIONS];
+	bool sorted = true;
+
+	for (size_t rep = 0; rep <= repetitions; rep++)
+	{
+		memcpy(arr, input, length * sizeof(int));
+
+		uint64_t startNanoseconds = benchNanoseconds();
+		uint64_t startCycles = benchCycles();
+		sort(arr, length);
+		uint64_t endCycles = benchCycles();
+		uint64_t endNanoseconds = benchNanoseconds();
+
+		for (size_t ix = 1; ix < length; ix++)
+		{
+			sorted &= (arr[ix - 1] <= arr[ix]);
+		}
+
+		// run 0 warms up caches, the allocator and the merge buffer
+		if (rep > 0)
+		{
+			nanoseconds[rep - 1] = endNanoseconds - startNanoseconds;
+			cycles[rep - 1] = endCycles - startCycles;
+		}
+	}
+
+	benchSortMeasurements(nanoseconds, repetitions);
+	benchSortMeasurements(cycles, repetitions);
+
+	printf("%s,%s,%s,%zu,%zu,%llu,%llu,%llu,%llu,%.3f\n", abi, algorithm,
+		   inputName, length, repetitions,
+		   (unsigned long long)nanoseconds[0], (unsigned long long)nanoseconds[repetitions / 2],
+		   (unsigned long long)cycles[0], (unsigned long long)cycles[repetitions / 2],
+		   (double)nanoseconds[repetitions / 2] / (double)length);
+	fflush(stdout);
+
+	return sorted;
+}
+
+/**
+ * Comparison function of `qsort` for ints.
+ * @param a first int
+ * @param b second int
+ * @return negative, zero or positive as `*a` is smaller than, equal to or larger than `*b`
+ */
+int benchCompareInts(const void *a, const void *b)
+{
+	int first = *(const int *)a;
+	int second = *(const int *)b;
+
+	return (first > second) - (first < second);
+}
+
+/**
+ * libc `qsort` of an int array, the baseline of the benchmark.
+ * @param arr Array to sort
+ * @param length The legth of `arr`
+ */
+void benchQsort(int arr[], size_t length)
+{
+	qsort(arr, length, sizeof(int), benchCompareInts);
+}
+
+/**
+ * Parses the command line shared by the benchmark programs: `[maxLength [repetitions]]`.
+ * @param argc argument count
+ * @param argv arguments
+ * @param maxLength output, largest length to benchmark, 64M elements by default
+ * @param repetitions output, timed runs per measurement, 5 by default
+ * @return false, after printing the usage, on invalid arguments
+ */
+bool benchParseArgs(int argc, char *argv[], size_t *maxLength, size_t *repetitions)
+{
+	*maxLength = (size_t)64 << 20;
+	*repetitions = 5;
+
+	if (argc > 1)
+	{
+		*maxLength = strtoull(argv[1], NULL, 0);
+	}
+
+	if (argc > 2)
+	{
+		*repetitions = strtoull(argv[2], NULL, 0);
+	}
+
+	if ((argc > 3) || (*maxLength < 1024) || (0 == *repetitions) ||
+		(*repetitions > BENCH_MAX_REPETITIONS))
+	{
+		fprintf(stderr, "usage: %s [maxLength >= 1024 [repetitions 1 .. %d]]\n", argv[0],
+				BENCH_MAX_REPETITIONS);
+		return false;
+	}
+
+	return true;
+}
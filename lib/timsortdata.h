@@ -1,17 +1,336 @@
-#include <cheriintrin.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
-#include <time.h>
 
-int *random_chunk(size_t arr_length)
+// elements generated from each random stream, see `dataFill`
+#define DATA_BLOCK_LENGTH 65536
+
+// seed of the example programs
+#define DATA_SEED 0x5EED
+
+/**
+ * Shapes of the data produced by `dataFill`. `param` is the parameter passed along with them, at
+ * most 2^30.
+ * - DATA_UNIFORM: uniform over all ints
+ * - DATA_SORTED, DATA_REVERSED: 0, 1, 2 ... ascending or descending
+ * - DATA_K_SORTED: ascending, but every element is up to `param` positions away from its place
+ * - DATA_ZIPF: Zipf-like over `param` values, value `r` about as likely as 1 / (r + 1)
+ * - DATA_FEW_DISTINCT: `param` distinct values, in random order
+ * - DATA_RUNS: ascending runs of `param` elements, each starting at a random value
+ * - DATA_SAWTOOTH: 0, 1 ... `param` - 1, repeated
+ * - DATA_ORGAN_PIPE: ascending up to the middle of the array, then descending
+ */
+typedef enum data_distribution
+{
+	DATA_UNIFORM,
+	DATA_SORTED,
+	DATA_REVERSED,
+	DATA_K_SORTED,
+	DATA_ZIPF,
+	DATA_FEW_DISTINCT,
+	DATA_RUNS,
+	DATA_SAWTOOTH,
+	DATA_ORGAN_PIPE
+} data_distribution_t;
+
+/**
+ * State of a xoshiro256** generator.
+ */
+typedef struct xoshiro
+{
+	uint64_t s[4];
+} xoshiro_t;
+
+/**
+ * splitmix64 finaliser: maps consecutive integers to well mixed, independent looking values.
+ * @param x value to mix
+ * @return mixed value
+ */
+uint64_t splitMix64(uint64_t x)
+{
+	x += 0x9E3779B97F4A7C15ULL;
+	x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+
+	return x ^ (x >> 31);
+}
+
+/**
+ * Seeds `rng` from a 64 bit seed, expanded with `splitMix64`.
+ * @param rng generator to seed
+ * @param seed seed, any value
+ */
+void xoshiroSeed(xoshiro_t *rng, uint64_t seed)
+{
+	for (size_t ix = 0; ix < 4; ix++)
+	{
+		seed = splitMix64(seed);
+		rng->s[ix] = seed;
+	}
+}
+
+/**
+ * Next output of a xoshiro256** generator.
+ * @param rng generator state
+ * @return 64 pseudo-random bits
+ */
+uint64_t xoshiroNext(xoshiro_t *rng)
+{
+	uint64_t *s = rng->s;
+	uint64_t result = s[1] * 5;
+	result = ((result << 7) | (result >> 57)) * 9;
+
+	uint64_t t = s[1] << 17;
+	s[2] ^= s[0];
+	s[3] ^= s[1];
+	s[1] ^= s[2];
+	s[0] ^= s[3];
+	s[2] ^= t;
+	s[3] = (s[3] << 45) | (s[3] >> 19);
+
+	return result;
+}
+
+/**
+ * Uniform value in [0, bound), by Lemire's multiply and shift; the bias is below 2^-32 for the
+ * bounds used here.
+ * @param rng generator state
+ * @param bound exclusive upper bound, at most 2^32
+ * @return value in [0, bound)
+ */
+uint64_t xoshiroBelow(xoshiro_t *rng, uint64_t bound)
+{
+	return ((xoshiroNext(rng) >> 32) * bound) >> 32;
+}
+
+/**
+ * Fills `arr[lowerBound .. upperBound)`, which lies within one block of `DATA_BLOCK_LENGTH`
+ * elements, with its part of the data described by `dataFill`.
+ * @param arr array being filled
+ * @param length The legth of `arr`
+ * @param lowerBound lower bound
+ * @param upperBound upper bound (exclusive)
+ * @param distribution shape of the data
+ * @param param parameter of the distribution
+ * @param seed seed of the whole array
+ */
+void dataFillBlock(int arr[], size_t length, size_t lowerBound, size_t upperBound,
+				   data_distribution_t distribution, size_t param, uint64_t seed)
+{
+	xoshiro_t rng;
+	xoshiroSeed(&rng, seed ^ splitMix64(lowerBound / DATA_BLOCK_LENGTH));
+
+	// degenerate parameters behave as 1
+	param = (0 == param) ? 1 : param;
+
+	switch (distribution)
+	{
+	case DATA_UNIFORM:
+		for (size_t ix = lowerBound; ix < upperBound; ix++)
+		{
+			arr[ix] = (int)xoshiroNext(&rng);
+		}
+		break;
+
+	case DATA_SORTED:
+		for (size_t ix = lowerBound; ix < upperBound; ix++)
+		{
+			arr[ix] = (int)ix;
+		}
+		break;
+
+	case DATA_REVERSED:
+		for (size_t ix = lowerBound; ix < upperBound; ix++)
+		{
+			arr[ix] = (int)(length - ix);
+		}
+		break;
+
+	case DATA_K_SORTED:
+		// random offsets in [0, param) move each element by less than `param` positions
+		for (size_t ix = lowerBound; ix < upperBound; ix++)
+		{
+			arr[ix] = (int)(ix + xoshiroBelow(&rng, param));
+		}
+		break;
+
+	case DATA_ZIPF:
+		// pick a power of two range uniformly, then a value uniformly in it: log-uniform, which
+		// approximates Zipf with exponent 1 without floating point
+		for (size_t ix = lowerBound; ix < upperBound; ix++)
+		{
+			uint64_t bits = xoshiroNext(&rng);
+			size_t range = (size_t)1 << ((bits >> 32) % (64 - __builtin_clzll(param)));
+			size_t value = range - 1 + ((bits & 0xFFFFFFFFULL) * range >> 32);
+
+			arr[ix] = (int)((value < param) ? value : param - 1);
+		}
+		break;
+
+	case DATA_FEW_DISTINCT:
+		for (size_t ix = lowerBound; ix < upperBound; ix++)
+		{
+			arr[ix] = (int)xoshiroBelow(&rng, param);
+		}
+		break;
+
+	case DATA_RUNS:
+		// the start of each run only depends on its index, wherever the blocks split the runs
+		for (size_t ix = lowerBound; ix < upperBound; ix++)
+		{
+			arr[ix] = (int)(splitMix64(seed + ix / param) >> 34) + (int)(ix % param);
+		}
+		break;
+
+	case DATA_SAWTOOTH:
+		for (size_t ix = lowerBound; ix < upperBound; ix++)
+		{
+			arr[ix] = (int)(ix % param);
+		}
+		break;
+
+	case DATA_ORGAN_PIPE:
+		for (size_t ix = lowerBound; ix < upperBound; ix++)
+		{
+			arr[ix] = (int)((ix < length / 2) ? ix : length - ix);
+		}
+		break;
+	}
+}
+
+/**
+ * Fills `arr` with reproducible data of the given distribution. Every block of
+ * `DATA_BLOCK_LENGTH` elements is drawn from its own xoshiro256** stream, seeded from `seed` and
+ * the block index, so the data only depends on `seed` and not on how the blocks are shared out;
+ * see `dataFillParallel`.
+ * @param arr array to fill
+ * @param length The legth of `arr`
+ * @param distribution shape of the data
+ * @param param parameter of the distribution, see `data_distribution_t`
+ * @param seed seed, the same seed gives the same data
+ */
+void dataFill(int arr[], size_t length, data_distribution_t distribution, size_t param,
+			  uint64_t seed)
 {
+	for (size_t lowerBound = 0; lowerBound < length; lowerBound += DATA_BLOCK_LENGTH)
+	{
+		size_t upperBound =
+			(length - lowerBound < DATA_BLOCK_LENGTH) ? length : lowerBound + DATA_BLOCK_LENGTH;
 
-	srand(time(NULL));
+		dataFillBlock(arr, length, lowerBound, upperBound, distribution, param, seed);
+	}
+}
+
+/**
+ * Work of one thread of `dataFillParallel`.
+ * - arr, length, distribution, param, seed: as passed to `dataFillParallel`
+ * - id, threads: index of the thread and number of threads, thread `id` fills blocks `id`,
+ *   `id + threads` ...
+ */
+typedef struct data_fill
+{
+	int *arr;
+	size_t length;
+	data_distribution_t distribution;
+	size_t param;
+	uint64_t seed;
+	size_t id;
+	size_t threads;
+} data_fill_t;
+
+/**
+ * Body of each thread of `dataFillParallel`.
+ * @param arg the thread's `data_fill_t`
+ * @return NULL
+ */
+void *dataFillWorker(void *arg)
+{
+	data_fill_t *fill = arg;
+
+	for (size_t lowerBound = fill->id * DATA_BLOCK_LENGTH; lowerBound < fill->length;
+		 lowerBound += fill->threads * DATA_BLOCK_LENGTH)
+	{
+		size_t upperBound = (fill->length - lowerBound < DATA_BLOCK_LENGTH)
+								? fill->length
+								: lowerBound + DATA_BLOCK_LENGTH;
+
+		dataFillBlock(fill->arr, fill->length, lowerBound, upperBound, fill->distribution,
+					  fill->param, fill->seed);
+	}
+
+	return NULL;
+}
+
+/**
+ * Same as `dataFill`, with the blocks shared out between up to `threads` threads, the calling one
+ * included. The data is identical to that of `dataFill` whatever the number of threads.
+ * @param arr array to fill
+ * @param length The legth of `arr`
+ * @param distribution shape of the data
+ * @param param parameter of the distribution, see `data_distribution_t`
+ * @param seed seed, the same seed gives the same data
+ * @param threads maximum number of threads to use
+ */
+void dataFillParallel(int arr[], size_t length, data_distribution_t distribution, size_t param,
+					  uint64_t seed, size_t threads)
+{
+	size_t blocks = (length + DATA_BLOCK_LENGTH - 1) / DATA_BLOCK_LENGTH;
+	threads = (threads < blocks) ? threads : blocks;
+
+	if (threads <= 1)
+	{
+		dataFill(arr, length, distribution, param, seed);
+		return;
+	}
 
+	pthread_t *thread = malloc(threads * sizeof(pthread_t));
+	data_fill_t *fill = malloc(threads * sizeof(data_fill_t));
+	if (NULL == thread || NULL == fill)
+	{
+		fputs("Could not allocate the fill threads\n", stderr);
+		exit(EXIT_FAILURE);
+	}
+
+	for (size_t ix = 0; ix < threads; ix++)
+	{
+		fill[ix] = (data_fill_t){arr, length, distribution, param, seed, ix, threads};
+	}
+
+	for (size_t ix = 1; ix < threads; ix++)
+	{
+		if (0 != pthread_create(&thread[ix], NULL, dataFillWorker, &fill[ix]))
+		{
+			fputs("Could not start a fill thread\n", stderr);
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	dataFillWorker(&fill[0]);
+
+	for (size_t ix = 1; ix < threads; ix++)
+	{
+		pthread_join(thread[ix], NULL);
+	}
+
+	free(fill);
+	free(thread);
+}
+
+/**
+ * Allocates `arr_length` ints on the heap and fills them with uniform random data from `seed`.
+ * @param arr_length number of elements
+ * @param seed seed, the same seed gives the same data
+ * @return the array, NULL if it could not be allocated
+ */
+int *random_chunk(size_t arr_length, uint64_t seed)
+{
 	int *arr = malloc(arr_length * sizeof(int));
-	for (size_t ix = 0; ix < arr_length; ix++)
+
+	if (NULL != arr)
 	{
-		arr[ix] = rand();
+		dataFill(arr, arr_length, DATA_UNIFORM, 0, seed);
 	}
 
 	return arr;
-}
\ No newline at end of file
+}
@@ -0,0 +1,125 @@
+#include "lib/arena_lib.h"
+#include <assert.h>
+#include <string.h>
+
+#if defined(__CHERI_PURE_CAPABILITY__)
+#include <cheriintrin.h>
+#endif
+
+void test_arena_padded_size()
+{
+	assert(ARENA_ALIGNMENT == arena_padded_size(0));
+	assert(ARENA_ALIGNMENT == arena_padded_size(1));
+	assert(ARENA_ALIGNMENT == arena_padded_size(ARENA_ALIGNMENT));
+	assert(2 * ARENA_ALIGNMENT == arena_padded_size(ARENA_ALIGNMENT + 1));
+
+	for (size_t size = 1; size < ((size_t)1 << 30); size = size * 3 + 1)
+	{
+		size_t alignment = arena_padded_alignment(size);
+
+		assert(arena_padded_size(size) >= size);
+		assert(0 == arena_padded_size(size) % ARENA_ALIGNMENT);
+		assert(alignment >= ARENA_ALIGNMENT && 0 == (alignment & (alignment - 1)));
+	}
+}
+
+void test_arena_alloc()
+{
+	const size_t count = 20000;
+	arena_t *arena = arena_create(64 * 1024);
+	unsigned char **objects = malloc(count * sizeof(unsigned char *));
+	uint64_t requested = 0;
+
+	assert(NULL != arena && NULL != objects);
+
+	// sizes 1 .. 300, each object filled with its own byte
+	for (size_t ix = 0; ix < count; ix++)
+	{
+		size_t size = 1 + (ix * 7919) % 300;
+
+		objects[ix] = arena_alloc(arena, size);
+		assert(NULL != objects[ix]);
+		assert(0 == (uintptr_t)objects[ix] % ARENA_ALIGNMENT);
+#if defined(__CHERI_PURE_CAPABILITY__)
+		assert(size == cheri_length_get(objects[ix]));
+		assert(0 == cheri_offset_get(objects[ix]));
+#endif
+
+		memset(objects[ix], (int)(ix & 0xFF), size);
+		requested += size;
+	}
+
+	// no object overlaps another
+	for (size_t ix = 0; ix < count; ix++)
+	{
+		size_t size = 1 + (ix * 7919) % 300;
+
+		assert((ix & 0xFF) == objects[ix][0] && (ix & 0xFF) == objects[ix][size - 1]);
+	}
+
+	assert(count == arena->stats.allocations);
+	assert(requested == arena->stats.bytesRequested);
+	assert(arena->stats.regionsMapped * arena->regionBytes >=
+		   arena->stats.bytesRequested + arena->stats.bytesPadded);
+
+	free(objects);
+	arena_destroy(arena);
+}
+
+void test_arena_reset()
+{
+	arena_t *arena = arena_create(0);
+	assert(NULL != arena && ARENA_DEFAULT_REGION_BYTES == arena->regionBytes);
+
+	void *first = arena_alloc(arena, 100);
+	void *large = arena_alloc(arena, 3 * ARENA_DEFAULT_REGION_BYTES);
+	void *next = arena_alloc(arena, 100);
+
+	assert(NULL != first && NULL != large && NULL != next);
+	memset(large, 1, 3 * ARENA_DEFAULT_REGION_BYTES);
+
+	// the large allocation has a region of its own, small ones stay in the first region
+	assert(2 == arena->stats.regionsMapped);
+	assert((uintptr_t)next == (uintptr_t)first + arena_padded_size(100));
+
+	// the region of the arena size is kept, the large one is unmapped
+	arena_reset(arena);
+	assert(1 == arena->stats.resets && 1 == arena->stats.regionsUnmapped);
+	assert(NULL == arena->regions && NULL != arena->spare);
+
+	void *again = arena_alloc(arena, 100);
+	assert((uintptr_t)again == (uintptr_t)first);
+	assert(2 == arena->stats.regionsMapped);
+
+	// several regions are kept and reused in turn
+	for (size_t ix = 0; ix < 3 * ARENA_DEFAULT_REGION_BYTES / 4096; ix++)
+	{
+		assert(NULL != arena_alloc(arena, 4096));
+	}
+	uint64_t mapped = arena->stats.regionsMapped;
+
+	arena_reset(arena);
+	for (size_t ix = 0; ix < 3 * ARENA_DEFAULT_REGION_BYTES / 4096; ix++)
+	{
+		assert(NULL != arena_alloc(arena, 4096));
+	}
+	assert(mapped == arena->stats.regionsMapped);
+
+	arena_destroy(arena);
+	arena_destroy(NULL);
+}
+
+/**
+ * Test harness for `lib/arena_lib.c`.
+ * @return EXIT_SUCCESS when all tests pass. Assertion failure otherwise.
+ */
+int main(int argc, char *argv[])
+{
+	test_arena_padded_size();
+
+	test_arena_alloc();
+
+	test_arena_reset();
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,180 @@
+#include "lib/extsort_lib.h"
+#include "lib/timsort_lib.h"
+#include "lib/timsortdata.h"
+#include <assert.h>
+#include <limits.h>
+#include <string.h>
+#include <unistd.h>
+
+// smallest memory budget `extSort` accepts: a fan-in of 2
+#define TEST_MEMORY (6 * EXTSORT_MIN_BUFFER)
+
+// directory of the scratch files: $TMPDIR, or /tmp
+const char *tempDir;
+
+// input and output files of the tests, unique to this run
+char inputPath[PATH_MAX];
+char outputPath[PATH_MAX];
+
+/**
+ * Creates an empty scratch file with a unique name in `tempDir`.
+ * @param path output, the name of the file
+ * @param name prefix of the name
+ */
+void tempFile(char path[PATH_MAX], const char *name)
+{
+	int length = snprintf(path, PATH_MAX, "%s/%s-XXXXXX", tempDir, name);
+	assert(length < PATH_MAX);
+
+	int fd = mkstemp(path);
+	assert(fd >= 0);
+	close(fd);
+}
+
+/**
+ * Writes `bytes` bytes of `data` to `path`.
+ * @param path file to write
+ * @param data data to write
+ * @param bytes number of bytes
+ */
+void writeFile(const char *path, const void *data, size_t bytes)
+{
+	FILE *file = fopen(path, "wb");
+
+	assert(NULL != file);
+	assert(bytes == fwrite(data, 1, bytes, file));
+	fclose(file);
+}
+
+/**
+ * Reads up to `bytes` bytes of `path` into `data`.
+ * @param path file to read
+ * @param data output
+ * @param bytes size of `data`
+ * @return The number of bytes read
+ */
+size_t readFile(const char *path, void *data, size_t bytes)
+{
+	FILE *file = fopen(path, "rb");
+
+	assert(NULL != file);
+	size_t done = fread(data, 1, bytes, file);
+	fclose(file);
+
+	return done;
+}
+
+void test_extSortFanIn()
+{
+	assert(extSortFanIn(TEST_MEMORY - 1) < 2);
+	assert(2 == extSortFanIn(TEST_MEMORY));
+
+	// a chunk and its merge buffer fit in the budget
+	size_t records = extSortChunkRecords(TEST_MEMORY, EXTSORT_INT64);
+	assert((records + timSortBufferLength(records)) * sizeof(int64_t) <= TEST_MEMORY);
+}
+
+void test_extSort_int32()
+{
+	const size_t arr_length = 1 << 20;
+	int *arr = malloc(arr_length * sizeof(int));
+	int *sorted = malloc(arr_length * sizeof(int) + 1);
+	extsort_stats_t stats;
+
+	assert(NULL != arr && NULL != sorted);
+
+	dataFill(arr, arr_length, DATA_UNIFORM, 0, DATA_SEED);
+	writeFile(inputPath, arr, arr_length * sizeof(int));
+
+	// 16 runs merged 2 at a time: 4 passes
+	assert(extSort(inputPath, outputPath, EXTSORT_INT32, TEST_MEMORY, tempDir, &stats));
+	assert(arr_length * sizeof(int) == readFile(outputPath, sorted, arr_length * sizeof(int) + 1));
+
+	timSort(arr, arr_length);
+	assert(0 == memcmp(arr, sorted, arr_length * sizeof(int)));
+
+	assert(arr_length == stats.records);
+	assert(16 == stats.runs && 4 == stats.mergePasses);
+	assert(5 * arr_length * sizeof(int) == stats.bytesRead);
+	assert(5 * arr_length * sizeof(int) == stats.bytesWritten);
+
+	free(sorted);
+	free(arr);
+}
+
+void test_extSort_int64()
+{
+	const size_t arr_length = 250000;
+	int64_t *arr = malloc(arr_length * sizeof(int64_t));
+	int64_t *sorted = malloc(arr_length * sizeof(int64_t));
+	extsort_stats_t stats;
+
+	assert(NULL != arr && NULL != sorted);
+
+	for (size_t ix = 0; ix < arr_length; ix++)
+	{
+		arr[ix] = (int64_t)splitMix64(ix);
+	}
+	writeFile(inputPath, arr, arr_length * sizeof(int64_t));
+
+	// 4 runs, merged at once with a larger budget
+	assert(extSort(inputPath, outputPath, EXTSORT_INT64, 2 * TEST_MEMORY, tempDir, &stats));
+	assert(arr_length * sizeof(int64_t) ==
+		   readFile(outputPath, sorted, arr_length * sizeof(int64_t)));
+	assert(4 == stats.runs && 1 == stats.mergePasses);
+	assert(isSorted_i64(sorted, arr_length));
+
+	timSort_i64(arr, arr_length);
+	assert(0 == memcmp(arr, sorted, arr_length * sizeof(int64_t)));
+
+	free(sorted);
+	free(arr);
+}
+
+void test_extSort_small()
+{
+	int arr[] = {5, -3, 8, 0, 5, 2};
+	int sorted[7];
+	extsort_stats_t stats;
+
+	// a single chunk is sorted in memory, without temporary files
+	writeFile(inputPath, arr, sizeof(arr));
+	assert(extSort(inputPath, outputPath, EXTSORT_INT32, TEST_MEMORY, tempDir, &stats));
+	assert(sizeof(arr) == readFile(outputPath, sorted, sizeof(sorted)));
+	assert(-3 == sorted[0] && 0 == sorted[1] && 2 == sorted[2] && 8 == sorted[5]);
+	assert(0 == stats.runs && 0 == stats.mergePasses);
+
+	// empty input
+	writeFile(inputPath, arr, 0);
+	assert(extSort(inputPath, outputPath, EXTSORT_INT32, TEST_MEMORY, tempDir, &stats));
+	assert(0 == readFile(outputPath, sorted, sizeof(sorted)));
+
+	// truncated record, and too small a budget
+	writeFile(inputPath, arr, sizeof(arr) - 1);
+	assert(!extSort(inputPath, outputPath, EXTSORT_INT32, TEST_MEMORY, tempDir, &stats));
+	assert(!extSort(inputPath, outputPath, EXTSORT_INT32, TEST_MEMORY - 1, tempDir, &stats));
+}
+
+/**
+ * Test harness for `extsort.c`. Writes its scratch files to $TMPDIR, or /tmp.
+ * @return EXIT_SUCCESS when all tests pass. Assertion failure otherwise.
+ */
+int main(int argc, char *argv[])
+{
+	tempDir = (NULL != getenv("TMPDIR")) ? getenv("TMPDIR") : "/tmp";
+	tempFile(inputPath, "test-extsort.in");
+	tempFile(outputPath, "test-extsort.out");
+
+	test_extSortFanIn();
+
+	test_extSort_int32();
+
+	test_extSort_int64();
+
+	test_extSort_small();
+
+	remove(inputPath);
+	remove(outputPath);
+
+	return EXIT_SUCCESS;
+}
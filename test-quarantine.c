@@ -0,0 +1,201 @@
+#include "lib/quarantine_lib.h"
+#include <assert.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+void *stackTop;
+
+// pointer held in a global, a root of the sweeps
+void *testGlobal;
+
+void test_quarantine_is_stale()
+{
+	quarantine_t *quarantine = quarantine_create(stackTop, SIZE_MAX);
+	assert(NULL != quarantine && SIZE_MAX == quarantine->budget);
+
+	char *object = quarantine_alloc(quarantine, 100);
+	char *other = quarantine_alloc(quarantine, 100);
+	assert(NULL != object && NULL != other);
+	assert(!quarantine_is_stale(quarantine, object));
+
+	quarantine_free(quarantine, object, 100);
+	assert(quarantine_is_stale(quarantine, object));
+	assert(!quarantine_is_stale(quarantine, other));
+	assert(0 == quarantine->stats.sweeps);
+
+	// the object is not handed out again while in quarantine
+	char *again = quarantine_alloc(quarantine, 100);
+	assert(again != object);
+
+	quarantine_sweep(quarantine);
+	assert(!quarantine_is_stale(quarantine, object));
+	assert(1 == quarantine->stats.sweeps);
+	assert(0 == quarantine->quarantinedBytes && 0 == quarantine->entryCount);
+
+	quarantine_destroy(quarantine);
+	quarantine_destroy(NULL);
+}
+
+void test_quarantine_double_free()
+{
+	quarantine_t *quarantine = quarantine_create(stackTop, SIZE_MAX);
+	assert(NULL != quarantine);
+
+	char *object = quarantine_alloc(quarantine, 100);
+	assert(NULL != object);
+	quarantine_free(quarantine, object, 100);
+
+	// a second free while the object is in quarantine exits, in a child process
+	pid_t child = fork();
+	int status = 0;
+	assert(child >= 0);
+
+	if (0 == child)
+	{
+		quarantine_free(quarantine, object, 100);
+		exit(EXIT_SUCCESS);
+	}
+
+	assert(child == waitpid(child, &status, 0));
+	assert(WIFEXITED(status) && EXIT_FAILURE == WEXITSTATUS(status));
+	assert(1 == quarantine->entryCount && 1 == quarantine->stats.frees);
+
+	quarantine_destroy(quarantine);
+}
+
+void test_quarantine_scan_range()
+{
+	const size_t count = 64;
+	quarantine_t *quarantine = quarantine_create(stackTop, SIZE_MAX);
+	void **pointers = malloc(count * sizeof(void *));
+
+	assert(NULL != quarantine && NULL != pointers);
+
+	for (size_t ix = 0; ix < count; ix++)
+	{
+		pointers[ix] = quarantine_alloc(quarantine, 48);
+		assert(NULL != pointers[ix]);
+	}
+
+	// every third object is freed, all pointers to it are revoked, the others are kept
+	for (size_t ix = 0; ix < count; ix += 3)
+	{
+		quarantine_free(quarantine, pointers[ix], 48);
+	}
+
+	assert((count + 2) / 3 ==
+		   quarantine_scan_range(quarantine, pointers, (char *)pointers + count * sizeof(void *)));
+	assert(count * sizeof(void *) == quarantine->stats.bytesScanned);
+
+	// without capabilities the scan only reads
+	for (size_t ix = 0; ix < count; ix++)
+	{
+#if defined(__CHERI_PURE_CAPABILITY__)
+		assert(quarantine_is_pointer(pointers[ix]) == (0 != ix % 3));
+#else
+		assert(quarantine_is_pointer(pointers[ix]));
+#endif
+	}
+
+	assert(0 == quarantine_scan_range(quarantine, pointers, pointers));
+
+	free(pointers);
+	quarantine_destroy(quarantine);
+}
+
+void test_quarantine_sweep()
+{
+	quarantine_t *quarantine = quarantine_create(stackTop, SIZE_MAX);
+	assert(NULL != quarantine);
+	assert(quarantine_add_root(quarantine, &testGlobal, sizeof(testGlobal)));
+
+	char *victim = quarantine_alloc(quarantine, 200);
+	void **holder = quarantine_alloc(quarantine, 64);
+	char *live = quarantine_alloc(quarantine, 200);
+	assert(NULL != victim && NULL != holder && NULL != live);
+
+	memset(victim, 0x5A, 200);
+
+	uint64_t victimAddress = (uint64_t)(uintptr_t)victim;
+
+	// the victim is reachable from the stack, a global and the heap
+	char *volatile onStack = victim;
+	testGlobal = victim;
+	holder[0] = victim;
+	holder[1] = live;
+
+	quarantine_free(quarantine, victim, 200);
+	quarantine_sweep(quarantine);
+
+#if defined(__CHERI_PURE_CAPABILITY__)
+	assert(!quarantine_is_pointer(onStack));
+	assert(!quarantine_is_pointer(testGlobal));
+	assert(!quarantine_is_pointer(holder[0]));
+#else
+	// without capabilities the scan only reads
+	assert(victim == onStack && victim == testGlobal && victim == holder[0]);
+#endif
+	assert(live == holder[1]);
+	assert(3 <= quarantine->stats.pointersRevoked);
+
+	// the memory is handed out again, zeroed
+	char *again = quarantine_alloc(quarantine, 200);
+	assert((uint64_t)(uintptr_t)again == victimAddress);
+
+	for (size_t ix = 0; ix < 200; ix++)
+	{
+		assert(0 == again[ix]);
+	}
+
+	quarantine_destroy(quarantine);
+}
+
+void test_quarantine_budget()
+{
+	quarantine_t *quarantine = quarantine_create(stackTop, 4096);
+	assert(NULL != quarantine);
+
+	for (size_t ix = 0; ix < 1000; ix++)
+	{
+		void *object = quarantine_alloc(quarantine, 64);
+		assert(NULL != object);
+		quarantine_free(quarantine, object, 64);
+	}
+
+	assert(1000 == quarantine->stats.frees);
+	assert(1000 * 64 / 4096 == quarantine->stats.sweeps);
+	assert(quarantine->stats.sweeps * 4096 == quarantine->stats.bytesReleased);
+	assert(quarantine->stats.maxPauseNanoseconds >= quarantine->stats.lastPauseNanoseconds);
+	assert(quarantine->stats.sweepNanoseconds >= quarantine->stats.maxPauseNanoseconds);
+
+	// large objects are quarantined and unmapped by the sweep
+	void *large = quarantine_alloc(quarantine, 2 * SLAB_MAX_SIZE);
+	assert(NULL != large);
+	quarantine_free(quarantine, large, 2 * SLAB_MAX_SIZE);
+	assert(1000 * 64 / 4096 + 1 == quarantine->stats.sweeps);
+	assert(0 == quarantine->heap->largeObjects);
+
+	quarantine_destroy(quarantine);
+}
+
+/**
+ * Test harness for `lib/quarantine_lib.c`.
+ * @return EXIT_SUCCESS when all tests pass. Assertion failure otherwise.
+ */
+int main(int argc, char *argv[])
+{
+	stackTop = __builtin_frame_address(0);
+
+	test_quarantine_is_stale();
+
+	test_quarantine_double_free();
+
+	test_quarantine_scan_range();
+
+	test_quarantine_sweep();
+
+	test_quarantine_budget();
+
+	return EXIT_SUCCESS;
+}
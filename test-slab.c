@@ -0,0 +1,209 @@
+#include "lib/slab_lib.h"
+#include <assert.h>
+#include <string.h>
+
+#if defined(__CHERI_PURE_CAPABILITY__)
+#include <cheriintrin.h>
+#endif
+
+void test_slab_size_classes()
+{
+	size_t sizes[SLAB_MAX_CLASSES];
+	size_t count = slab_size_classes(sizes, SLAB_MAX_CLASSES);
+
+	assert(count > 0 && count <= SLAB_MAX_CLASSES);
+	assert(SLAB_MIN_SIZE == sizes[0]);
+	assert(sizes[count - 1] >= SLAB_MAX_SIZE);
+
+	for (size_t ix = 0; ix < count; ix++)
+	{
+		assert(0 == sizes[ix] % SLAB_MIN_SIZE);
+		assert(sizes[ix] == slab_representable_size(sizes[ix]));
+		assert(0 == ix || sizes[ix] > sizes[ix - 1]);
+#if defined(__CHERI_PURE_CAPABILITY__)
+		assert(0 == (sizes[ix] & ~cheri_representable_alignment_mask(sizes[ix])));
+#endif
+	}
+
+	// a class is at most a quarter larger than the sizes it holds, beyond the smallest ones
+	for (size_t ix = 1; ix < count; ix++)
+	{
+		assert(sizes[ix] <= 64 || 4 * sizes[ix] <= 5 * sizes[ix - 1]);
+	}
+}
+
+void test_slab_class_index()
+{
+	slab_allocator_t *allocator = slab_create();
+	assert(NULL != allocator);
+
+	for (size_t size = 0; size <= 2 * SLAB_MAX_SIZE; size = size * 5 / 4 + 1)
+	{
+		size_t index = slab_class_index(allocator, size);
+
+		if (index == allocator->classes)
+		{
+			assert(size > allocator->class[allocator->classes - 1].size);
+		}
+		else
+		{
+			assert(allocator->class[index].size >= size);
+			assert(0 == index || allocator->class[index - 1].size < size);
+		}
+	}
+
+	slab_destroy(allocator);
+}
+
+void test_slab_alloc()
+{
+	const size_t count = 20000;
+	slab_allocator_t *allocator = slab_create();
+	unsigned char **objects = malloc(count * sizeof(unsigned char *));
+	slab_stats_t stats;
+	uint64_t requested = 0;
+
+	assert(NULL != allocator && NULL != objects);
+
+	// sizes 1 .. 5000, each object filled with its own byte
+	for (size_t ix = 0; ix < count; ix++)
+	{
+		size_t size = 1 + (ix * 7919) % 5000;
+
+		objects[ix] = slab_alloc(allocator, size);
+		assert(NULL != objects[ix]);
+		assert(0 == (uintptr_t)objects[ix] % SLAB_MIN_SIZE);
+#if defined(__CHERI_PURE_CAPABILITY__)
+		size_t index = slab_class_index(allocator, size);
+		assert(allocator->class[index].size == cheri_length_get(objects[ix]));
+		assert(0 == cheri_offset_get(objects[ix]));
+#endif
+
+		memset(objects[ix], (int)(ix & 0xFF), size);
+		requested += size;
+	}
+
+	// no object overlaps another
+	for (size_t ix = 0; ix < count; ix++)
+	{
+		size_t size = 1 + (ix * 7919) % 5000;
+
+		assert((ix & 0xFF) == objects[ix][0] && (ix & 0xFF) == objects[ix][size - 1]);
+	}
+
+	slab_stats(allocator, &stats);
+	assert(requested == stats.bytesRequested);
+	assert(stats.bytesInUse == stats.bytesRequested + stats.bytesPadding);
+	assert(stats.bytesMapped == stats.bytesInUse + stats.bytesFree);
+	assert(stats.fragmentation >= 0.0 && stats.fragmentation < 1.0);
+
+	for (slab_mapping_t *mapping = allocator->mappings; NULL != mapping; mapping = mapping->next)
+	{
+		assert(0 == (uintptr_t)mapping->base % SLAB_MIN_BYTES);
+		assert(0 == mapping->bytes % SLAB_MIN_BYTES);
+	}
+
+	// freed objects are handed out again, last freed first, before slabs are extended
+	uint64_t mapped = stats.bytesMapped;
+
+	for (size_t ix = 0; ix < count; ix++)
+	{
+		slab_free(allocator, objects[ix], 1 + (ix * 7919) % 5000);
+	}
+
+	slab_stats(allocator, &stats);
+	assert(0 == stats.bytesRequested && 0 == stats.bytesInUse && 0 == stats.bytesPadding);
+	assert(mapped == stats.bytesFree);
+
+	unsigned char *again = slab_alloc(allocator, 1 + ((count - 1) * 7919) % 5000);
+	assert(again == objects[count - 1]);
+
+	for (size_t ix = 0; ix < count; ix++)
+	{
+		assert(NULL != slab_alloc(allocator, 1 + (ix * 7919) % 5000));
+	}
+
+	slab_stats(allocator, &stats);
+	assert(mapped == stats.bytesMapped);
+
+	free(objects);
+	slab_destroy(allocator);
+}
+
+void test_slab_alloc_large()
+{
+	slab_allocator_t *allocator = slab_create();
+	slab_stats_t stats;
+	size_t size = 3 * SLAB_MAX_SIZE + 1;
+
+	assert(NULL != allocator);
+
+	unsigned char *large = slab_alloc(allocator, size);
+	assert(NULL != large);
+	memset(large, 1, size);
+
+	slab_stats(allocator, &stats);
+	assert(1 == allocator->largeObjects && NULL == allocator->mappings);
+	assert(size == stats.bytesRequested && slab_large_bytes(size) == stats.bytesMapped);
+	assert(stats.bytesPadding == slab_large_bytes(size) - size);
+
+	slab_free(allocator, large, size);
+	slab_free(allocator, NULL, size);
+
+	slab_stats(allocator, &stats);
+	assert(0 == allocator->largeObjects && 0 == stats.bytesMapped);
+
+	slab_destroy(allocator);
+	slab_destroy(NULL);
+}
+
+void test_slab_alloc_large_bounds()
+{
+	slab_allocator_t *allocator = slab_create();
+	size_t sizes[] = {SLAB_MAX_SIZE + 1, 2 * SLAB_MAX_SIZE + 100, 5 * SLAB_MAX_SIZE + 12345};
+	unsigned char *large[3];
+
+	assert(NULL != allocator);
+
+	for (size_t ix = 0; ix < 3; ix++)
+	{
+		large[ix] = slab_alloc(allocator, sizes[ix]);
+		assert(NULL != large[ix]);
+#if defined(__CHERI_PURE_CAPABILITY__)
+		// exact bounds, without the slack of the last page of the mapping
+		assert(cheri_representable_length(sizes[ix]) == cheri_length_get(large[ix]));
+		assert(cheri_length_get(large[ix]) < slab_large_bytes(sizes[ix]));
+		assert(0 == cheri_offset_get(large[ix]));
+#endif
+		memset(large[ix], (int)ix + 1, sizes[ix]);
+	}
+
+	// freed out of order, each through its own mapping
+	slab_free(allocator, large[1], sizes[1]);
+	assert(2 == allocator->largeObjects && 1 == large[0][0] && 3 == large[2][sizes[2] - 1]);
+
+	slab_free(allocator, large[0], sizes[0]);
+	slab_free(allocator, large[2], sizes[2]);
+	assert(0 == allocator->largeObjects && NULL == allocator->largeMappings);
+
+	slab_destroy(allocator);
+}
+
+/**
+ * Test harness for `lib/slab_lib.c`.
+ * @return EXIT_SUCCESS when all tests pass. Assertion failure otherwise.
+ */
+int main(int argc, char *argv[])
+{
+	test_slab_size_classes();
+
+	test_slab_class_index();
+
+	test_slab_alloc();
+
+	test_slab_alloc_large();
+
+	test_slab_alloc_large_bounds();
+
+	return EXIT_SUCCESS;
+}
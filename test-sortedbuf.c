@@ -0,0 +1,121 @@
+#include "lib/sortedbuf_lib.h"
+#include "lib/timsort_lib.h"
+#include "lib/timsortdata.h"
+#include <assert.h>
+#include <string.h>
+
+/**
+ * Checks the layout of the levels of `buffer`: they cover its elements one after the other, each
+ * one is sorted and over twice as long as the next.
+ * @param buffer buffer to check
+ */
+void checkLevels(sorted_buffer_t *buffer)
+{
+	size_t base = 0;
+
+	for (size_t ix = 0; ix < buffer->levels; ix++)
+	{
+		assert(base == buffer->levelBase[ix]);
+		assert(isSorted(&buffer->data[base], buffer->levelLength[ix]));
+		assert((0 == ix) || (buffer->levelLength[ix - 1] > 2 * buffer->levelLength[ix]));
+
+		base += buffer->levelLength[ix];
+	}
+
+	assert(base == buffer->length);
+}
+
+void test_sortedBufferAppend()
+{
+	const size_t arr_length = 100000;
+	int *arr = malloc(arr_length * sizeof(int));
+	sorted_buffer_t buffer;
+
+	assert(NULL != arr);
+	dataFill(arr, arr_length, DATA_UNIFORM, 0, DATA_SEED);
+	sortedBufferInit(&buffer);
+
+	// batches of varying length, the view checked against a full sort after some of them
+	size_t appended = 0;
+	for (size_t batch = 1; appended < arr_length; batch = batch * 7 % 997 + 1)
+	{
+		size_t length = (arr_length - appended < batch) ? arr_length - appended : batch;
+
+		sortedBufferAppend(&buffer, &arr[appended], length);
+		appended += length;
+		checkLevels(&buffer);
+
+		// log2(n) + 1 levels at most
+		assert(((size_t)1 << (buffer.levels - 1)) <= buffer.length);
+
+		if (0 == batch % 5)
+		{
+			int *sorted = malloc(appended * sizeof(int));
+			size_t viewLength;
+
+			assert(NULL != sorted);
+			memcpy(sorted, arr, appended * sizeof(int));
+			timSort(sorted, appended);
+
+			const int *view = sortedBufferView(&buffer, &viewLength);
+			assert(appended == viewLength && 1 == buffer.levels);
+			assert(0 == memcmp(view, sorted, appended * sizeof(int)));
+
+			free(sorted);
+		}
+	}
+
+	sortedBufferFree(&buffer);
+	free(arr);
+}
+
+void test_sortedBufferView()
+{
+	int batches[3][4] = {{7, 3, 9, 1}, {2}, {8, 0, 5}};
+	size_t lengths[3] = {4, 1, 3};
+	int expected[] = {0, 1, 2, 3, 5, 7, 8, 9};
+	sorted_buffer_t buffer;
+	size_t viewLength;
+
+	sortedBufferInit(&buffer);
+
+	sortedBufferView(&buffer, &viewLength);
+	assert(0 == viewLength);
+
+	sortedBufferAppend(&buffer, batches[0], 0);
+	assert(0 == buffer.length && 0 == buffer.levels);
+
+	// {1, 3, 7, 9} is over twice as long as {2}
+	sortedBufferAppend(&buffer, batches[0], lengths[0]);
+	sortedBufferAppend(&buffer, batches[1], lengths[1]);
+	assert(2 == buffer.levels);
+
+	// {0, 5, 8} merges into {2}, which is then as long as the first level and merges into it
+	sortedBufferAppend(&buffer, batches[2], lengths[2]);
+	assert(1 == buffer.levels);
+
+	const int *view = sortedBufferView(&buffer, &viewLength);
+	assert(8 == viewLength && 1 == buffer.levels);
+	assert(0 == memcmp(view, expected, sizeof(expected)));
+
+	// a second read does not change the view
+	assert(view == sortedBufferView(&buffer, &viewLength) && 8 == viewLength);
+
+	sortedBufferFree(&buffer);
+	assert(0 == buffer.length && NULL == buffer.data);
+}
+
+/**
+ * Test harness for `lib/sortedbuf_lib.c`.
+ * @return EXIT_SUCCESS when all tests pass. Assertion failure otherwise.
+ */
+int main(int argc, char *argv[])
+{
+	test_sortedBufferAppend();
+
+	test_sortedBufferView();
+
+	timSortFreeBuffer();
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,290 @@
+#include "lib/tcache_lib.h"
+#include <assert.h>
+#include <pthread.h>
+#include <string.h>
+
+// threads and rounds of `test_tcache_threads`
+#define TEST_THREADS 4
+#define TEST_ROUNDS 50
+#define TEST_OBJECTS 2000
+
+void test_tcache_stack()
+{
+	tcache_t *cache = tcache_create();
+	assert(NULL != cache);
+
+	_Atomic uint64_t stack = 0;
+	assert(TCACHE_NONE == tcache_stack_pop(cache, &stack));
+
+	for (uint32_t ix = 0; ix < 10; ix++)
+	{
+		tcache_stack_push(cache, &stack, ix);
+	}
+
+	for (uint32_t ix = 10; ix-- > 0;)
+	{
+		assert(ix == tcache_stack_pop(cache, &stack));
+	}
+
+	assert(TCACHE_NONE == tcache_stack_pop(cache, &stack));
+
+	// the pool is used once the stack of empty magazines is empty
+	uint32_t first = tcache_magazine_acquire(cache);
+	uint32_t second = tcache_magazine_acquire(cache);
+	assert(first != second && TCACHE_NONE != first && TCACHE_NONE != second);
+
+	tcache_stack_push(cache, &cache->empty, first);
+	assert(first == tcache_magazine_acquire(cache));
+
+	tcache_destroy(cache);
+}
+
+void test_tcache_span()
+{
+	tcache_t *cache = tcache_create();
+	assert(NULL != cache);
+
+	char *base = (char *)(uintptr_t)(1000 * SLAB_MIN_BYTES);
+
+	assert(TCACHE_NONE == tcache_span_owner(cache, base));
+	assert(tcache_span_register(cache, base, 3 * SLAB_MIN_BYTES, 5));
+	assert(tcache_span_register(cache, base + 3 * SLAB_MIN_BYTES, SLAB_MIN_BYTES, 7));
+
+	assert(5 == tcache_span_owner(cache, base));
+	assert(5 == tcache_span_owner(cache, base + 3 * SLAB_MIN_BYTES - 1));
+	assert(7 == tcache_span_owner(cache, base + 3 * SLAB_MIN_BYTES));
+	assert(TCACHE_NONE == tcache_span_owner(cache, base + 4 * SLAB_MIN_BYTES));
+	assert(TCACHE_NONE == tcache_span_owner(cache, base - 1));
+
+	tcache_destroy(cache);
+}
+
+void test_tcache_alloc()
+{
+	const size_t count = 20000;
+	tcache_t *cache = tcache_create();
+	tcache_thread_t *thread = tcache_thread_create(cache);
+	unsigned char **objects = malloc(count * sizeof(unsigned char *));
+
+	assert(NULL != cache && NULL != thread && NULL != objects);
+
+	// sizes 1 .. 40000, the largest beyond `TCACHE_MAX_SIZE`
+	for (size_t round = 0; round < 3; round++)
+	{
+		for (size_t ix = 0; ix < count; ix++)
+		{
+			size_t size = 1 + (ix * 7919) % ((0 == ix % 100) ? 40000 : 1000);
+
+			objects[ix] = tcache_alloc(thread, size);
+			assert(NULL != objects[ix]);
+			assert(0 == (uintptr_t)objects[ix] % SLAB_MIN_SIZE);
+			memset(objects[ix], (int)(ix & 0xFF), size);
+		}
+
+		// no object overlaps another
+		for (size_t ix = 0; ix < count; ix++)
+		{
+			size_t size = 1 + (ix * 7919) % ((0 == ix % 100) ? 40000 : 1000);
+
+			assert((ix & 0xFF) == objects[ix][0] && (ix & 0xFF) == objects[ix][size - 1]);
+			tcache_free(thread, objects[ix], size);
+		}
+	}
+
+	// the objects of later rounds are those freed by the first one
+	slab_stats_t stats;
+	slab_stats(thread->heap, &stats);
+	assert(3 * count == thread->stats.allocations && 3 * count == thread->stats.frees);
+	assert(0 < thread->stats.depotExchanges && 0 == thread->stats.remoteFreesSent);
+	assert(stats.bytesMapped < 2 * count * 1024);
+
+	tcache_free(thread, NULL, 10);
+	tcache_thread_release(thread);
+
+	free(objects);
+	tcache_destroy(cache);
+	tcache_destroy(NULL);
+}
+
+void test_tcache_thread_release()
+{
+	tcache_t *cache = tcache_create();
+	assert(NULL != cache);
+
+	// released thread caches are taken over, so any number of threads can come and go
+	for (size_t ix = 0; ix < 3 * TCACHE_MAX_THREADS; ix++)
+	{
+		tcache_thread_t *thread = tcache_thread_create(cache);
+
+		assert(NULL != thread && 0 == thread->id);
+		assert(NULL != tcache_alloc(thread, 100));
+		tcache_thread_release(thread);
+	}
+
+	assert(1 == cache->threadCount);
+
+	// an object freed by another thread after its owner is released goes to the next owner
+	tcache_thread_t *owner = tcache_thread_create(cache);
+	tcache_thread_t *other = tcache_thread_create(cache);
+	assert(NULL != owner && NULL != other && owner->id != other->id);
+
+	slab_allocator_t *heap = owner->heap;
+	size_t index = slab_class_index(heap, 100);
+	void *object = tcache_alloc(owner, 100);
+	assert(NULL != object);
+	tcache_thread_release(owner);
+
+	tcache_free(other, object, 100);
+	tcache_flush(other, index, &cache->magazines[other->loaded[index]]);
+	assert(1 == other->stats.remoteFreesSent);
+
+	tcache_thread_t *successor = tcache_thread_create(cache);
+	uint64_t received = successor->stats.remoteFreesReceived;
+	assert(owner == successor && heap == successor->heap);
+	assert(object == tcache_alloc(successor, 100));
+	assert(received + 1 == successor->stats.remoteFreesReceived);
+
+	// the pool runs out only when `TCACHE_MAX_THREADS` thread caches are in use at once
+	tcache_thread_t *threads[TCACHE_MAX_THREADS];
+	threads[0] = successor;
+	threads[1] = other;
+
+	for (size_t ix = 2; ix < TCACHE_MAX_THREADS; ix++)
+	{
+		threads[ix] = tcache_thread_create(cache);
+		assert(NULL != threads[ix]);
+	}
+
+	assert(NULL == tcache_thread_create(cache));
+
+	tcache_thread_release(threads[5]);
+	assert(threads[5] == tcache_thread_create(cache));
+
+	tcache_destroy(cache);
+}
+
+/**
+ * Objects shared by the threads of `test_tcache_threads`, each freed by the next thread.
+ */
+typedef struct test_shared
+{
+	tcache_t *cache;
+	pthread_barrier_t barrier;
+	unsigned char *objects[TEST_THREADS][TEST_OBJECTS];
+	tcache_stats_t stats[TEST_THREADS];
+} test_shared_t;
+
+/**
+ * Arguments of a thread of `test_tcache_threads`.
+ */
+typedef struct test_thread_arg
+{
+	test_shared_t *shared;
+	size_t id;
+} test_thread_arg_t;
+
+/**
+ * Thread of `test_tcache_threads`: allocates objects filled with its number, then checks and frees
+ * those of the previous thread, for a number of rounds.
+ * @param arg see `test_thread_arg_t`
+ * @return NULL
+ */
+void *test_tcache_thread(void *arg)
+{
+	test_shared_t *shared = ((test_thread_arg_t *)arg)->shared;
+	size_t id = ((test_thread_arg_t *)arg)->id;
+	size_t previous = (id + TEST_THREADS - 1) % TEST_THREADS;
+	tcache_thread_t *thread = tcache_thread_create(shared->cache);
+
+	assert(NULL != thread);
+
+	for (size_t round = 0; round < TEST_ROUNDS; round++)
+	{
+		for (size_t ix = 0; ix < TEST_OBJECTS; ix++)
+		{
+			size_t size = 1 + (ix * 7919 + round) % 600;
+
+			shared->objects[id][ix] = tcache_alloc(thread, size);
+			assert(NULL != shared->objects[id][ix]);
+			memset(shared->objects[id][ix], (int)id, size);
+		}
+
+		pthread_barrier_wait(&shared->barrier);
+
+		for (size_t ix = 0; ix < TEST_OBJECTS; ix++)
+		{
+			size_t size = 1 + (ix * 7919 + round) % 600;
+
+			assert(previous == shared->objects[previous][ix][0]);
+			assert(previous == shared->objects[previous][ix][size - 1]);
+			tcache_free(thread, shared->objects[previous][ix], size);
+		}
+
+		pthread_barrier_wait(&shared->barrier);
+	}
+
+	tcache_thread_release(thread);
+	shared->stats[id] = thread->stats;
+
+	return NULL;
+}
+
+void test_tcache_threads()
+{
+	test_shared_t *shared = malloc(sizeof(test_shared_t));
+	pthread_t threads[TEST_THREADS];
+	test_thread_arg_t args[TEST_THREADS];
+
+	assert(NULL != shared);
+	shared->cache = tcache_create();
+	assert(NULL != shared->cache);
+	assert(0 == pthread_barrier_init(&shared->barrier, NULL, TEST_THREADS));
+
+	for (size_t ix = 0; ix < TEST_THREADS; ix++)
+	{
+		args[ix].shared = shared;
+		args[ix].id = ix;
+		assert(0 == pthread_create(&threads[ix], NULL, test_tcache_thread, &args[ix]));
+	}
+
+	for (size_t ix = 0; ix < TEST_THREADS; ix++)
+	{
+		pthread_join(threads[ix], NULL);
+	}
+
+	// every object freed by another thread went back to its owner in batches
+	uint64_t sent = 0;
+	uint64_t received = 0;
+
+	for (size_t ix = 0; ix < TEST_THREADS; ix++)
+	{
+		sent += shared->stats[ix].remoteFreesSent;
+		received += shared->stats[ix].remoteFreesReceived;
+		assert(shared->stats[ix].remoteBatchesSent <= shared->stats[ix].remoteFreesSent);
+	}
+
+	assert(0 < sent && sent >= received);
+
+	pthread_barrier_destroy(&shared->barrier);
+	tcache_destroy(shared->cache);
+	free(shared);
+}
+
+/**
+ * Test harness for `lib/tcache_lib.c`.
+ * @return EXIT_SUCCESS when all tests pass. Assertion failure otherwise.
+ */
+int main(int argc, char *argv[])
+{
+	test_tcache_stack();
+
+	test_tcache_span();
+
+	test_tcache_alloc();
+
+	test_tcache_thread_release();
+
+	test_tcache_threads();
+
+	return EXIT_SUCCESS;
+}
@@ -1,5 +1,19 @@
 #include "lib/timsort_lib.h"
+#include "lib/timsortdata.h"
 #include <assert.h>
+#include <limits.h>
+
+typedef struct record
+{
+	uint64_t key;
+	uint32_t payload;
+} record_t;
+
+#define TIMSORT_TYPE record_t
+#define TIMSORT_SUFFIX record
+#define TIMSORT_LESS(a, b) ((a).key < (b).key)
+#define TIMSORT_LINKAGE static inline
+#include "lib/timsort_impl.h"
 
 bool arrEq(int arr_a[], int arr_b[], size_t lowerBound, size_t upperBound)
 {
@@ -14,6 +28,57 @@ bool arrEq(int arr_a[], int arr_b[], size_t lowerBound, size_t upperBound)
 	return true;
 }
 
+void test_binaryInsertionSort()
+{
+	int arr[] = {3, 5, 8, 9, 1, 7, 4, 9, 0, 2};
+	int expected[] = {3, 5, 8, 9, 0, 1, 2, 4, 7, 9};
+
+	// the sorted prefix arr[4 .. 6) is extended to cover arr[4 .. 10)
+	binaryInsertionSort(arr, 4, 6, 10);
+	assert(arrEq(arr, expected, 0, 9));
+
+	insertionSort(arr, 0, 9);
+	assert(isSorted(arr, 10));
+}
+
+void test_networkSort8()
+{
+	int arr[8];
+
+	// 0-1 principle: a network that sorts every sequence of 0s and 1s sorts every sequence
+	for (unsigned bits = 0; bits < 256; bits++)
+	{
+		for (size_t ix = 0; ix < 8; ix++)
+		{
+			arr[ix] = (bits >> ix) & 1;
+		}
+
+		networkSort8(arr);
+		assert(isSorted(arr, 8));
+	}
+}
+
+void test_networkSortRun()
+{
+	int arr[NETWORK_MAX_RUN + 2];
+	int expected[NETWORK_MAX_RUN + 2];
+
+	// every length up to the maximum, guard elements on both sides stay untouched
+	for (size_t length = 0; length <= NETWORK_MAX_RUN; length++)
+	{
+		for (size_t ix = 0; ix < length + 2; ix++)
+		{
+			arr[ix] = (int)((ix * 7919 + length) % 61) - 30;
+			expected[ix] = arr[ix];
+		}
+
+		networkSortRun(arr, 1, length + 1);
+		binaryInsertionSort(expected, 1, 1, length + 1);
+
+		assert(arrEq(arr, expected, 0, length + 1));
+	}
+}
+
 void test_merge()
 {
 	int input_arr_control[] = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10};
@@ -33,6 +98,151 @@ void test_merge()
 	return;
 }
 
+void test_gallop()
+{
+	int arr[] = {1, 2, 2, 2, 5, 8, 8, 13, 21, 34};
+	const size_t arr_length = 10;
+
+	// the result does not depend on where the search starts
+	for (size_t hint = 0; hint < arr_length; hint++)
+	{
+		assert(0 == gallopLeft(0, arr, arr_length, hint));
+		assert(1 == gallopLeft(2, arr, arr_length, hint));
+		assert(4 == gallopRight(2, arr, arr_length, hint));
+		assert(5 == gallopLeft(8, arr, arr_length, hint));
+		assert(7 == gallopRight(8, arr, arr_length, hint));
+		assert(10 == gallopRight(42, arr, arr_length, hint));
+	}
+}
+
+void test_merge_gallop()
+{
+	// long blocks of a single run force the merge into galloping mode
+	const size_t arr_length = 1024;
+	int *arr = malloc(arr_length * sizeof(int));
+
+	assert(NULL != arr);
+
+	for (size_t ix = 0; ix < arr_length / 2; ix++)
+	{
+		arr[ix] = (ix / 64) * 128 + (ix % 64);
+		arr[arr_length / 2 + ix] = (ix / 64) * 128 + 64 + (ix % 64);
+	}
+
+	merge(arr, 0, arr_length / 2, arr_length);
+
+	assert(isSorted(arr, arr_length));
+
+	free(arr);
+}
+
+void test_mergeLooksRandom()
+{
+	const size_t arr_length = 256;
+	int first[256];
+	int second[256];
+	uint32_t seed = 42;
+
+	// independent random values interleave randomly
+	for (size_t ix = 0; ix < arr_length; ix++)
+	{
+		seed = seed * 1664525u + 1013904223u;
+		first[ix] = (int)(seed >> 8);
+		seed = seed * 1664525u + 1013904223u;
+		second[ix] = (int)(seed >> 8);
+	}
+	insertionSort(first, 0, arr_length - 1);
+	insertionSort(second, 0, arr_length - 1);
+	assert(mergeLooksRandom(first, arr_length, second, arr_length));
+
+	// long blocks from either run
+	for (size_t ix = 0; ix < arr_length; ix++)
+	{
+		first[ix] = (int)((ix / 16) * 32 + ix % 16);
+		second[ix] = (int)((ix / 16) * 32 + 16 + ix % 16);
+	}
+	assert(!mergeLooksRandom(first, arr_length, second, arr_length));
+
+	// a strictly alternating merge changes run every time, but is perfectly predictable
+	for (size_t ix = 0; ix < arr_length; ix++)
+	{
+		first[ix] = (int)(2 * ix);
+		second[ix] = (int)(2 * ix + 1);
+	}
+	assert(!mergeLooksRandom(first, arr_length, second, arr_length));
+}
+
+void test_merge_branchless()
+{
+	const size_t arr_length = 20000;
+	int *keys = malloc(arr_length * sizeof(int));
+	int *values = malloc(arr_length * sizeof(int));
+	uint32_t seed = 7;
+
+	assert(NULL != keys && NULL != values);
+
+	// random keys with many duplicates: the merges take the branchless loop and must stay stable
+	for (size_t ix = 0; ix < arr_length; ix++)
+	{
+		seed = seed * 1664525u + 1013904223u;
+		keys[ix] = (int)((seed >> 8) % 1000);
+		values[ix] = (int)ix;
+	}
+
+	timSortKV(keys, values, arr_length);
+
+	assert(isSorted(keys, arr_length));
+	for (size_t ix = 1; ix < arr_length; ix++)
+	{
+		assert(keys[ix - 1] < keys[ix] || values[ix - 1] < values[ix]);
+	}
+
+	free(keys);
+	free(values);
+}
+
+void test_countRunAndMakeAscending()
+{
+	int arr[] = {9, 7, 4, 1, 5, 5, 2};
+	int expected[] = {1, 4, 7, 9, 5, 5, 2};
+	const size_t arr_length = 7;
+
+	assert(4 == countRunAndMakeAscending(arr, 0, arr_length));
+	assert(arrEq(arr, expected, 0, 3));
+
+	// equal neighbours end a descending run, so that the reversal stays stable
+	assert(6 == countRunAndMakeAscending(arr, 4, arr_length));
+	assert(arrEq(arr, expected, 4, 6));
+}
+
+void test_minRunLength()
+{
+	// short arrays are a single run
+	assert(0 == minRunLength(0));
+	assert(63 == minRunLength(63));
+
+	// powers of two split into runs of exactly `RUN_LENGTH`
+	assert(32 == minRunLength(64));
+	assert(32 == minRunLength(1 << 20));
+
+	// otherwise the run length is rounded up to keep the number of runs below a power of two
+	assert(33 == minRunLength(65));
+	assert(62 == minRunLength(1000000));
+}
+
+void test_nodePower()
+{
+	// the halves of an array meet at the root of the merge tree
+	assert(1 == nodePower(0, 4, 4, 8));
+
+	// quarters meet one level down, on either side of the root
+	assert(2 == nodePower(0, 2, 2, 8));
+	assert(2 == nodePower(4, 2, 2, 8));
+
+	// uneven runs: the midpoints 1.5 and 5 of [0, 3) and [3, 7) are split by the root
+	assert(1 == nodePower(0, 3, 4, 8));
+}
+
 void test_isSorted()
 {
 	// positive cases
@@ -51,6 +261,75 @@ void test_isSorted()
 	assert(!isSorted(sorted_array_small, 10));
 }
 
+void test_isSorted_blocks()
+{
+	const size_t arr_length = 3 * SORTED_CHECK_BLOCK + 5;
+	int arr[3 * SORTED_CHECK_BLOCK + 5];
+
+	for (size_t ix = 0; ix < arr_length; ix++)
+	{
+		arr[ix] = (int)ix;
+	}
+	assert(isSorted(arr, arr_length));
+
+	// a single descent is found wherever it lies, in a block or in the tail
+	for (size_t ix = 1; ix < arr_length; ix++)
+	{
+		arr[ix] = arr[ix - 1] - 1;
+		assert(!isSorted(arr, arr_length));
+		assert(isSorted(arr, ix));
+		arr[ix] = (int)ix;
+	}
+}
+
+void test_sortProfile()
+{
+	int arr[] = {3, 4, 4, 9, 8, 7, 1, 2, 5, -6, 10};
+	sort_profile_t profile;
+
+	// runs {3, 4, 4, 9} {8} {7} {1, 2, 5} {-6, 10}, descents 9 > 8 > 7 > 1 and 5 > -6
+	sortProfile(arr, 11, &profile);
+	assert(11 == profile.length);
+	assert(5 == profile.runs && 4 == profile.longestRun && 2 == profile.descendingRuns);
+	assert(-6 == profile.minValue && 10 == profile.maxValue);
+	assert(PROFILE_SAMPLES == profile.sampledPairs);
+	assert(profile.sampledInversions > 0 && profile.sampledInversions < PROFILE_SAMPLES);
+
+	sortProfile(arr, 0, &profile);
+	assert(0 == profile.runs && 0 == profile.longestRun && 0 == profile.sampledPairs);
+
+	sortProfile(arr, 1, &profile);
+	assert(1 == profile.runs && 1 == profile.longestRun && 3 == profile.maxValue);
+
+	const size_t arr_length = 10000;
+	int *data = malloc(arr_length * sizeof(int));
+	assert(NULL != data);
+
+	// sorted: a single run, no inversions
+	for (size_t ix = 0; ix < arr_length; ix++)
+	{
+		data[ix] = (int)ix;
+	}
+	sortProfile(data, arr_length, &profile);
+	assert(1 == profile.runs && arr_length == profile.longestRun);
+	assert(0 == profile.descendingRuns && 0 == profile.inversions);
+
+	// strictly descending: every element is a run, every pair is inverted
+	reverseRange(data, 0, arr_length);
+	sortProfile(data, arr_length, &profile);
+	assert(arr_length == profile.runs && 1 == profile.longestRun);
+	assert(1 == profile.descendingRuns && PROFILE_SAMPLES == profile.sampledInversions);
+	assert((uint64_t)arr_length * (arr_length - 1) / 2 == profile.inversions);
+
+	// random: about half of the pairs are inverted
+	dataFill(data, arr_length, DATA_UNIFORM, 0, DATA_SEED);
+	sortProfile(data, arr_length, &profile);
+	assert(profile.sampledInversions > PROFILE_SAMPLES / 3);
+	assert(profile.sampledInversions < 2 * PROFILE_SAMPLES / 3);
+
+	free(data);
+}
+
 void test_timsort()
 {
 	int data[] = {10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1};
@@ -78,6 +357,729 @@ void test_timsort()
 	// clean up
 	free(arr);
 }
+void test_timSortSetRunLength()
+{
+	const size_t arr_length = 1000;
+	int *arr = malloc(arr_length * sizeof(int));
+
+	assert(NULL != arr);
+
+	for (size_t run_length = 32; run_length <= 128; run_length *= 2)
+	{
+		for (size_t ix = 0; ix < arr_length; ix++)
+		{
+			arr[ix] = (ix * 7919) % arr_length;
+		}
+
+		timSortSetRunLength(run_length);
+		timSort(arr, arr_length);
+
+		assert(isSorted(arr, arr_length));
+	}
+
+	// back to the default
+	timSortSetRunLength(0);
+
+	free(arr);
+}
+
+void test_timSortWithBuffer()
+{
+	int data[] = {10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1};
+	int expected[] = {10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1};
+	const size_t arr_length = 20;
+	int scratch[10];
+
+	// a buffer that is too short is rejected before any work is done
+	assert(!timSortWithBuffer(data, arr_length, scratch, timSortBufferLength(arr_length) - 1));
+	assert(arrEq(data, expected, 0, arr_length - 1));
+
+	// half the input length is always enough
+	assert(timSortWithBuffer(data, arr_length, scratch, timSortBufferLength(arr_length)));
+	assert(isSorted(data, arr_length));
+
+	// and the buffer can be reused
+	data[0] = 42;
+	assert(timSortWithBuffer(data, arr_length, scratch, timSortBufferLength(arr_length)));
+	assert(isSorted(data, arr_length));
+}
+
+void test_timSortSetMergePolicy()
+{
+	const size_t arr_length = 5000;
+	int *arr = malloc(arr_length * sizeof(int));
+	merge_policy_t policies[] = {MERGE_POLICY_BOTTOM_UP, MERGE_POLICY_TIMSORT,
+								 MERGE_POLICY_POWERSORT};
+
+	assert(NULL != arr);
+
+	for (size_t ix_policy = 0; ix_policy < 3; ix_policy++)
+	{
+		// natural runs of uneven length: 1, 2, 3, ... elements, alternating direction
+		size_t run = 1;
+		size_t in_run = 0;
+		for (size_t ix = 0; ix < arr_length; ix++)
+		{
+			arr[ix] = (run % 2) ? (int)(ix % 97) : -(int)in_run;
+
+			if (++in_run == run)
+			{
+				run++;
+				in_run = 0;
+			}
+		}
+
+		timSortSetMergePolicy(policies[ix_policy]);
+		timSort(arr, arr_length);
+
+		assert(isSorted(arr, arr_length));
+	}
+
+	// back to the default
+	timSortSetMergePolicy(MERGE_POLICY_POWERSORT);
+
+	free(arr);
+}
+
+void test_timSort_typed()
+{
+	const size_t arr_length = 3000;
+	int64_t *arr_i64 = malloc(arr_length * sizeof(int64_t));
+	uint32_t *arr_u32 = malloc(arr_length * sizeof(uint32_t));
+	double *arr_f64 = malloc(arr_length * sizeof(double));
+
+	assert(NULL != arr_i64 && NULL != arr_u32 && NULL != arr_f64);
+
+	// values that do not fit, or do not order the same, in an int
+	for (size_t ix = 0; ix < arr_length; ix++)
+	{
+		arr_i64[ix] = ((int64_t)(ix * 7919 % arr_length) - 1500) * 4000000000LL;
+		arr_u32[ix] = (uint32_t)(ix * 2654435761u);
+		arr_f64[ix] = ((double)(ix * 7919 % arr_length) - 1500.0) / 7.0;
+	}
+
+	timSort_i64(arr_i64, arr_length);
+	timSort_u32(arr_u32, arr_length);
+	timSort_f64(arr_f64, arr_length);
+
+	assert(isSorted_i64(arr_i64, arr_length));
+	assert(isSorted_u32(arr_u32, arr_length));
+	assert(isSorted_f64(arr_f64, arr_length));
+	assert(arr_i64[0] < 0 && arr_u32[arr_length - 1] > 0x80000000u && arr_f64[0] < 0.0);
+
+	free(arr_i64);
+	free(arr_u32);
+	free(arr_f64);
+}
+
+void test_timSort_record()
+{
+	const size_t arr_length = 1000;
+	record_t *arr = malloc(arr_length * sizeof(record_t));
+
+	assert(NULL != arr);
+
+	// few distinct keys, so that stability is visible in the payloads
+	for (size_t ix = 0; ix < arr_length; ix++)
+	{
+		arr[ix].key = (ix * 7) % 13;
+		arr[ix].payload = (uint32_t)ix;
+	}
+
+	timSort_record(arr, arr_length);
+
+	for (size_t ix = 1; ix < arr_length; ix++)
+	{
+		assert(arr[ix - 1].key <= arr[ix].key);
+		assert(arr[ix - 1].key < arr[ix].key || arr[ix - 1].payload < arr[ix].payload);
+	}
+
+	free(arr);
+}
+
+void test_timSortKV()
+{
+	const size_t arr_length = 2000;
+	int *keys = malloc(arr_length * sizeof(int));
+	int *values = malloc(arr_length * sizeof(int));
+
+	assert(NULL != keys && NULL != values);
+
+	// few distinct keys, descending stretches included, so that stability is visible in the values
+	for (size_t ix = 0; ix < arr_length; ix++)
+	{
+		keys[ix] = (ix % 300 < 100) ? (int)(300 - ix % 300) % 11 : (int)(ix * 7919 % 23);
+		values[ix] = (int)ix;
+	}
+
+	timSortKV(keys, values, arr_length);
+
+	assert(isSorted(keys, arr_length));
+	for (size_t ix = 1; ix < arr_length; ix++)
+	{
+		assert(keys[ix - 1] < keys[ix] || values[ix - 1] < values[ix]);
+	}
+
+	// every value still sits next to its own key
+	for (size_t ix = 0; ix < arr_length; ix++)
+	{
+		size_t origin = (size_t)values[ix];
+		int key = (origin % 300 < 100) ? (int)(300 - origin % 300) % 11 : (int)(origin * 7919 % 23);
+
+		assert(key == keys[ix]);
+	}
+
+	free(keys);
+	free(values);
+}
+
+void test_timArgSort()
+{
+	int keys[] = {5, 3, 9, 3, 1, 5, 0, 3};
+	int expected_keys[] = {5, 3, 9, 3, 1, 5, 0, 3};
+	size_t order[8];
+	size_t expected_order[] = {6, 4, 1, 3, 7, 0, 5, 2};
+	const size_t arr_length = 8;
+
+	timArgSort(keys, order, arr_length);
+
+	// the keys are left untouched and equal keys keep their original order
+	assert(arrEq(keys, expected_keys, 0, arr_length - 1));
+	for (size_t ix = 0; ix < arr_length; ix++)
+	{
+		assert(expected_order[ix] == order[ix]);
+	}
+}
+
+void test_mergeCoRank()
+{
+	int first[] = {1, 3, 3, 5};
+	int second[] = {2, 3, 4};
+
+	// merged: 1 2 3(f) 3(f) 3(s) 4 5, ties are taken from `first` first
+	assert(0 == mergeCoRank(0, first, 4, second, 3));
+	assert(1 == mergeCoRank(2, first, 4, second, 3));
+	assert(3 == mergeCoRank(4, first, 4, second, 3));
+	assert(3 == mergeCoRank(6, first, 4, second, 3));
+	assert(4 == mergeCoRank(7, first, 4, second, 3));
+}
+
+void test_timSortParallel()
+{
+	const size_t arr_length = 50000;
+	int *arr = malloc(arr_length * sizeof(int));
+	int *expected = malloc(arr_length * sizeof(int));
+	size_t threads[] = {1, 2, 3, 4, 5, 8, 16};
+
+	assert(NULL != arr && NULL != expected);
+
+	for (size_t ix = 0; ix < arr_length; ix++)
+	{
+		expected[ix] = (int)((ix * 7919) % 1013) - 500;
+	}
+	timSort(expected, arr_length);
+
+	for (size_t ix_threads = 0; ix_threads < 7; ix_threads++)
+	{
+		for (size_t ix = 0; ix < arr_length; ix++)
+		{
+			arr[ix] = (int)((ix * 7919) % 1013) - 500;
+		}
+
+		timSortParallel(arr, arr_length, threads[ix_threads]);
+
+		assert(arrEq(arr, expected, 0, arr_length - 1));
+	}
+
+	free(arr);
+	free(expected);
+}
+
+void test_mergeK()
+{
+	const size_t max_k = 33;
+	const size_t arr_length = 50 * max_k;
+	int *arr = malloc(arr_length * sizeof(int));
+	int *out = malloc(arr_length * sizeof(int));
+	int *expected = malloc(arr_length * sizeof(int));
+	sorted_run_t runs[max_k];
+	size_t ks[] = {1, 2, 3, 5, 8, 17, 33};
+
+	assert(NULL != arr && NULL != out && NULL != expected);
+
+	for (size_t ix_k = 0; ix_k < 7; ix_k++)
+	{
+		size_t k = ks[ix_k];
+		size_t length = 0;
+
+		// runs of uneven length, the first one empty, with many duplicates across runs
+		dataFill(arr, arr_length, DATA_FEW_DISTINCT, 20, DATA_SEED + k);
+		for (size_t ix = 0; ix < k; ix++)
+		{
+			runs[ix].data = &arr[length];
+			runs[ix].length = (ix * 37) % 50;
+			timSort(runs[ix].data, runs[ix].length);
+			length += runs[ix].length;
+		}
+
+		memcpy(expected, arr, length * sizeof(int));
+		timSort(expected, length);
+
+		mergeK(runs, k, out);
+
+		assert((0 == length) || arrEq(out, expected, 0, length - 1));
+	}
+
+	free(expected);
+	free(out);
+	free(arr);
+}
+
+/**
+ * Input of `test_mergeKStream`: the rest of a sorted array.
+ */
+typedef struct stream_cursor
+{
+	int *data;
+	size_t length;
+} stream_cursor_t;
+
+size_t streamRead(void *context, int buffer[], size_t capacity)
+{
+	stream_cursor_t *cursor = context;
+	size_t count = (cursor->length < capacity) ? cursor->length : capacity;
+
+	memcpy(buffer, cursor->data, count * sizeof(int));
+	cursor->data += count;
+	cursor->length -= count;
+
+	return count;
+}
+
+void streamWrite(void *context, const int buffer[], size_t length)
+{
+	stream_cursor_t *cursor = context;
+
+	memcpy(&cursor->data[cursor->length], buffer, length * sizeof(int));
+	cursor->length += length;
+}
+
+void test_mergeKStream()
+{
+	const size_t k = 7;
+	const size_t arr_length = 1000;
+	int *arr = malloc(arr_length * sizeof(int));
+	int *out = malloc(arr_length * sizeof(int));
+	int *expected = malloc(arr_length * sizeof(int));
+	stream_cursor_t cursors[k];
+	merge_source_t sources[k];
+	size_t block_lengths[] = {1, 3, 64, 4096};
+
+	assert(NULL != arr && NULL != out && NULL != expected);
+
+	dataFill(arr, arr_length, DATA_UNIFORM, 0, DATA_SEED);
+	for (size_t ix = 0; ix < k; ix++)
+	{
+		timSort(&arr[ix * arr_length / k], (ix + 1) * arr_length / k - ix * arr_length / k);
+	}
+
+	memcpy(expected, arr, arr_length * sizeof(int));
+	timSort(expected, arr_length);
+
+	for (size_t ix_block = 0; ix_block < 4; ix_block++)
+	{
+		stream_cursor_t output = {out, 0};
+
+		for (size_t ix = 0; ix < k; ix++)
+		{
+			cursors[ix].data = &arr[ix * arr_length / k];
+			cursors[ix].length = (ix + 1) * arr_length / k - ix * arr_length / k;
+			sources[ix].read = streamRead;
+			sources[ix].context = &cursors[ix];
+		}
+
+		assert(arr_length ==
+			   mergeKStream(sources, k, streamWrite, &output, block_lengths[ix_block]));
+		assert(arr_length == output.length);
+		assert(arrEq(out, expected, 0, arr_length - 1));
+	}
+
+	free(expected);
+	free(out);
+	free(arr);
+}
+
+void test_radixSort()
+{
+	const size_t arr_length = 5000;
+	int *arr = malloc(arr_length * sizeof(int));
+	int *expected = malloc(arr_length * sizeof(int));
+	size_t digitBits[] = {1, 5, 8, 11, 16};
+
+	assert(NULL != arr && NULL != expected);
+
+	for (size_t ix_bits = 0; ix_bits < 5; ix_bits++)
+	{
+		// full range with negative values, then keys that only differ in their low bits
+		for (size_t ix_data = 0; ix_data < 2; ix_data++)
+		{
+			dataFill(arr, arr_length, DATA_UNIFORM, 0, DATA_SEED + ix_data);
+			for (size_t ix = 0; (1 == ix_data) && (ix < arr_length); ix++)
+			{
+				arr[ix] = -1000 + (arr[ix] & 0x3FF);
+			}
+			arr[0] = INT_MIN;
+			arr[1] = INT_MAX;
+
+			memcpy(expected, arr, arr_length * sizeof(int));
+			timSort(expected, arr_length);
+
+			radixSort(arr, arr_length, digitBits[ix_bits]);
+			assert(0 == memcmp(arr, expected, arr_length * sizeof(int)));
+		}
+	}
+
+	// a single value: every digit is skipped
+	for (size_t ix = 0; ix < arr_length; ix++)
+	{
+		arr[ix] = -7;
+	}
+	radixSort(arr, arr_length, 8);
+	assert(-7 == arr[0] && -7 == arr[arr_length - 1]);
+
+	free(expected);
+	free(arr);
+}
+
+void test_countingSort()
+{
+	int arr[] = {3, -2, 3, 0, 1, -2, 2};
+	int expected[] = {-2, -2, 0, 1, 2, 3, 3};
+
+	countingSort(arr, 7, -2, 3);
+	assert(0 == memcmp(arr, expected, sizeof(expected)));
+
+	// at both ends of the int range
+	int low[] = {INT_MIN + 1, INT_MIN, INT_MIN};
+	int high[] = {INT_MAX, INT_MAX - 2, INT_MAX - 1};
+
+	countingSort(low, 3, INT_MIN, INT_MIN + 1);
+	assert(INT_MIN == low[0] && INT_MIN == low[1] && INT_MIN + 1 == low[2]);
+
+	countingSort(high, 3, INT_MAX - 2, INT_MAX);
+	assert(INT_MAX - 2 == high[0] && INT_MAX - 1 == high[1] && INT_MAX == high[2]);
+}
+
+void test_timSortChoose()
+{
+	sort_thresholds_t thresholds;
+	sort_profile_t profile = {.length = 100000,
+							  .runs = 50000,
+							  .longestRun = 4,
+							  .descendingRuns = 25000,
+							  .sampledPairs = 256,
+							  .sampledInversions = 128,
+							  .minValue = -1000000,
+							  .maxValue = 1000000};
+
+	timSortSetThresholds(NULL);
+	timSortGetThresholds(&thresholds);
+
+	assert(SORT_ALGORITHM_RADIX == timSortChoose(&profile));
+
+	// few long runs, in either direction
+	profile.descendingRuns = 10;
+	assert(SORT_ALGORITHM_TIMSORT == timSortChoose(&profile));
+	profile.descendingRuns = 25000;
+
+	// values span a small range
+	profile.minValue = -100;
+	profile.maxValue = 100;
+	assert(SORT_ALGORITHM_COUNTING == timSortChoose(&profile));
+
+	// a range longer than the array
+	profile.length = 150;
+	thresholds.minLength = 100;
+	timSortSetThresholds(&thresholds);
+	assert(SORT_ALGORITHM_RADIX == timSortChoose(&profile));
+	profile.length = 100000;
+
+	// short arrays, and inversion test
+	thresholds.minLength = 200000;
+	timSortSetThresholds(&thresholds);
+	assert(SORT_ALGORITHM_TIMSORT == timSortChoose(&profile));
+
+	timSortSetThresholds(NULL);
+	timSortGetThresholds(&thresholds);
+	thresholds.maxInversionPercent = 60;
+	timSortSetThresholds(&thresholds);
+	assert(SORT_ALGORITHM_TIMSORT == timSortChoose(&profile));
+
+	timSortSetThresholds(NULL);
+	timSortGetThresholds(&thresholds);
+	assert(1024 == thresholds.minLength && 0 == thresholds.maxInversionPercent);
+}
+
+/**
+ * Input of `test_timSortAdaptive`, and the algorithm it should be sorted with.
+ */
+typedef struct adaptive_case
+{
+	data_distribution_t distribution;
+	size_t param;
+	sort_algorithm_t algorithm;
+} adaptive_case_t;
+
+void test_timSortAdaptive()
+{
+	const size_t arr_length = 100000;
+	int *arr = malloc(arr_length * sizeof(int));
+	int *expected = malloc(arr_length * sizeof(int));
+	const adaptive_case_t cases[] = {{DATA_UNIFORM, 0, SORT_ALGORITHM_RADIX},
+									 {DATA_SORTED, 0, SORT_ALGORITHM_TIMSORT},
+									 {DATA_REVERSED, 0, SORT_ALGORITHM_TIMSORT},
+									 {DATA_SAWTOOTH, 1024, SORT_ALGORITHM_TIMSORT},
+									 {DATA_FEW_DISTINCT, 16, SORT_ALGORITHM_COUNTING},
+									 {DATA_ORGAN_PIPE, 0, SORT_ALGORITHM_TIMSORT},
+									 {DATA_K_SORTED, 64, SORT_ALGORITHM_RADIX},
+									 {DATA_ZIPF, 1 << 12, SORT_ALGORITHM_COUNTING},
+									 {DATA_RUNS, 4096, SORT_ALGORITHM_TIMSORT}};
+
+	assert(NULL != arr && NULL != expected);
+	timSortSetThresholds(NULL);
+
+	for (size_t ix = 0; ix < sizeof(cases) / sizeof(cases[0]); ix++)
+	{
+		dataFill(arr, arr_length, cases[ix].distribution, cases[ix].param, DATA_SEED);
+		memcpy(expected, arr, arr_length * sizeof(int));
+		timSort(expected, arr_length);
+
+		assert(cases[ix].algorithm == timSortAdaptive(arr, arr_length));
+		assert(0 == memcmp(arr, expected, arr_length * sizeof(int)));
+	}
+
+	// short arrays are not profiled
+	dataFill(arr, 1000, DATA_UNIFORM, 0, DATA_SEED);
+	assert(SORT_ALGORITHM_TIMSORT == timSortAdaptive(arr, 1000));
+	assert(isSorted(arr, 1000));
+
+	free(expected);
+	free(arr);
+}
+
+void test_timNthElement()
+{
+	const size_t arr_length = 10000;
+	int *arr = malloc(arr_length * sizeof(int));
+	int *sorted = malloc(arr_length * sizeof(int));
+	size_t positions[] = {0, 1, 31, 32, 4999, 5000, 9998, 9999};
+
+	assert(NULL != arr && NULL != sorted);
+
+	// random, few distinct values, sorted and reversed inputs
+	for (size_t ix_data = 0; ix_data < 4; ix_data++)
+	{
+		data_distribution_t distributions[] = {DATA_UNIFORM, DATA_FEW_DISTINCT, DATA_SORTED,
+											   DATA_REVERSED};
+
+		dataFill(sorted, arr_length, distributions[ix_data], 8, DATA_SEED);
+		timSort(sorted, arr_length);
+
+		for (size_t ix_pos = 0; ix_pos < 8; ix_pos++)
+		{
+			size_t nth = positions[ix_pos];
+
+			dataFill(arr, arr_length, distributions[ix_data], 8, DATA_SEED);
+			timNthElement(arr, arr_length, nth);
+
+			assert(sorted[nth] == arr[nth]);
+			for (size_t ix = 0; ix < arr_length; ix++)
+			{
+				assert((ix < nth) ? arr[ix] <= arr[nth] : arr[ix] >= arr[nth]);
+			}
+		}
+	}
+
+	// out of the array: untouched
+	int small[] = {3, 1, 2};
+	timNthElement(small, 3, 3);
+	assert(3 == small[0] && 1 == small[1] && 2 == small[2]);
+
+	free(sorted);
+	free(arr);
+}
+
+void test_timPartialSort()
+{
+	const size_t arr_length = 5000;
+	int *arr = malloc(arr_length * sizeof(int));
+	int *sorted = malloc(arr_length * sizeof(int));
+	size_t ks[] = {0, 1, 10, 100, 4999, 5000, 6000};
+
+	assert(NULL != arr && NULL != sorted);
+
+	dataFill(sorted, arr_length, DATA_UNIFORM, 0, DATA_SEED);
+	timSort(sorted, arr_length);
+
+	for (size_t ix_k = 0; ix_k < 7; ix_k++)
+	{
+		size_t k = min(ks[ix_k], arr_length);
+
+		dataFill(arr, arr_length, DATA_UNIFORM, 0, DATA_SEED);
+		timPartialSort(arr, arr_length, ks[ix_k]);
+		assert(0 == memcmp(arr, sorted, k * sizeof(int)));
+
+		// the rest holds the other elements
+		timSort(&arr[k], arr_length - k);
+		assert(0 == memcmp(arr, sorted, arr_length * sizeof(int)));
+	}
+
+	free(sorted);
+	free(arr);
+}
+
+void test_timTopK()
+{
+	const size_t arr_length = 5000;
+	int *arr = malloc(arr_length * sizeof(int));
+	int *sorted = malloc(arr_length * sizeof(int));
+	int *out = malloc(arr_length * sizeof(int));
+	size_t ks[] = {1, 2, 10, 100, 4999, 5000};
+
+	assert(NULL != arr && NULL != sorted && NULL != out);
+
+	dataFill(arr, arr_length, DATA_ZIPF, 100, DATA_SEED);
+	memcpy(sorted, arr, arr_length * sizeof(int));
+	timSort(sorted, arr_length);
+
+	for (size_t ix_k = 0; ix_k < 6; ix_k++)
+	{
+		timTopK(arr, arr_length, ks[ix_k], out);
+		assert(0 == memcmp(out, sorted, ks[ix_k] * sizeof(int)));
+	}
+
+	// `arr` is left untouched, and k above the length selects everything
+	assert(!isSorted(arr, arr_length));
+	timTopK(arr, 3, 10, out);
+	assert(isSorted(out, 3));
+
+	free(out);
+	free(sorted);
+	free(arr);
+}
+
+void test_timArgTopK()
+{
+	int keys[] = {5, 1, 3, 1, 3, 0, 3, 9};
+	size_t order[8];
+	size_t expected[] = {5, 1, 3, 2, 4, 6, 0, 7};
+
+	// ties are taken by position, the 3 at position 6 does not fit
+	timArgTopK(keys, 8, 5, order);
+	assert(0 == memcmp(order, expected, 5 * sizeof(size_t)));
+
+	timArgTopK(keys, 8, 8, order);
+	assert(0 == memcmp(order, expected, 8 * sizeof(size_t)));
+
+	// same as the prefix of a stable argsort
+	const size_t arr_length = 3000;
+	int *arr = malloc(arr_length * sizeof(int));
+	size_t *all = malloc(arr_length * sizeof(size_t));
+	size_t *top = malloc(arr_length * sizeof(size_t));
+
+	assert(NULL != arr && NULL != all && NULL != top);
+
+	dataFill(arr, arr_length, DATA_FEW_DISTINCT, 50, DATA_SEED);
+	timArgSort(arr, all, arr_length);
+
+	for (size_t k = 1; k <= arr_length; k += 333)
+	{
+		timArgTopK(arr, arr_length, k, top);
+		assert(0 == memcmp(top, all, k * sizeof(size_t)));
+	}
+
+	free(top);
+	free(all);
+	free(arr);
+}
+
+void test_dataFill()
+{
+	const size_t arr_length = 3 * DATA_BLOCK_LENGTH + 1234;
+	int *arr = malloc(arr_length * sizeof(int));
+	int *expected = malloc(arr_length * sizeof(int));
+	data_distribution_t distributions[] = {DATA_UNIFORM,	  DATA_K_SORTED, DATA_ZIPF,
+										   DATA_FEW_DISTINCT, DATA_RUNS,	 DATA_SAWTOOTH};
+
+	assert(NULL != arr && NULL != expected);
+
+	// the data only depends on the seed, not on the number of threads
+	for (size_t ix_distribution = 0; ix_distribution < 6; ix_distribution++)
+	{
+		dataFill(expected, arr_length, distributions[ix_distribution], 100, 42);
+
+		for (size_t threads = 1; threads <= 5; threads += 2)
+		{
+			dataFillParallel(arr, arr_length, distributions[ix_distribution], 100, 42, threads);
+			assert(arrEq(arr, expected, 0, arr_length - 1));
+		}
+	}
+
+	// k-sorted: sorting moves no element by more than k positions
+	dataFill(arr, arr_length, DATA_K_SORTED, 16, 7);
+	assert(!isSorted(arr, arr_length));
+	timSort(arr, arr_length);
+	for (size_t ix = 0; ix < arr_length; ix++)
+	{
+		assert(arr[ix] >= (int)ix && arr[ix] < (int)ix + 16);
+	}
+
+	// few distinct and Zipf values stay below the parameter, small Zipf values are the most common
+	size_t zeros = 0;
+	dataFill(arr, arr_length, DATA_ZIPF, 1000, 7);
+	for (size_t ix = 0; ix < arr_length; ix++)
+	{
+		assert(arr[ix] >= 0 && arr[ix] < 1000);
+		zeros += (0 == arr[ix]);
+	}
+	assert(zeros > arr_length / 20);
+
+	free(arr);
+	free(expected);
+}
+
+int compareRecords(const void *a, const void *b)
+{
+	const record_t *first = a;
+	const record_t *second = b;
+
+	return (first->key > second->key) - (first->key < second->key);
+}
+
+void test_timSortQsort()
+{
+	const size_t arr_length = 1000;
+	record_t *arr = malloc(arr_length * sizeof(record_t));
+
+	assert(NULL != arr);
+
+	for (size_t ix = 0; ix < arr_length; ix++)
+	{
+		arr[ix].key = (arr_length - ix) % 17;
+		arr[ix].payload = (uint32_t)ix;
+	}
+
+	timSortQsort(arr, arr_length, sizeof(record_t), compareRecords);
+
+	for (size_t ix = 1; ix < arr_length; ix++)
+	{
+		assert(arr[ix - 1].key <= arr[ix].key);
+		assert(arr[ix - 1].key < arr[ix].key || arr[ix - 1].payload < arr[ix].payload);
+	}
+
+	free(arr);
+}
+
 /**
  * Test harness for `timsort.c`.
  * @return EXIT_SUCCESS when all tests pass. EXIT_FAILURE otherwise
@@ -86,9 +1088,75 @@ int main(int argc, char *argv[])
 {
 	test_isSorted();
 
+	test_isSorted_blocks();
+
+	test_sortProfile();
+
+	test_gallop();
+
+	test_binaryInsertionSort();
+
+	test_networkSort8();
+
+	test_networkSortRun();
+
 	test_merge();
 
+	test_merge_gallop();
+
+	test_mergeLooksRandom();
+
+	test_merge_branchless();
+
+	test_countRunAndMakeAscending();
+
+	test_minRunLength();
+
+	test_nodePower();
+
 	test_timsort();
 
+	test_timSortSetRunLength();
+
+	test_timSortSetMergePolicy();
+
+	test_timSortWithBuffer();
+
+	test_timSort_typed();
+
+	test_timSort_record();
+
+	test_timSortQsort();
+
+	test_timSortKV();
+
+	test_timArgSort();
+
+	test_mergeCoRank();
+
+	test_timSortParallel();
+
+	test_mergeK();
+
+	test_mergeKStream();
+
+	test_radixSort();
+
+	test_countingSort();
+
+	test_timSortChoose();
+
+	test_timSortAdaptive();
+
+	test_timNthElement();
+
+	test_timPartialSort();
+
+	test_timTopK();
+
+	test_timArgTopK();
+
+	test_dataFill();
+
 	return EXIT_SUCCESS;
 }
@@ -18,6 +18,20 @@ bool arrEq(int arr_a[], int arr_b[])
 	return true;
 }
 
+void test_binaryInsertionSort()
+{
+	int arr[] = {3, 5, 8, 9, 1, 7, 4, 9, 0, 2};
+
+	// the sorted prefix arr[4 .. 6) is extended to cover arr[4 .. 10)
+	int *arr_base_length_set = cheri_bounds_set(&arr[4], 6 * sizeof(int));
+	binaryInsertionSort(cheri_offset_set(arr_base_length_set, 2 * sizeof(int)));
+	assert(0 == arr[4] && 1 == arr[5] && 2 == arr[6] && 4 == arr[7] && 7 == arr[8] && 9 == arr[9]);
+	assert(3 == arr[0] && 9 == arr[3]);
+
+	insertionSort(arr);
+	assert(isSorted(arr));
+}
+
 void test_merge()
 {
 	int input_arr_control[] = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10};
@@ -44,6 +58,84 @@ void test_merge()
 	return;
 }
 
+void test_gallop()
+{
+	int arr[] = {1, 2, 2, 2, 5, 8, 8, 13, 21, 34};
+	const size_t arr_length = 10;
+
+	// the result does not depend on where the search starts
+	for (size_t hint = 0; hint < arr_length; hint++)
+	{
+		assert(0 == gallopLeft(0, arr, hint));
+		assert(1 == gallopLeft(2, arr, hint));
+		assert(4 == gallopRight(2, arr, hint));
+		assert(5 == gallopLeft(8, arr, hint));
+		assert(7 == gallopRight(8, arr, hint));
+		assert(10 == gallopRight(42, arr, hint));
+	}
+}
+
+void test_merge_gallop()
+{
+	// long blocks of a single run force the merge into galloping mode
+	const size_t arr_length = 1024;
+	int *arr = malloc(arr_length * sizeof(int));
+
+	assert(NULL != arr);
+
+	for (size_t ix = 0; ix < arr_length / 2; ix++)
+	{
+		arr[ix] = (ix / 64) * 128 + (ix % 64);
+		arr[arr_length / 2 + ix] = (ix / 64) * 128 + 64 + (ix % 64);
+	}
+
+	merge(cheri_offset_set(arr, (arr_length / 2) * sizeof(int)));
+
+	assert(isSorted(arr));
+
+	free(arr);
+}
+
+void test_countRunAndMakeAscending()
+{
+	int arr[] = {9, 7, 4, 1, 5, 5, 2};
+
+	assert(4 == countRunAndMakeAscending(arr));
+	assert(1 == arr[0] && 4 == arr[1] && 7 == arr[2] && 9 == arr[3]);
+
+	// equal neighbours end a descending run, so that the reversal stays stable
+	assert(2 == countRunAndMakeAscending(cheri_bounds_set(&arr[4], 3 * sizeof(int))));
+	assert(5 == arr[4] && 5 == arr[5] && 2 == arr[6]);
+}
+
+void test_minRunLength()
+{
+	// short arrays are a single run
+	assert(0 == minRunLength(0));
+	assert(63 == minRunLength(63));
+
+	// powers of two split into runs of exactly `RUN_LENGTH`
+	assert(32 == minRunLength(64));
+	assert(32 == minRunLength(1 << 20));
+
+	// otherwise the run length is rounded up to keep the number of runs below a power of two
+	assert(33 == minRunLength(65));
+	assert(62 == minRunLength(1000000));
+}
+
+void test_nodePower()
+{
+	// the halves of an array meet at the root of the merge tree
+	assert(1 == nodePower(0, 4, 4, 8));
+
+	// quarters meet one level down, on either side of the root
+	assert(2 == nodePower(0, 2, 2, 8));
+	assert(2 == nodePower(4, 2, 2, 8));
+
+	// uneven runs: the midpoints 1.5 and 5 of [0, 3) and [3, 7) are split by the root
+	assert(1 == nodePower(0, 3, 4, 8));
+}
+
 void test_isSorted()
 {
 	// positive cases
@@ -60,12 +152,28 @@ void test_isSorted()
 	// negative cases
 	sorted_array_small[5] = 42;
 	assert(!isSorted(sorted_array_small));
+	// descents in the blocks of compares and in the tail
+	int sorted_array_blocks[3 * SORTED_CHECK_BLOCK + 5];
+	const size_t blocks_length = 3 * SORTED_CHECK_BLOCK + 5;
+
+	for (size_t ix = 0; ix < blocks_length; ix++)
+	{
+		sorted_array_blocks[ix] = (int)ix;
+	}
+	assert(isSorted(sorted_array_blocks));
+
+	for (size_t ix = 1; ix < blocks_length; ix++)
+	{
+		sorted_array_blocks[ix] = sorted_array_blocks[ix - 1] - 1;
+		assert(!isSorted(sorted_array_blocks));
+		sorted_array_blocks[ix] = (int)ix;
+	}
 }
 
 void test_timsort()
 {
 
-	int *arr = random_chunk(8192);
+	int *arr = random_chunk(8192, DATA_SEED);
 	// place the chunk of data on the heap
 	assert(NULL != arr);
 
@@ -80,6 +188,230 @@ void test_timsort()
 
 	// clean up
 	free(arr);
+
+	// natural runs of odd length start at unaligned addresses, and the merges of such runs are too
+	// long for their bounds to be narrowed exactly
+	const size_t runs_length = 100003;
+	arr = malloc(runs_length * sizeof(int));
+	assert(NULL != arr);
+
+	// ascending runs of 1001 elements, each starting at its own value
+	for (size_t ix = 0; ix < runs_length; ix++)
+	{
+		arr[ix] = (int)((ix / 1001 * 7919) % 10007 + ix % 1001);
+	}
+
+	timSortSetBoundsMode(BOUNDS_MODE_PER_CALL);
+	timSort(arr);
+	timSortSetBoundsMode(BOUNDS_MODE_HOISTED);
+
+	assert(isSorted(arr));
+	free(arr);
+}
+
+void test_timSortSetRunLength()
+{
+	const size_t arr_length = 1000;
+	int *arr = malloc(arr_length * sizeof(int));
+
+	assert(NULL != arr);
+
+	for (size_t run_length = 32; run_length <= 128; run_length *= 2)
+	{
+		for (size_t ix = 0; ix < arr_length; ix++)
+		{
+			arr[ix] = (ix * 7919) % arr_length;
+		}
+
+		timSortSetRunLength(run_length);
+		timSort(arr);
+
+		assert(isSorted(arr));
+	}
+
+	// back to the default
+	timSortSetRunLength(0);
+
+	free(arr);
+}
+
+void test_timSortSetMergePolicy()
+{
+	const size_t arr_length = 5000;
+	int *arr = malloc(arr_length * sizeof(int));
+	merge_policy_t policies[] = {MERGE_POLICY_BOTTOM_UP, MERGE_POLICY_TIMSORT,
+								 MERGE_POLICY_POWERSORT};
+
+	assert(NULL != arr);
+
+	for (size_t ix_policy = 0; ix_policy < 3; ix_policy++)
+	{
+		// natural runs of uneven length: 1, 2, 3, ... elements, alternating direction
+		size_t run = 1;
+		size_t in_run = 0;
+		for (size_t ix = 0; ix < arr_length; ix++)
+		{
+			arr[ix] = (run % 2) ? (int)(ix % 97) : -(int)in_run;
+
+			if (++in_run == run)
+			{
+				run++;
+				in_run = 0;
+			}
+		}
+
+		timSortSetMergePolicy(policies[ix_policy]);
+		timSort(arr);
+
+		assert(isSorted(arr));
+	}
+
+	// back to the default
+	timSortSetMergePolicy(MERGE_POLICY_POWERSORT);
+
+	free(arr);
+}
+
+void test_sliceMergeRuns()
+{
+	int arr[] = {9, 9, 1, 4, 6, 2, 3, 5, 7, 0};
+	int *region = malloc(timSortWorkspaceBytes(10));
+	workspace_t workspace;
+	assert(NULL != region);
+	workspaceInit(&workspace, region);
+	merge_state_t state = {.minGallop = MIN_GALLOP, .pendingRuns = 0, .workspace = &workspace};
+
+	// only the runs arr[2 .. 5) and arr[5 .. 9) are merged, through the capability of `arr`
+	sliceMergeRuns(&state, arr, 2, 5, 9);
+	for (size_t ix = 2; ix < 9; ix++)
+	{
+		assert(arr[ix] == (int)ix - 1);
+	}
+	assert(9 == arr[0] && 9 == arr[1] && 0 == arr[9]);
+
+	assert(3 == sliceGallopLeft(4, arr, 2, 9, 0));
+	assert(4 == sliceGallopRight(4, arr, 2, 9, 6));
+	assert(2 == sliceCountRunAndMakeAscending(arr, 8, 10));
+	assert(0 == arr[8] && 7 == arr[9]);
+
+	// the merge gives its scratch copies back
+	assert(0 == workspace.used);
+	free(region);
+}
+
+void test_timSortSetBoundsMode()
+{
+	const size_t arr_length = 8192;
+	int *arr = malloc(arr_length * sizeof(int));
+	bounds_stats_t stats[2];
+	bounds_mode_t modes[] = {BOUNDS_MODE_PER_CALL, BOUNDS_MODE_HOISTED};
+
+	assert(NULL != arr);
+
+	for (size_t ix_mode = 0; ix_mode < 2; ix_mode++)
+	{
+		dataFill(arr, arr_length, DATA_UNIFORM, 0, DATA_SEED);
+
+		timSortSetBoundsMode(modes[ix_mode]);
+		timSortResetBoundsStats();
+		timSort(arr);
+		timSortBoundsStats(&stats[ix_mode]);
+
+		assert(isSorted(arr));
+	}
+
+	// hoisted: the lengths of the array and of the workspace, then three narrowings per merge:
+	// both runs and their scratch copies
+	assert(2 == stats[1].lengthGet && 0 == stats[1].offsetSet && 0 == stats[1].offsetGet);
+	assert(stats[1].boundsSet < 3 * arr_length / RUN_LENGTH);
+	assert(stats[1].boundsSet < stats[0].boundsSet);
+	assert(stats[1].lengthGet < stats[0].lengthGet);
+
+	free(arr);
+
+	// natural runs, of a length that is not a power of two: most runs and merges start at
+	// addresses that are not aligned enough for their bounds to be exact
+	const size_t runs_length = 30011;
+	arr = malloc(runs_length * sizeof(int));
+	assert(NULL != arr);
+
+	for (size_t ix_mode = 0; ix_mode < 2; ix_mode++)
+	{
+		dataFill(arr, runs_length, DATA_RUNS, 257, DATA_SEED);
+
+		timSortSetBoundsMode(modes[ix_mode]);
+		timSortResetBoundsStats();
+		timSort(arr);
+		timSortBoundsStats(&stats[ix_mode]);
+
+		assert(isSorted(arr));
+	}
+
+	assert(2 == stats[1].lengthGet && 0 == stats[1].offsetGet);
+	assert(stats[1].lengthGet < stats[0].lengthGet);
+
+	// back to the default
+	timSortSetBoundsMode(BOUNDS_MODE_HOISTED);
+
+	free(arr);
+}
+
+void test_workspaceAlloc()
+{
+	const size_t region_length = 1 << 16;
+	int *region = malloc(region_length * sizeof(int));
+	workspace_t workspace;
+
+	assert(NULL != region);
+	workspaceInit(&workspace, region);
+
+	// parts are bounded to what they hold and do not overlap
+	size_t lengths[] = {3, 1000, 5000, 17};
+	int *previous = NULL;
+	for (size_t ix = 0; ix < 4; ix++)
+	{
+		int *part = workspaceAlloc(&workspace, lengths[ix]);
+
+		assert(NULL != part);
+		assert(cheri_getlen(part) == cheri_representable_length(lengths[ix] * sizeof(int)));
+		assert((NULL == previous) ||
+			   (cheri_base_get(previous) + cheri_getlen(previous) <= cheri_base_get(part)));
+		previous = part;
+	}
+
+	// releasing parts makes room again, an exhausted workspace hands out nothing
+	workspace.used = 0;
+	assert(NULL != workspaceAlloc(&workspace, region_length));
+	assert(NULL == workspaceAlloc(&workspace, 1));
+
+	free(region);
+}
+
+void test_timSortWithWorkspace()
+{
+	const size_t arr_length = 10000;
+	int *arr = malloc(arr_length * sizeof(int));
+	int *region = malloc(timSortWorkspaceBytes(arr_length));
+	int *short_region = malloc(arr_length / 2 * sizeof(int));
+
+	assert(NULL != arr && NULL != region && NULL != short_region);
+
+	// too short a workspace leaves the array untouched
+	dataFill(arr, arr_length, DATA_UNIFORM, 0, DATA_SEED);
+	assert(!timSortWithWorkspace(arr, short_region));
+	assert(!isSorted(arr));
+
+	// one workspace serves any number of sorts
+	for (size_t ix_input = 0; ix_input < 3; ix_input++)
+	{
+		dataFill(arr, arr_length, DATA_RUNS, 100 * (ix_input + 1), DATA_SEED);
+		assert(timSortWithWorkspace(arr, region));
+		assert(isSorted(arr));
+	}
+
+	free(short_region);
+	free(region);
+	free(arr);
 }
 
 /**
@@ -90,9 +422,33 @@ int main(int argc, char *argv[])
 {
 	test_isSorted();
 
+	test_gallop();
+
+	test_binaryInsertionSort();
+
 	test_merge();
 
+	test_merge_gallop();
+
+	test_countRunAndMakeAscending();
+
+	test_minRunLength();
+
+	test_nodePower();
+
 	test_timsort();
 
+	test_timSortSetRunLength();
+
+	test_timSortSetMergePolicy();
+
+	test_sliceMergeRuns();
+
+	test_timSortSetBoundsMode();
+
+	test_workspaceAlloc();
+
+	test_timSortWithWorkspace();
+
 	return EXIT_SUCCESS;
 }
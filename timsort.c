@@ -12,7 +12,8 @@
 int main(int argc, char *argv[])
 {
 
-	int *arr = random_chunk();
+	const size_t arr_length = 9158656;
+	int *arr = random_chunk(arr_length, DATA_SEED);
 
 	// place the chunk of data on the heap
 	if (NULL == arr)
@@ -21,7 +22,7 @@ int main(int argc, char *argv[])
 	}
 
 	// sort the data
-	timSort(arr, cheri_length_get(arr) / sizeof(int));
+	timSort(arr, arr_length);
 
 	// clean up
 	free(arr);
@@ -14,7 +14,7 @@ void inspect_pointer(void *ptr);
 int main(int argc, char *argv[])
 {
 
-	int *arr = random_chunk(9158656);
+	int *arr = random_chunk(9158656, DATA_SEED);
 	// place the chunk of data on the heap
 	if (NULL == arr)
 	{